@@ -2,158 +2,281 @@
 #include <SDL_ttf.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+
+#include "additive.h"
+#include "analysis.h"
+#include "capture.h"
+#include "redraw.h"
+#include "scope.h"
+#include "text.h"
 
 #define SAMPLE_RATE 44100
-#define PI 3.14159265359
-#define MAX_OSC 8
 #define WAVE_BUF 1024
 
-float wave_vis[WAVE_BUF];
-int wave_pos = 0;
-
-typedef enum { WAVE_SINE, WAVE_SQUARE, WAVE_TRIANGLE, WAVE_SAW } WaveType;
+CaptureRing capture;
 
 const char *wave_names[] = {"Sine", "Square", "Triangle", "Saw"};
+const char *engine_names[] = {"Polynomial", "Resonator", "Inverse FFT"};
 
-typedef struct 
-{
-    WaveType type;
-    double freq;
-    double amp;
-    double phase;
-} Oscillator;
-
-Oscillator osc[MAX_OSC];
-int osc_count = 0;
+AdditiveSynth synth;
+Pool pool;
+TextRenderer text;
+Redraw redraw;
+SDL_Color white = {255,255,255,255};
 int selected = -1;   
-int playing = 0;
-
-double gen_wave(Oscillator *o) 
-{
-    double x = o->phase;
-    switch (o->type) 
-    {
-        case WAVE_SINE: return sin(x);
-        case WAVE_SQUARE: return sin(x) >= 0 ? 1 : -1;
-        case WAVE_TRIANGLE: return asin(sin(x)) * 2 / PI;
-        case WAVE_SAW: return (2.0 * (x / (2 * PI))) - 1.0;
-    }
-    return 0;
-}
 
 void audio_callback(void *u, Uint8 *stream, int len) 
 {
     float *buf = (float *)stream;
     int samples = len / sizeof(float);
 
-    for (int i = 0; i < samples; i++) 
-    {
-        double mix = 0;
+    synth_process(u, buf, samples);
+    capture_write(&capture, buf, samples);
+}
 
-        if (playing) 
-        {
-            for (int k = 0; k < osc_count; k++) 
-            {
-                mix += gen_wave(&osc[k]) * osc[k].amp;
+SDL_Rect button_add = {20, 20, 60, 40};
 
-                osc[k].phase += 2 * PI * osc[k].freq / SAMPLE_RATE;
-                if (osc[k].phase > 2 * PI)
-                    osc[k].phase -= 2 * PI;
-            }
-        }
+/* the oscillator list (with the scope), and the scope alone */
+SDL_Rect panel_area = {0, 0, 700, 410};
+SDL_Rect scope_area = {20, 300, 640, 100};
+
+/* the list shows LIST_ROWS oscillators, from list_top on */
+#define LIST_ROWS 6
+#define LIST_Y 90
+#define ROW_H 35
+int list_top = 0;
+
+/* how many sine partials H adds at once */
+#define PARTIALS_STEP 64
+
+/* the strongest partials an imported WAV keeps */
+#define IMPORT_OSC 512
+
+/* what the last import did */
+char status[128] = "";
+
+/*
+ * The import running in the background, one at a time. The thread only
+ * analyses, into an; the oscillators belong to this thread, so they're
+ * replaced here, when its import_done_event comes in.
+ */
+typedef struct
+{
+    SDL_Thread *thread;
+    char path[1024];
+    Analysis an;
+    int ok;
+} Import;
+
+Import import;
+Uint32 import_done_event;
+
+/* envelopes V steps through, all of them start again by themselves */
+typedef struct
+{
+    const char *name;
+    Envelope amp;
+    Envelope freq;
+} EnvPreset;
+
+const EnvPreset env_presets[] =
+{
+    {"none",    {0}, {0}},
+    {"pluck",   {4, 1, {0, 0.01, 0.8, 1.0}, {0, 1, 0, 0}}, {0}},
+    {"swell",   {3, 1, {0, 1.0, 2.0}, {0.1, 1, 0.1}}, {0}},
+    {"vibrato", {0}, {5, 1, {0, 0.05, 0.1, 0.15, 0.2}, {1, 1.01, 1, 0.99, 1}}},
+};
 
-        if (osc_count > 0)
-            mix /= osc_count;
+#define ENV_PRESETS (int)(sizeof(env_presets) / sizeof(env_presets[0]))
 
-        buf[i] = (float)mix;
+/* control rates C switches between */
+const int control_rates[] = {32, 64};
 
-        wave_vis[wave_pos] = (float)mix;
-        wave_pos = (wave_pos + 1) % WAVE_BUF;
+/* which preset o has, -1 for none of them */
+int env_preset(const Oscillator *o)
+{
+    for (int p = 0; p < ENV_PRESETS; p++)
+    {
+        if (memcmp(&o->amp_env, &env_presets[p].amp, sizeof(Envelope)) == 0 &&
+            memcmp(&o->freq_env, &env_presets[p].freq, sizeof(Envelope)) == 0)
+            return p;
     }
+
+    return -1;
 }
 
-SDL_Rect button_add = {20, 20, 60, 40};
+void next_envelope(Oscillator *o)
+{
+    int p = (env_preset(o) + 1) % ENV_PRESETS;
 
-void draw_text(SDL_Renderer *r, TTF_Font *f, int x, int y, const char *txt) 
+    o->amp_env = env_presets[p].amp;
+    o->freq_env = env_presets[p].freq;
+}
+
+void scroll_to_selected()
+{
+    if (selected < list_top)
+        list_top = selected;
+    if (selected >= list_top + LIST_ROWS)
+        list_top = selected - LIST_ROWS + 1;
+    if (list_top < 0)
+        list_top = 0;
+}
+
+void select_oscillator(int index)
 {
-    SDL_Color c = {255,255,255};
-    SDL_Surface *s = TTF_RenderText_Solid(f, txt, c);
-    SDL_Texture *t = SDL_CreateTextureFromSurface(r, s);
-    SDL_Rect dst = {x, y, s->w, s->h};
-    SDL_RenderCopy(r, t, NULL, &dst);
-    SDL_FreeSurface(s);
-    SDL_DestroyTexture(t);
+    if (synth.osc_count == 0) return;
+
+    if (index < 0) index = 0;
+    if (index >= synth.osc_count) index = synth.osc_count - 1;
+
+    selected = index;
+    scroll_to_selected();
 }
 
 void add_oscillator() 
 {
-    if (osc_count >= MAX_OSC) return;
+    int index = additive_add(&synth);
 
-    osc[osc_count].type = WAVE_SINE;
-    osc[osc_count].freq = 220;
-    osc[osc_count].amp = 0.5;
-    osc[osc_count].phase = 0;
+    if (index >= 0)
+    {
+        additive_publish(&synth);
+        select_oscillator(index);
+    }
+}
+
+/* sine partials of a 55 Hz saw (amplitude 1/n), past 256 the series repeats a little sharper */
+void add_partials()
+{
+    for (int k = 0; k < PARTIALS_STEP; k++)
+    {
+        int index = additive_add(&synth);
+        if (index < 0) break;
+
+        int n = index % 256 + 1;
+        synth.osc[index].freq = 55.0 * n * (1.0 + 0.002 * (index / 256));
+        synth.osc[index].amp = 1.0 / n;
 
-    selected = osc_count;
-    osc_count++;
+        select_oscillator(index);
+    }
+
+    additive_publish(&synth);
 }
 
 void remove_oscillator(int index)
 {
-    if (index < 0 || index >= osc_count) return;
+    additive_remove(&synth, index);
+    additive_publish(&synth);
 
-    for (int i = index; i < osc_count - 1; i++)
-        osc[i] = osc[i + 1];
+    if (synth.osc_count == 0)
+        selected = -1;
+    else if (selected >= synth.osc_count)
+        selected = synth.osc_count - 1;
 
-    osc_count--;
+    scroll_to_selected();
+}
 
-    if (osc_count == 0)
-        selected = -1;
-    else if (selected >= osc_count)
-        selected = osc_count - 1;
+const char *file_name(const char *path)
+{
+    return strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
 }
 
-void draw_wave(SDL_Renderer *r)
+/* the import thread: the analysis, on the pool the audio uses for big banks (it takes turns with it) */
+int import_run(void *u)
 {
-    int ox = 20;
-    int oy = 300;
-    int w = 640;
-    int h = 100;
+    Import *im = u;
 
-    SDL_SetRenderDrawColor(r, 40,40,40,255);
-    SDL_Rect bg = {ox, oy, w, h};
-    SDL_RenderFillRect(r, &bg);
+    im->ok = analysis_run(&im->an, im->path, &pool) == 0;
 
-    SDL_SetRenderDrawColor(r, 0,255,120,255);
+    SDL_Event e = {0};
+    e.type = import_done_event;
+    SDL_PushEvent(&e);
+    return 0;
+}
 
-    for (int i = 0; i < WAVE_BUF - 1; i++)
+/* starts analysing a WAV into sine partials, they replace all oscillators when it's done */
+void import_file(const char *path)
+{
+    if (import.thread)
     {
-        int i1 = (wave_pos + i) % WAVE_BUF;
-        int i2 = (wave_pos + i + 1) % WAVE_BUF;
+        snprintf(status, sizeof(status), "still importing %s", file_name(import.path));
+        return;
+    }
+
+    snprintf(import.path, sizeof(import.path), "%s", path);
+    import.thread = SDL_CreateThread(import_run, "import", &import);
+
+    if (import.thread)
+        snprintf(status, sizeof(status), "importing %s ...", file_name(path));
+    else
+        snprintf(status, sizeof(status), "can't import %s", file_name(path));
+
+    printf("%s\n", status);
+}
+
+void import_done()
+{
+    const char *name = file_name(import.path);
 
-        float v1 = wave_vis[i1];
-        float v2 = wave_vis[i2];
+    SDL_WaitThread(import.thread, NULL);
+    import.thread = NULL;
 
-        int x1 = ox + i * w / WAVE_BUF;
-        int x2 = ox + (i + 1) * w / WAVE_BUF;
+    if (import.ok)
+    {
+        int n = analysis_to_additive(&import.an, &synth, IMPORT_OSC);
+        additive_publish(&synth);
 
-        int y1 = oy + h/2 - v1 * h/2;
-        int y2 = oy + h/2 - v2 * h/2;
+        /* the envelopes play the file from the start, SPACE twice plays it again */
+        synth.playing = 1;
+        selected = -1;
+        list_top = 0;
+        select_oscillator(0);
 
-        SDL_RenderDrawLine(r, x1, y1, x2, y2);
+        snprintf(status, sizeof(status), "%s: %d partials, analysed at %.0fx realtime",
+                 name, n, import.an.seconds / import.an.wall_seconds);
     }
+    else
+        snprintf(status, sizeof(status), "can't import %s", name);
+
+    printf("%s\n", status);
+    analysis_free(&import.an);
 }
 
+void draw_wave(SDL_Renderer *r)
+{
+    float wave[WAVE_BUF];
+    int n = capture_read(&capture, wave, WAVE_BUF);
+
+    SDL_SetRenderDrawColor(r, 40,40,40,255);
+    SDL_RenderFillRect(r, &scope_area);
 
-int main() 
+    SDL_SetRenderDrawColor(r, 0,255,120,255);
+    scope_draw(r, scope_area, wave, n, 1.0f);
+}
+
+
+int main(int argc, char **argv) 
 {
     SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO);
     TTF_Init();
 
+    additive_init(&synth, SAMPLE_RATE);
+    capture_init(&capture);
+
+    /* big banks get spread over the other cores, and so does an import */
+    if (pool_init(&pool, pool_cores() - 1) > 0)
+        additive_set_pool(&synth, &pool);
+
+    import_done_event = SDL_RegisterEvents(1);
+
     SDL_Window *win = SDL_CreateWindow("Synthesizer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 700, 500, 0);
     SDL_Renderer *ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED);
 
     TTF_Font *font = TTF_OpenFont("/System/Library/Fonts/Supplemental/Arial.ttf", 18);
+    text_init(&text, ren, font);
+    redraw_init(&redraw, ren, 700, 500);
+    redraw_set_scope(&redraw, scope_area, REDRAW_SCOPE_FPS);
 
     SDL_AudioSpec spec = {0};
     spec.freq = SAMPLE_RATE;
@@ -161,16 +284,38 @@ int main()
     spec.channels = 1;
     spec.samples = 512;
     spec.callback = audio_callback;
+    spec.userdata = &synth;
 
     SDL_OpenAudio(&spec, NULL);
     SDL_PauseAudio(0);
 
+    /* a WAV on the command line, or dropped on the window, is imported as partials */
+    if (argc > 1)
+        import_file(argv[1]);
+
     int run = 1;
     SDL_Event e;
 
     while (run) {
+        redraw_wait(&redraw);
+
         while (SDL_PollEvent(&e)) 
         {
+            redraw_event(&redraw, &e);
+
+            if (e.type == SDL_MOUSEBUTTONDOWN || e.type == SDL_KEYDOWN || e.type == SDL_MOUSEWHEEL ||
+                e.type == SDL_DROPFILE || e.type == import_done_event)
+                redraw_mark(&redraw, panel_area);
+
+            if (e.type == import_done_event)
+                import_done();
+
+            if (e.type == SDL_DROPFILE)
+            {
+                import_file(e.drop.file);
+                SDL_free(e.drop.file);
+            }
+
             if (e.type == SDL_QUIT)
                 run = 0;
 
@@ -185,16 +330,25 @@ int main()
                     add_oscillator();
                 }
 
-                int start_y = 90;
-                for (int i = 0; i < osc_count; i++) 
+                for (int row = 0; row < LIST_ROWS && list_top + row < synth.osc_count; row++) 
                 {
-                    if (y > start_y + i * 35 && y < start_y + i * 35 + 30) 
+                    if (y > LIST_Y + row * ROW_H && y < LIST_Y + row * ROW_H + 30) 
                     {
-                        selected = i;
+                        selected = list_top + row;
                     }
                 }
             }
 
+            /* the wheel scrolls the list, the selection stays */
+            if (e.type == SDL_MOUSEWHEEL)
+            {
+                list_top -= e.wheel.y;
+                if (list_top > synth.osc_count - LIST_ROWS)
+                    list_top = synth.osc_count - LIST_ROWS;
+                if (list_top < 0)
+                    list_top = 0;
+            }
+
             if (e.type == SDL_KEYDOWN)
             {
 
@@ -202,19 +356,41 @@ int main()
                     run = 0;
 
                 if (e.key.keysym.sym == SDLK_SPACE)
-                    playing = !playing;
+                    synth.playing = !synth.playing;
+
+                if (e.key.keysym.sym == SDLK_e)
+                    synth.engine = (synth.engine + 1) % ADDITIVE_ENGINES;
+
+                if (e.key.keysym.sym == SDLK_h)
+                    add_partials();
+
+                if (e.key.keysym.sym == SDLK_c)
+                    synth.control = synth.control == control_rates[0] ? control_rates[1] : control_rates[0];
+
+                if (e.key.keysym.sym == SDLK_PAGEUP)
+                    select_oscillator(selected - LIST_ROWS);
+                if (e.key.keysym.sym == SDLK_PAGEDOWN)
+                    select_oscillator(selected + LIST_ROWS);
 
                 if (selected >= 0) 
                 {
-                    Oscillator *o = &osc[selected];
+                    Oscillator *o = &synth.osc[selected];
+                    Oscillator before = *o;
 
                     if (e.key.keysym.sym == SDLK_TAB)
-                        o->type = (o->type + 1) % 4;
+                        o->type = (o->type + 1) % OSC_SHAPES;
 
                     if (e.key.keysym.sym == SDLK_UP) o->freq += 10;
                     if (e.key.keysym.sym == SDLK_DOWN && o->freq > 10) o->freq -= 10;
                     if (e.key.keysym.sym == SDLK_RIGHT && o->amp < 1) o->amp += 0.05;
                     if (e.key.keysym.sym == SDLK_LEFT && o->amp > 0) o->amp -= 0.05;
+                    if (e.key.keysym.sym == SDLK_m) o->muted = !o->muted;
+                    if (e.key.keysym.sym == SDLK_v) next_envelope(o);
+
+                    /* the audio thread only hears about it through a new snapshot */
+                    if (memcmp(o, &before, sizeof(Oscillator)) != 0)
+                        additive_publish(&synth);
+
                     if (e.key.keysym.sym == SDLK_BACKSPACE && selected >= 0)
                     {
                         remove_oscillator(selected);
@@ -224,15 +400,28 @@ int main()
             }
         }
 
+        redraw_scope_live(&redraw, synth.playing);
+
+        if (!redraw_begin(&redraw)) continue;
+
+        /* FillRect, unlike RenderClear, stays inside the dirty area */
         SDL_SetRenderDrawColor(ren, 20,20,20,255);
-        SDL_RenderClear(ren);
+        SDL_RenderFillRect(ren, NULL);
 
         SDL_SetRenderDrawColor(ren, 60,60,200,255);
         SDL_RenderFillRect(ren, &button_add);
-        draw_text(ren, font, 35, 28, "+");
+        text_draw(&text, 35, 28, "+", white);
 
-        int y = 90;
-        for (int i = 0; i < osc_count; i++) 
+        char info[128];
+        sprintf(info, "%s (E), envelopes every %d (C), %d / %d oscs, %d audible",
+                engine_names[synth.engine], synth.control, synth.osc_count, MAX_OSC, synth.active_count);
+        text_draw(&text, 100, 28, info, white);
+
+        if (status[0])
+            text_draw(&text, 100, 55, status, white);
+
+        int y = LIST_Y;
+        for (int i = list_top; i < synth.osc_count && i < list_top + LIST_ROWS; i++) 
         {
 
             if (i == selected) 
@@ -243,19 +432,35 @@ int main()
             }
 
             char buf[128];
-            sprintf(buf, "Wave %d: %s  F=%.0fHz  A=%.2f", i+1, wave_names[osc[i].type], osc[i].freq, osc[i].amp);
-            draw_text(ren, font, 30, y, buf);
-            y += 35;
+            int p = env_preset(&synth.osc[i]);
+
+            sprintf(buf, "Wave %d: %s  F=%.0fHz  A=%.2f  Env: %s%s", i+1, wave_names[synth.osc[i].type], synth.osc[i].freq, synth.osc[i].amp,
+                    p >= 0 ? env_presets[p].name : "custom", synth.osc[i].muted ? "  (muted)" : "");
+            text_draw(&text, 30, y, buf, white);
+            y += ROW_H;
         }
 
-        draw_text(ren, font, 30, 420, "SPACE play | TAB type | arrows freq/amp | click select | ESC exit");
-        draw_wave(ren);
+        text_draw(&text, 30, 420, "SPACE play | TAB type | arrows freq/amp | V envelope | M mute | ESC exit", white);
+        text_draw(&text, 30, 450, "E engine | C env rate | H add partials | PGUP/PGDN, wheel scroll | BACKSPACE remove", white);
+        if (redraw_is_dirty(&redraw, scope_area))
+            draw_wave(ren);
 
-        SDL_RenderPresent(ren);
-        SDL_Delay(16);
+        redraw_end(&redraw);
+        text_frame(&text);
+    }
+
+    /* the import still has the pool */
+    if (import.thread)
+    {
+        SDL_WaitThread(import.thread, NULL);
+        analysis_free(&import.an);
     }
 
+    redraw_free(&redraw);
+    text_free(&text);
     SDL_CloseAudio();
+    additive_free(&synth);
+    pool_free(&pool);
     TTF_Quit();
     SDL_Quit();
 }
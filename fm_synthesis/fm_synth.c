@@ -0,0 +1,362 @@
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "capture.h"
+#include "fm.h"
+#include "redraw.h"
+#include "scope.h"
+#include "text.h"
+
+#define SAMPLE_RATE 44100
+#define WAVE_BUF 1024
+
+const char *algorithm_names[] = {
+    "6 > 5 > 4 > 3 > 2 > 1",
+    "3 > 2 > 1, 6 > 5 > 4",
+    "2 > 1, 4 > 3, 6 > 5",
+    "2, 3 and 4 > 1, 6 > 5",
+    "2 > 1, 6 > 3, 4 and 5",
+    "six carriers",
+};
+
+typedef struct {
+    SDL_Keycode key;
+    float freq;
+    int held;       /* the UI's own idea of it, the voices belong to the audio thread */
+} KeyNote;
+
+KeyNote keymap[] = {
+    {SDLK_z, 220.0f, 0},       // A3
+    {SDLK_s, 233.1f, 0},       // A#3
+    {SDLK_x, 247.0f, 0},       // B3
+    {SDLK_c, 261.6f, 0},       // C4
+    {SDLK_f, 277.2f, 0},       // C#4
+    {SDLK_v, 293.7f, 0},       // D4
+    {SDLK_g, 311.1f, 0},       // D#4
+    {SDLK_b, 329.6f, 0},       // E4
+    {SDLK_n, 349.2f, 0},       // F4
+    {SDLK_j, 370.0f, 0},       // F#4
+    {SDLK_m, 392.0f, 0},       // G4
+    {SDLK_k, 415.3f, 0},       // G#4
+    {SDLK_COMMA, 440.0f, 0},   // A4
+    {SDLK_l, 466.2f, 0},       // A#4
+    {SDLK_PERIOD, 493.9f, 0},  // B4
+    {SDLK_SLASH, 523.3f, 0},   // C5
+};
+
+int keymap_size = sizeof(keymap) / sizeof(KeyNote);
+
+FmSynth synth;
+TextRenderer text;
+Redraw redraw;
+CaptureRing capture;
+
+/* what the UI last sent, the audio thread has its own copy */
+int algorithm = FM_TWO_STACKS;
+float feedback = 0.3f;
+
+SDL_Color white = {240,240,240,255};
+SDL_Color black = {30,30,30,255};
+
+/* the parts of the window that get redrawn on their own */
+SDL_Rect controls_area = {0, 0, 700, 290};
+SDL_Rect scope_area = {10, 300, 680, 180};
+SDL_Rect keys_area = {80, 500, 550, 120};
+
+/* ==== octave ==== */
+void octave_up();
+void octave_down();
+
+/* ==== notes ==== */
+int is_key_active(SDL_Keycode key);
+
+/* ===== audio ===== */
+void audio_callback(void *u, Uint8 *stream, int len);
+
+/* ===== UI ===== */
+void draw_wave(SDL_Renderer *r);
+void draw_keyboard_hint(SDL_Renderer *r);
+
+
+int main()
+{
+    SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO);
+    TTF_Init();
+    fm_init(&synth, SAMPLE_RATE);
+    capture_init(&capture);
+
+    algorithm = synth.algorithm;
+    feedback = synth.feedback;
+
+    SDL_Window *win = SDL_CreateWindow("FM Synth",
+        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 700, 700, 0);
+    SDL_Renderer *ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED);
+
+    TTF_Font *font = TTF_OpenFont("/System/Library/Fonts/Supplemental/Arial.ttf", 18);
+    text_init(&text, ren, font);
+    redraw_init(&redraw, ren, 700, 700);
+    redraw_set_scope(&redraw, scope_area, REDRAW_SCOPE_FPS);
+
+    SDL_AudioSpec spec = {0};
+    spec.freq = SAMPLE_RATE;
+    spec.format = AUDIO_F32SYS;
+    spec.channels = 1;
+    spec.samples = 512;
+    spec.callback = audio_callback;
+    spec.userdata = &synth;
+
+    SDL_OpenAudio(&spec, NULL);
+    SDL_PauseAudio(0);
+
+    SDL_Event e;
+
+    int run = 1;
+
+    while (run)
+    {
+        redraw_wait(&redraw);
+
+        while (SDL_PollEvent(&e))
+        {
+            redraw_event(&redraw, &e);
+
+            if (e.type == SDL_QUIT) run = 0;
+
+            if (e.type == SDL_KEYDOWN && !e.key.repeat)
+            {
+                redraw_mark(&redraw, controls_area);
+                redraw_mark(&redraw, keys_area);
+
+                if (e.key.keysym.sym == SDLK_ESCAPE) run = 0;
+
+                if (e.key.keysym.sym == SDLK_TAB)
+                {
+                    algorithm = (algorithm + 1) % FM_ALGORITHMS;
+                    fm_set(&synth, FM_ALGORITHM, algorithm);
+                }
+
+                if (e.key.keysym.sym == SDLK_UP && feedback < 1.0f)
+                {
+                    feedback = fminf(feedback + 0.05f, 1.0f);
+                    fm_set(&synth, FM_FEEDBACK, feedback);
+                }
+                if (e.key.keysym.sym == SDLK_DOWN && feedback > 0.0f)
+                {
+                    feedback = fmaxf(feedback - 0.05f, 0.0f);
+                    fm_set(&synth, FM_FEEDBACK, feedback);
+                }
+
+                if (e.key.keysym.sym == SDLK_1)
+                    if(keymap[0].freq > 27.50f) octave_down();
+                if (e.key.keysym.sym == SDLK_2)
+                    if (keymap[0].freq < 1760.0) octave_up();
+
+                for (int i = 0; i < keymap_size; i++)
+                {
+                    if (e.key.keysym.sym == keymap[i].key)
+                    {
+                        if (fm_note_on(&synth, keymap[i].key, keymap[i].freq) == 0)
+                            keymap[i].held = 1;
+                        break;
+                    }
+                }
+            }
+            if (e.type == SDL_KEYUP)
+            {
+                redraw_mark(&redraw, keys_area);
+
+                for (int i = 0; i < keymap_size; i++)
+                {
+                    if (e.key.keysym.sym == keymap[i].key && keymap[i].held)
+                    {
+                        /* a full queue would leave the note hanging, so it stays held and goes again */
+                        if (fm_note_off(&synth, keymap[i].key) == 0)
+                            keymap[i].held = 0;
+                    }
+                }
+            }
+        }
+
+        /* released notes ring on, so it's the voices that count, not the keys */
+        redraw_scope_live(&redraw, atomic_load_explicit(&synth.playing, memory_order_relaxed) > 0);
+
+        if (!redraw_begin(&redraw)) continue;
+
+        /* FillRect, unlike RenderClear, stays inside the dirty area */
+        SDL_SetRenderDrawColor(ren, 20,20,20,255);
+        SDL_RenderFillRect(ren, NULL);
+
+        char buf[128];
+        sprintf(buf, "Algorithm %d: %s (TAB to change)", algorithm + 1, algorithm_names[algorithm]);
+        text_draw(&text, 30, 28, buf, white);
+
+        sprintf(buf, "Feedback on operator 6: %.2f (UP / DOWN)", feedback);
+        text_draw(&text, 30, 63, buf, white);
+
+        int y = 110;
+        for (int op = 0; op < FM_OPS; op++)
+        {
+            const FmOperator *o = &synth.op[op];
+
+            sprintf(buf, "Op %d: ratio %.2f  level %.2f  decay %.2fs  sustain %.2f  release %.2fs",
+                op + 1, o->ratio, o->level, o->decay, o->sustain, o->release);
+            text_draw(&text, 30, y, buf, white);
+            y += 28;
+        }
+
+        text_draw(&text, 50, 650,
+            " TAB algorithm | UP/DOWN feedback | 1/2 octave | ESC exit", white);
+
+        if (redraw_is_dirty(&redraw, scope_area))
+            draw_wave(ren);
+        if (redraw_is_dirty(&redraw, keys_area))
+            draw_keyboard_hint(ren);
+
+        redraw_end(&redraw);
+        text_frame(&text);
+    }
+
+    redraw_free(&redraw);
+    text_free(&text);
+    SDL_CloseAudio();
+    SDL_Quit();
+}
+/* ==== octave ==== */
+
+void octave_up()
+{
+    for (int i = 0; i < keymap_size; i++)
+    {
+        keymap[i].freq *= 2;
+    }
+}
+
+void octave_down()
+{
+    for (int i = 0; i < keymap_size; i++)
+    {
+        keymap[i].freq /= 2;
+    }
+}
+/* ==== notes ==== */
+
+int is_key_active(SDL_Keycode key)
+{
+    for (int i = 0; i < keymap_size; i++)
+        if (keymap[i].key == key) return keymap[i].held;
+    return 0;
+}
+
+/* ===== audio ===== */
+void audio_callback(void *u, Uint8 *stream, int len)
+{
+    float *buf = (float *)stream;
+    int samples = len / sizeof(float);
+
+    synth_process(u, buf, samples);
+    capture_write(&capture, buf, samples);
+}
+
+/* ===== UI ===== */
+
+
+void draw_wave(SDL_Renderer *r)
+{
+    /* twice the window, so there's room to look for a zero crossing */
+    float wave[2 * WAVE_BUF];
+    int n = capture_read(&capture, wave, 2 * WAVE_BUF);
+    int start = scope_trigger(wave, n, WAVE_BUF);
+
+    SDL_SetRenderDrawColor(r, 40,40,40,255);
+    SDL_RenderFillRect(r, &scope_area);
+
+    SDL_SetRenderDrawColor(r, 120,200,255,240);
+    scope_draw(r, scope_area, wave + start, n - start < WAVE_BUF ? n - start : WAVE_BUF, 2.0f);
+}
+
+void draw_keyboard_hint(SDL_Renderer *r)
+{
+    int x0 = 80;
+    int y0 = 500;
+
+    int white_w = 55;
+    int white_h = 120;
+
+    int black_w = 35;
+    int black_h = 70;
+
+    const char *white_labels[] = {"Z","X","C","V","B","N","M",",",".","/"};
+
+    const int black_pos[] = {0,2,3,5,6,7};
+    const char *black_labels[] = {"S","F","G","J","K","L"};
+
+    SDL_Keycode white_keys[] =
+    {
+        SDLK_z, SDLK_x, SDLK_c, SDLK_v, SDLK_b,
+        SDLK_n, SDLK_m, SDLK_COMMA, SDLK_PERIOD, SDLK_SLASH
+    };
+
+    SDL_Keycode black_keys[] =
+    {
+        SDLK_s, SDLK_f, SDLK_g, SDLK_j, SDLK_k, SDLK_l
+    };
+
+
+    /* === white keys === */
+    for (int i = 0; i < 10; i++)
+    {
+        SDL_Rect k = {
+            x0 + i * white_w,
+            y0,
+            white_w,
+            white_h
+        };
+
+        if (is_key_active(white_keys[i]))
+            SDL_SetRenderDrawColor(r, 150, 190, 220, 255);
+        else
+            SDL_SetRenderDrawColor(r, 230, 230, 230,255);
+
+        SDL_RenderFillRect(r, &k);
+
+        SDL_SetRenderDrawColor(r, 0,0,0,255);
+        SDL_RenderDrawRect(r, &k);
+
+        text_draw(
+            &text,
+            k.x + white_w / 2 - 8,
+            k.y + white_h - 28,
+            white_labels[i],
+            black
+        );
+    }
+
+    /* === black keys === */
+    for (int i = 0; i < 6; i++)
+    {
+        SDL_Rect k = {
+            x0 + (black_pos[i] + 1) * white_w - black_w / 2,
+            y0,
+            black_w,
+            black_h
+        };
+
+        if (is_key_active(black_keys[i]))
+            SDL_SetRenderDrawColor(r, 100, 140, 170,255);
+        else
+            SDL_SetRenderDrawColor(r, 40,40,40,255);
+
+        SDL_RenderFillRect(r, &k);
+
+        text_draw(
+            &text,
+            k.x + black_w / 2 - 6,
+            k.y + black_h - 26,
+            black_labels[i],
+            white
+        );
+    }
+}
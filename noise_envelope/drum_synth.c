@@ -4,77 +4,90 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#define SAMPLE_RATE 44100
-#define PI 3.14159265359
-#define MAX_SAMPLES 44100
-
-typedef struct 
-{
-    float freq1;
-    float freq2;
-    float mix2;        
-
-    int use_fm;
-    float fm_amount;   
-    float fm_k;        
-
-    int use_noise;
-    float noise_amt;
-
-    int use_env;
-    float env_k;
-
-    int length;
-} DrumParams;
-
-
-DrumParams params = 
-{
-    .freq1 = 180.0f,
-    .freq2 = 350.0f,
-    .mix2 = 0.0f,
-
-    .use_fm = 0,
-    .fm_amount = 80.0f,
-    .fm_k = 12.0f,
+#include "drum.h"
+#include "drumcache.h"
+#include "drumsampler.h"
+#include "drumseq.h"
+#include "drumstream.h"
+#include "redraw.h"
+#include "text.h"
 
-    .use_noise = 0,
-    .noise_amt = 0.4f,
-
-    .use_env = 0,
-    .env_k = 7.0f,
-
-    .length = 12000
-};
-
-float sample_buf[MAX_SAMPLES];
-int play_pos = 0;
-int playing = 0;
+#define SAMPLE_RATE 44100
+#define CACHE_MB 16     /* rendered samples kept for later hits, about 90 of the longest kind */
+#define STREAM_MAX_LENGTH (10 * SAMPLE_RATE)    /* streamed hits have no buffer to fill, only G / H to press */
+
+DrumSynth drum;
+DrumCache cache;
+
+/* plays the rendered hits, on top of each other */
+DrumSampler sampler;
+
+/* the same sound rendered while it plays, S switches SPACE over to it */
+DrumStream voices;
+int use_stream;
+
+/* a step sequencer with a track per preset; the UI keeps its own copy of what it sent */
+DrumSeq seq;
+int seq_running;
+double seq_tempo = 120;
+double seq_swing;
+int seq_steps = 16;
+uint32_t seq_pattern[DRUM_SEQ_TRACKS] = {0x0101 | 0x0400, 0x1010, 0x0000, 0x5555};
+int sel_track, sel_step;
+const char *track_names[DRUM_SEQ_TRACKS] = {"Kick", "Snare", "Tom", "HiHat"};
+TextRenderer text;
+Redraw redraw;
+SDL_Color white = {255,255,255,255};
+
+/* the parameter lines, the timing of the last hit, and the sample (which only changes when it's regenerated) */
+SDL_Rect params_area = {0, 70, 700, 230};
+SDL_Rect timing_area = {0, 300, 700, 50};
+SDL_Rect sample_area = {160, 350, 360, 200};
+
+/* refreshed while the sequencer plays, like a scope */
+SDL_Rect seq_area = {0, 560, 700, 200};
+
+/* pushed by the render thread when a new sample is ready to draw */
+Uint32 rendered_event;
 
-void generate_sample(float *buffer, DrumParams *p);
 void audio_callback(void *u, Uint8 *stream, int len);
-void draw_text(SDL_Renderer *r, TTF_Font *f, int x, int y, const char *t);
+void on_rendered(void *ctx);
 void draw_waveform(SDL_Renderer *ren,float *buffer, int length, int x, int y, int w, int h);
-void play_kick(DrumParams *p);
-void play_snare(DrumParams *p);
-void play_hihat(DrumParams *p);
-void play_tom(DrumParams *p);
+void load_track(int track, const DrumParams *p);
+void draw_seq(SDL_Renderer *ren);
 
 int main()
 {
     SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO);
     TTF_Init();
+    drum_init(&drum, SAMPLE_RATE);
+    drum_sampler_init(&sampler, SAMPLE_RATE);
+    drum_stream_init(&voices, SAMPLE_RATE);
+    drum_seq_init(&seq, SAMPLE_RATE);
+
+    /* the presets on the tracks, K puts the current sound on one */
+    static void (*presets[DRUM_SEQ_TRACKS])(DrumParams *p) = {play_kick, play_snare, play_tom, play_hihat};
+    for (int t = 0; t < DRUM_SEQ_TRACKS; t++)
+    {
+        DrumParams p = drum.params;
+        presets[t](&p);
+        load_track(t, &p);
+        drum_seq_set(&seq, DRUM_SEQ_PATTERN + t, seq_pattern[t]);
+    }
 
     SDL_Window *win = SDL_CreateWindow(
         "Drum Sample Synth",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        700, 600, 0
+        700, 760, 0
     );
 
     SDL_Renderer *ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED);
     TTF_Font *font = TTF_OpenFont(
         "/System/Library/Fonts/Supplemental/Arial.ttf", 18
     );
+    text_init(&text, ren, font);
+    redraw_init(&redraw, ren, 700, 760);
+    redraw_set_scope(&redraw, seq_area, REDRAW_SCOPE_FPS);
 
     SDL_AudioSpec spec = {0};
     spec.freq = SAMPLE_RATE;
@@ -82,289 +95,340 @@ int main()
     spec.channels = 1;
     spec.samples = 512;
     spec.callback = audio_callback;
+    spec.userdata = &sampler;
     SDL_OpenAudio(&spec, NULL);
     SDL_PauseAudio(0);
 
-    generate_sample(sample_buf, &params);
+    /* SPACE only asks for a hit, the worker renders it */
+    rendered_event = SDL_RegisterEvents(1);
+    drum.on_rendered = on_rendered;
+    drum_cache_init(&cache, CACHE_MB);
+    drum.cache = &cache;
+    drum.sampler = &sampler;
+    if (drum_start_worker(&drum) < 0)
+        printf("no render thread, SPACE renders on the UI thread\n");
 
     SDL_Event e;
     int run = 1;
+    long shown_hit = 0;
+    int shown_playing = 0;
 
     while (run)
     {
+        redraw_wait(&redraw);
+
         while (SDL_PollEvent(&e))
         {
+            redraw_event(&redraw, &e);
+
             if (e.type == SDL_QUIT) run = 0;
 
+            if (e.type == rendered_event)
+            {
+                redraw_mark(&redraw, sample_area);
+                redraw_mark(&redraw, timing_area);
+            }
+
             if (e.type == SDL_KEYDOWN)
             {
+                redraw_mark(&redraw, params_area);
+
                 switch (e.key.keysym.sym)
                 {
                     case SDLK_ESCAPE: run = 0; break;
 
                     /* play */
                     case SDLK_SPACE:
-                        generate_sample(sample_buf, &params);
-                        playing = 1;
-                        play_pos = 0;
+                        if (use_stream)
+                            drum_stream_hit(&voices, &drum.params);
+                        else
+                            drum_request(&drum);
+                        break;
+
+                    /* engine */
+                    case SDLK_s:
+                        use_stream ^= 1;
+                        redraw_mark(&redraw, timing_area);
+                        redraw_mark(&redraw, sample_area);
                         break;
 
                     /* osc frequencies */
-                    case SDLK_1: params.freq1 -= 10; break;
-                    case SDLK_2: params.freq1 += 10; break;
-                    case SDLK_3: params.freq2 -= 10; break;
-                    case SDLK_4: params.freq2 += 10; break;
+                    case SDLK_1: drum.params.freq1 -= 10; break;
+                    case SDLK_2: drum.params.freq1 += 10; break;
+                    case SDLK_3: drum.params.freq2 -= 10; break;
+                    case SDLK_4: drum.params.freq2 += 10; break;
 
                     /* osc mix */
-                    case SDLK_q: params.mix2 -= 0.05f; break;
-                    case SDLK_w: params.mix2 += 0.05f; break;
+                    case SDLK_q: drum.params.mix2 -= 0.05f; break;
+                    case SDLK_w: drum.params.mix2 += 0.05f; break;
 
                     /* pitch envelope (FM) */
-                    case SDLK_f: params.use_fm ^= 1; break;
-                    case SDLK_e: params.fm_amount -= 10; break;
-                    case SDLK_r: params.fm_amount += 10; break;
-                    case SDLK_t: params.fm_k -= 1; break;
-                    case SDLK_y: params.fm_k += 1; break;
+                    case SDLK_f: drum.params.use_fm ^= 1; break;
+                    case SDLK_e: drum.params.fm_amount -= 10; break;
+                    case SDLK_r: drum.params.fm_amount += 10; break;
+                    case SDLK_t: drum.params.fm_k -= 1; break;
+                    case SDLK_y: drum.params.fm_k += 1; break;
 
                     /* noise */
-                    case SDLK_n: params.use_noise ^= 1; break;
-                    case SDLK_b: params.noise_amt -= 0.05f; break;
-                    case SDLK_m: params.noise_amt += 0.05f; break;
+                    case SDLK_n: drum.params.use_noise ^= 1; break;
+                    case SDLK_b: drum.params.noise_amt -= 0.05f; break;
+                    case SDLK_m: drum.params.noise_amt += 0.05f; break;
+                    case SDLK_v: drum.params.seed++; break;
 
                     /* amplitude envelope */
-                    case SDLK_z: params.use_env ^= 1; break;
-                    case SDLK_x: params.env_k -= 1; break;
-                    case SDLK_c: params.env_k += 1; break;
+                    case SDLK_z: drum.params.use_env ^= 1; break;
+                    case SDLK_x: drum.params.env_k -= 1; break;
+                    case SDLK_c: drum.params.env_k += 1; break;
 
                     /* length */
-                    case SDLK_g: params.length -= 500; break;
-                    case SDLK_h: params.length += 500; break;
+                    case SDLK_g: drum.params.length -= 500; break;
+                    case SDLK_h: drum.params.length += 500; break;
 
                     /* presets */
-                    case SDLK_5: play_kick(&params); break;
-                    case SDLK_6: play_snare(&params); break;
-                    case SDLK_7: play_tom(&params); break;
-                    case SDLK_8: play_hihat(&params); break;
+                    case SDLK_5: play_kick(&drum.params); break;
+                    case SDLK_6: play_snare(&drum.params); break;
+                    case SDLK_7: play_tom(&drum.params); break;
+                    case SDLK_8: play_hihat(&drum.params); break;
+
+                    /* sequencer */
+                    case SDLK_p:
+                        seq_running ^= 1;
+                        drum_seq_set(&seq, DRUM_SEQ_RUNNING, seq_running);
+                        break;
+                    case SDLK_UP:    sel_track = (sel_track + DRUM_SEQ_TRACKS - 1) % DRUM_SEQ_TRACKS; break;
+                    case SDLK_DOWN:  sel_track = (sel_track + 1) % DRUM_SEQ_TRACKS; break;
+                    case SDLK_LEFT:  sel_step = (sel_step + seq_steps - 1) % seq_steps; break;
+                    case SDLK_RIGHT: sel_step = (sel_step + 1) % seq_steps; break;
+                    case SDLK_RETURN:
+                        seq_pattern[sel_track] ^= 1u << sel_step;
+                        drum_seq_set(&seq, DRUM_SEQ_PATTERN + sel_track, seq_pattern[sel_track]);
+                        break;
+                    case SDLK_MINUS:
+                        seq_tempo = seq_tempo > 40 ? seq_tempo - 2 : 40;
+                        drum_seq_set(&seq, DRUM_SEQ_TEMPO, seq_tempo);
+                        break;
+                    case SDLK_EQUALS:
+                        seq_tempo = seq_tempo < 300 ? seq_tempo + 2 : 300;
+                        drum_seq_set(&seq, DRUM_SEQ_TEMPO, seq_tempo);
+                        break;
+                    case SDLK_LEFTBRACKET:
+                        seq_swing = seq_swing > 0.05 ? seq_swing - 0.05 : 0;
+                        drum_seq_set(&seq, DRUM_SEQ_SWING, seq_swing);
+                        break;
+                    case SDLK_RIGHTBRACKET:
+                        seq_swing = seq_swing < 0.45 ? seq_swing + 0.05 : 0.5;
+                        drum_seq_set(&seq, DRUM_SEQ_SWING, seq_swing);
+                        break;
+                    case SDLK_l:
+                        seq_steps = seq_steps == 16 ? 32 : 16;
+                        sel_step %= seq_steps;
+                        drum_seq_set(&seq, DRUM_SEQ_STEPS, seq_steps);
+                        break;
+                    case SDLK_k: load_track(sel_track, &drum.params); break;
                 }
 
-                /* защита от бредовых значений */
-                if (params.mix2 < 0) params.mix2 = 0;
-                if (params.mix2 > 1) params.mix2 = 1;
-                if (params.noise_amt < 0) params.noise_amt = 0;
-                if (params.env_k < 0.1f) params.env_k = 0.1f;
-                if (params.fm_k < 0.1f) params.fm_k = 0.1f;
-                if (params.length < 100) params.length = 100;
-                if (params.length > MAX_SAMPLES) params.length = MAX_SAMPLES;
+                redraw_mark(&redraw, seq_area);
+
+                drum_clamp_params(&drum.params, use_stream ? STREAM_MAX_LENGTH : MAX_SAMPLES);
             }
         }
 
+        /*
+         * Set by the audio thread when a hit starts and when voices stop, so
+         * it can't wake us. While a hit asked for hasn't started yet, or
+         * voices are still playing, look again at the scope's rate.
+         */
+        long hit = atomic_load(&sampler.hit_ns);
+        int playing = atomic_load(&sampler.playing);
+
+        if (hit != shown_hit || playing != shown_playing)
+        {
+            shown_hit = hit;
+            shown_playing = playing;
+            redraw_mark(&redraw, timing_area);
+        }
+
+        if (drum.request_ns > shown_hit || playing > 0)
+            redraw_wake_in(&redraw, 1000 / REDRAW_SCOPE_FPS);
+
+        redraw_scope_live(&redraw, seq_running);
+
+        if (!redraw_begin(&redraw)) continue;
+
+        /* FillRect, unlike RenderClear, stays inside the dirty area */
         SDL_SetRenderDrawColor(ren, 20,20,20,255);
-        SDL_RenderClear(ren);
+        SDL_RenderFillRect(ren, NULL);
 
         char buf[128];
-        draw_text(ren, font, 30, 30, "SPACE: play / regenerate | PRESETS: 5=Kick 6=Snare 7=Tom 8=HiHat");
+        text_draw(&text, 30, 30, "SPACE: play / regenerate | PRESETS: 5=Kick 6=Snare 7=Tom 8=HiHat", white);
 
         /* OSCILLATORS */
-        sprintf(buf, "OSC1 Freq: %.0f Hz  (1 / 2)", params.freq1);
-        draw_text(ren, font, 30, 80, buf);
+        sprintf(buf, "OSC1 Freq: %.0f Hz  (1 / 2)", drum.params.freq1);
+        text_draw(&text, 30, 80, buf, white);
 
         sprintf(buf, "OSC2 Freq: %.0f Hz  (3 / 4)   Mix: %.2f  (Q / W)",
-                params.freq2, params.mix2);
-        draw_text(ren, font, 30, 110, buf);
+                drum.params.freq2, drum.params.mix2);
+        text_draw(&text, 30, 110, buf, white);
 
         /* PITCH ENVELOPE (FM) */
         sprintf(buf, "Pitch Env (F): %s  Amount: %.0f Hz (E / R)  Speed: %.1f (T / Y)",
-                params.use_fm ? "ON" : "OFF",
-                params.fm_amount,
-                params.fm_k);
-        draw_text(ren, font, 30, 150, buf);
+                drum.params.use_fm ? "ON" : "OFF",
+                drum.params.fm_amount,
+                drum.params.fm_k);
+        text_draw(&text, 30, 150, buf, white);
 
         /* NOISE */
-        sprintf(buf, "Noise: %s  Amount: %.2f  (N / B / M)",
-                params.use_noise ? "ON" : "OFF",
-                params.noise_amt);
-        draw_text(ren, font, 30, 190, buf);
+        sprintf(buf, "Noise: %s  Amount: %.2f  (N / B / M)  Seed: %u  (V)",
+                drum.params.use_noise ? "ON" : "OFF",
+                drum.params.noise_amt,
+                drum.params.seed);
+        text_draw(&text, 30, 190, buf, white);
 
         /* AMPLITUDE ENVELOPE */
         sprintf(buf, "Amp Env: %s  Decay: %.1f  (Z / X / C)",
-                params.use_env ? "ON" : "OFF",
-                params.env_k);
-        draw_text(ren, font, 30, 230, buf);
+                drum.params.use_env ? "ON" : "OFF",
+                drum.params.env_k);
+        text_draw(&text, 30, 230, buf, white);
 
         /* LENGTH */
-        sprintf(buf, "Length: %d samples  (G / H)", params.length);
-        draw_text(ren, font, 30, 270, buf);
-
-        draw_waveform(ren, sample_buf, params.length,
-              160, 350, 360, 200);
-
-    
-        SDL_RenderPresent(ren);
-        SDL_Delay(16);
-    }
-
-    SDL_Quit();
-}
-
-/* ===== sample generation ===== */
-void generate_sample(float *buffer, DrumParams *p)
-{
-    float phase1 = 0.0f;
-    float phase2 = 0.0f;
-
-    float phase_inc1 = 2.0f * PI * p->freq1 / SAMPLE_RATE;
-    float phase_inc2 = 2.0f * PI * p->freq2 / SAMPLE_RATE;
-
-    for (int i = 0; i < p->length; i++)
-    {
-        float t = (float)i / SAMPLE_RATE;
-
-        /* ===== amplitude envelope ===== */
-        float env = 1.0f;
-        if (p->use_env)
-            env = expf(-p->env_k * t);
-
-        /* ===== pitch envelope ===== */
-        float freq_mod = 0.0f;
-        if (p->use_fm)
-            freq_mod = p->fm_amount * expf(-p->fm_k * t);
+        sprintf(buf, "Length: %d samples  (G / H)   Engine: %s  (S)",
+                drum.params.length, use_stream ? "streaming" : "sample");
+        text_draw(&text, 30, 270, buf, white);
+
+        /* TIMING OF THE LAST HIT, AND THE CACHE */
+        if (use_stream)
+            text_draw(&text, 30, 303, "Streaming: the hit starts with the next audio block, nothing is rendered up front", white);
+        else if (shown_hit >= drum.request_ns && drum.request_ns)
+        {
+            sprintf(buf, "Last hit: ready in %.2f ms, playing %.2f ms after SPACE",
+                    atomic_load(&drum.render_ns) / 1e6, (shown_hit - drum.request_ns) / 1e6);
+            text_draw(&text, 30, 303, buf, white);
+        }
 
-        /* ===== main oscillator ===== */
-        float osc1 = sinf(phase1);
-        float osc = osc1;
+        sprintf(buf, "Cache: %lu hits, %lu misses  (%d MB)   Voices: %d playing, %u stolen",
+                atomic_load(&cache.hits), atomic_load(&cache.misses), CACHE_MB,
+                atomic_load(&sampler.playing), atomic_load(&sampler.stolen));
+        text_draw(&text, 30, 325, buf, white);
 
-        /* ===== wave addition ===== */
-        if (p->mix2 > 0.0f)
+        /* the worker writes the preview, so it's locked while we draw it */
+        if (use_stream)
         {
-            float osc2 = sinf(phase2);
-            osc = (1.0f - p->mix2) * osc1 + p->mix2 * osc2;
+            if (redraw_is_dirty(&redraw, sample_area))
+                text_draw(&text, sample_area.x, sample_area.y + sample_area.h / 2 - 10,
+                          "(no sample, rendered while it plays)", white);
         }
-
-        /* ===== noise ===== */
-        float noise = 0.0f;
-        if (p->use_noise)
+        else if (redraw_is_dirty(&redraw, sample_area))
         {
-            noise = p->noise_amt *
-                    ((float)(rand() % 200 - 100) / 100.0f);
+            pthread_mutex_lock(&drum.lock);
+            draw_waveform(ren, drum.preview, drum.preview_len,
+                  sample_area.x, sample_area.y, sample_area.w, sample_area.h);
+            pthread_mutex_unlock(&drum.lock);
         }
 
-        buffer[i] = env * (osc + noise);
-
-        /* ===== phase advancement ===== */
-        float inc1 = 2.0f * PI * (p->freq1 + freq_mod) / SAMPLE_RATE;
-        float inc2 = 2.0f * PI * p->freq2 / SAMPLE_RATE;
-
-        phase1 += inc1;
-        phase2 += inc2;
+        if (redraw_is_dirty(&redraw, seq_area))
+            draw_seq(ren);
 
-        if (phase1 > 2 * PI) phase1 -= 2 * PI;
-        if (phase2 > 2 * PI) phase2 -= 2 * PI;
+        redraw_end(&redraw);
+        text_frame(&text);
     }
+
+    SDL_CloseAudio();
+    drum_free(&drum);
+    drum_cache_free(&cache);
+    drum_sampler_free(&sampler);
+    drum_seq_free(&seq);
+    redraw_free(&redraw);
+    text_free(&text);
+    SDL_Quit();
 }
 
-void play_kick(DrumParams *p)
+/* ===== audio ===== */
+/* both engines and the sequencer play all the time, what's silent costs next to nothing */
+void audio_callback(void *u, Uint8 *stream, int len)
 {
-    p->freq1 = 80.0f;
-    p->freq2 = 0.0f;
-    p->mix2 = 0.0f;
+    float *out = (float *)stream;
+    int frames = len / sizeof(float);
+    float more[512];
 
-    p->use_fm = 1;
-    p->fm_amount = 40.0f;
-    p->fm_k = 15.0f;
+    synth_process(u, out, frames);
 
-    p->use_noise = 0;
-    p->noise_amt = 0.0f;
+    for (int done = 0; done < frames; done += 512)
+    {
+        int n = frames - done < 512 ? frames - done : 512;
 
-    p->use_env = 1;
-    p->env_k = 10.0f;
+        synth_process(&voices.base, more, n);
+        for (int i = 0; i < n; i++)
+            out[done + i] += more[i];
 
-    p->length = 12000;
+        /* places its steps on their samples inside the block itself */
+        synth_process(&seq.base, more, n);
+        for (int i = 0; i < n; i++)
+            out[done + i] += more[i];
+    }
 }
 
-void play_snare(DrumParams *p)
+/* render thread: wakes the UI to draw the new sample */
+void on_rendered(void *ctx)
 {
-    p->freq1 = 180.0f;
-    p->freq2 = 0.0f;
-    p->mix2 = 0.0f;
-
-    p->use_fm = 0;
-    p->fm_amount = 0.0f;
-    p->fm_k = 0.0f;
-
-    p->use_noise = 1;
-    p->noise_amt = 0.4f;
+    (void)ctx;
 
-    p->use_env = 1;
-    p->env_k = 7.0f;
-
-    p->length = 12000;
+    SDL_Event e = {0};
+    e.type = rendered_event;
+    SDL_PushEvent(&e);
 }
 
-void play_hihat(DrumParams *p)
+/* UI thread: the sound of a track, the only thread that loads seq.sampler */
+void load_track(int track, const DrumParams *p)
 {
-    p->freq1 = 8000.0f;
-    p->freq2 = 11000.0f;
-    p->mix2 = 0.5f;
-
-    p->use_fm = 0;
-
-    p->use_noise = 1;
-    p->noise_amt = 0.7f;
+    static float buf[MAX_SAMPLES];
+    DrumParams q = *p;
 
-    p->use_env = 1;
-    p->env_k = 8.0f;
-
-    p->length = 15000;
+    drum_clamp_params(&q, MAX_SAMPLES);
+    generate_sample(buf, &q, SAMPLE_RATE);
+    drum_sampler_load(&seq.sampler, track, buf, q.length);
 }
 
-void play_tom(DrumParams *p)
+/* ===== UI ===== */
+void draw_seq(SDL_Renderer *ren)
 {
-    p->freq1 = 200.0f;
-    p->freq2 = 300.0f;
-    p->mix2 = 0.3f;
+    char buf[128];
+    int playing = atomic_load(&seq.shown_step);
+    int cell = 576 / seq_steps;
 
-    p->use_fm = 1;
-    p->fm_amount = 50.0f;
-    p->fm_k = 10.0f;
+    sprintf(buf, "SEQUENCER: %s (P)  Tempo: %.0f BPM (- / =)  Swing: %.2f ([ / ])  Steps: %d (L)",
+            seq_running ? "PLAYING" : "STOPPED", seq_tempo, seq_swing, seq_steps);
+    text_draw(&text, 30, 565, buf, white);
 
-    p->use_noise = 0;
-    p->noise_amt = 0.0f;
+    for (int t = 0; t < DRUM_SEQ_TRACKS; t++)
+    {
+        int y = 600 + t * 28;
+        text_draw(&text, 30, y, track_names[t], white);
 
-    p->use_env = 1;
-    p->env_k = 8.0f;
+        for (int k = 0; k < seq_steps; k++)
+        {
+            SDL_Rect r = {100 + k * cell, y, cell - 2, 24};
 
-    p->length = 10000;
-}
+            /* the beats a bit lighter, the step playing now in yellow */
+            int on = seq_pattern[t] >> k & 1;
+            int grey = k % 4 ? 50 : 70;
 
-/* ===== audio ===== */
-void audio_callback(void *u, Uint8 *stream, int len)
-{
-    float *buf = (float *)stream;
-    int samples = len / sizeof(float);
+            if (k == playing)
+                SDL_SetRenderDrawColor(ren, on ? 240 : 120, on ? 220 : 110, on ? 60 : 40, 255);
+            else if (on)
+                SDL_SetRenderDrawColor(ren, 0, 220, 160, 255);
+            else
+                SDL_SetRenderDrawColor(ren, grey, grey, grey, 255);
+            SDL_RenderFillRect(ren, &r);
 
-    for (int i = 0; i < samples; i++)
-    {
-        if (playing && play_pos < params.length)
-            buf[i] = sample_buf[play_pos++] * 0.8f;
-        else
-        {
-            buf[i] = 0;
-            playing = 0;
-            play_pos = 0;
+            if (t == sel_track && k == sel_step)
+            {
+                SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+                SDL_RenderDrawRect(ren, &r);
+            }
         }
     }
-}
 
-/* ===== UI ===== */
-void draw_text(SDL_Renderer *r, TTF_Font *f, int x, int y, const char *t)
-{
-    SDL_Color c = {255,255,255};
-    SDL_Surface *s = TTF_RenderText_Solid(f, t, c);
-    SDL_Texture *tx = SDL_CreateTextureFromSurface(r, s);
-    SDL_Rect d = {x,y,s->w,s->h};
-    SDL_RenderCopy(r, tx, NULL, &d);
-    SDL_FreeSurface(s);
-    SDL_DestroyTexture(tx);
+    text_draw(&text, 30, 720, "ARROWS: pick a step | RETURN: on / off | K: current sound on the track", white);
 }
 
 void draw_waveform(SDL_Renderer *ren,
@@ -2,40 +2,23 @@
 #include <SDL_ttf.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+
+#include "capture.h"
+#include "subtractive.h"
+#include "redraw.h"
+#include "scope.h"
+#include "text.h"
 
 #define SAMPLE_RATE 44100
-#define PI 3.14159265359
-#define MAX_FILTERS 5
-#define MAX_VOICES 8
 #define WAVE_BUF 1024
 
 typedef enum {WAVE_SAW, WAVE_SQUARE, WAVE_TRIANGLE} WaveType;
-typedef enum {LPF, HPF, BPF, NOTCH} FilterType;
 
 const char *wave_names[] = {"Saw", "Square", "Triangle"};
+const OscShape wave_shapes[] = {OSC_SAW, OSC_SQUARE, OSC_TRIANGLE};
 const char *filter_names[] = {"LPF", "HPF", "BPF", "Notch"};
 
-typedef struct {
-    FilterType type;
-
-    float cutoff;   
-    float res;      
-
-    float b0, b1, b2;
-    float a1, a2;
-
-    float x1, x2;
-    float y1, y2;
-} Filter;
-
-
-typedef struct {
-    int active;
-    SDL_Keycode key;
-    float freq;
-    float phase;
-} Voice;
-
 typedef struct {
     SDL_Keycode key;
     float freq;
@@ -63,37 +46,31 @@ KeyNote keymap[] = {
 int keymap_size = sizeof(keymap) / sizeof(KeyNote);
 int last_key = -1;
 
-Voice voices[MAX_VOICES];
+SubtractiveSynth synth;
+TextRenderer text;
+Redraw redraw;
 WaveType wave = WAVE_SAW;
-Filter filters[MAX_FILTERS];
-int filter_count = 0;
 int selected = -1;
-float phase = 0;
-float current_freq = 0.0f;
-int playing = 0;
-float wave_vis[WAVE_BUF];
-int wave_pos = 0;
-
-SDL_Color white = {240,240,240};
-SDL_Color black = {30,30,30};
+CaptureRing capture;
+
+SDL_Color white = {240,240,240,255};
+SDL_Color black = {30,30,30,255};
 SDL_Rect button_add = {20, 20, 60, 40};
 
+/* the parts of the window that get redrawn on their own */
+SDL_Rect controls_area = {0, 0, 700, 290};
+SDL_Rect scope_area = {10, 300, 680, 180};
+SDL_Rect keys_area = {80, 500, 550, 120};
+
 /* ==== octave ==== */
 void octave_up();
 void octave_down();
 
 /* ==== poliphony ==== */
-void init_voices();
-int find_voice(SDL_Keycode key);
-int alloc_voice();
 int is_key_active(SDL_Keycode key);
-
-/* ===== oscillator ===== */
-float gen_voice(Voice *v);
+int any_voice_active();
 
 /* ===== filter ===== */
-void update_filter(Filter *f);
-float process_filter(Filter *f, float x);
 void add_filter();
 void remove_filter(int index);
 
@@ -101,21 +78,25 @@ void remove_filter(int index);
 void audio_callback(void *u, Uint8 *stream, int len);
 
 /* ===== UI ===== */
-void draw_text(SDL_Renderer *r, TTF_Font *f, int x, int y, const char *txt, SDL_Color c);
 void draw_wave(SDL_Renderer *r);
-void draw_keyboard_hint(SDL_Renderer *r, TTF_Font *font);
+void draw_keyboard_hint(SDL_Renderer *r);
 
 
 int main()
 {
     SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO);
     TTF_Init();
+    subtractive_init(&synth, FILTER_MODEL_BIQUAD, SAMPLE_RATE);
+    capture_init(&capture);
 
     SDL_Window *win = SDL_CreateWindow("Subtractive Synth",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 700, 700, 0);
     SDL_Renderer *ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED);
 
     TTF_Font *font = TTF_OpenFont("/System/Library/Fonts/Supplemental/Arial.ttf", 18);
+    text_init(&text, ren, font);
+    redraw_init(&redraw, ren, 700, 700);
+    redraw_set_scope(&redraw, scope_area, REDRAW_SCOPE_FPS);
 
     SDL_AudioSpec spec = {0};
     spec.freq = SAMPLE_RATE;
@@ -123,23 +104,29 @@ int main()
     spec.channels = 1;
     spec.samples = 512;
     spec.callback = audio_callback;
+    spec.userdata = &synth;
 
     SDL_OpenAudio(&spec, NULL);
     SDL_PauseAudio(0);
 
     SDL_Event e;
 
-    init_voices();
     int run = 1;
 
     while (run)
     {
+        redraw_wait(&redraw);
+
         while (SDL_PollEvent(&e))
         {
+            redraw_event(&redraw, &e);
+
             if (e.type == SDL_QUIT) run = 0;
 
             if (e.type == SDL_MOUSEBUTTONDOWN)
             {
+                redraw_mark(&redraw, controls_area);
+
                 int x = e.button.x;
                 int y = e.button.y;
 
@@ -150,7 +137,7 @@ int main()
                 }
 
                 int start_y = 90;
-                for (int i = 0; i < filter_count; i++)
+                for (int i = 0; i < synth.filter_count; i++)
                 {
                     if (y > start_y + i * 35 && y < start_y + i * 35 + 30)
                         selected = i;
@@ -159,12 +146,18 @@ int main()
 
             if (e.type == SDL_KEYDOWN && !e.key.repeat)
             {
+                redraw_mark(&redraw, controls_area);
+                redraw_mark(&redraw, keys_area);
+
                 if (e.key.keysym.sym == SDLK_ESCAPE) run = 0;
 
                 if (e.key.keysym.sym == SDLK_EQUALS) add_filter();
 
                 if (e.key.keysym.sym == SDLK_TAB)
+                {
                     wave = (wave + 1) % 3;
+                    synth.wave = wave_shapes[wave];
+                }
                 if (e.key.keysym.sym == SDLK_1) 
                     if(keymap[0].freq > 27.50f) octave_down();
                 if (e.key.keysym.sym == SDLK_2) 
@@ -174,46 +167,39 @@ int main()
                 {
                     if (e.key.keysym.sym == keymap[i].key)
                     {
-                        int v = find_voice(keymap[i].key);
-                        if (v < 0)
-                            v = alloc_voice();
-
-                        voices[v].active = 1;
-                        voices[v].key = keymap[i].key;
-                        voices[v].freq = keymap[i].freq;
-
+                        subtractive_note_on(&synth, keymap[i].key, keymap[i].freq);
                         break;
                     }
                 }
 
                 if (selected >= 0)
                 {
-                    Filter *f = &filters[selected];
+                    SubFilter *f = &synth.filters[selected];
 
                     if (e.key.keysym.sym == SDLK_q)
                     {
                         f->type = (f->type + 1) % 4;
-                        update_filter(f);
+                        subtractive_update_filter(&synth, selected);
                     }
                     if (e.key.keysym.sym == SDLK_UP) 
                     {
                         f->cutoff += 100;
-                        update_filter(f);
+                        subtractive_update_filter(&synth, selected);
                     }
                     if (e.key.keysym.sym == SDLK_DOWN && f->cutoff > 50) 
                     {
                         f->cutoff -= 100;
-                        update_filter(f);
+                        subtractive_update_filter(&synth, selected);
                     }
                     if (e.key.keysym.sym == SDLK_RIGHT) 
                     {
                         f->res += 0.05f;
-                        update_filter(f);
+                        subtractive_update_filter(&synth, selected);
                     }
                     if (e.key.keysym.sym == SDLK_LEFT && f->res > 0) 
                     {
                         f->res -= 0.05f;
-                        update_filter(f);
+                        subtractive_update_filter(&synth, selected);
                     }
                     if (e.key.keysym.sym == SDLK_BACKSPACE && selected >= 0)
                     {
@@ -224,36 +210,36 @@ int main()
             }
             if (e.type == SDL_KEYUP)
             {
+                redraw_mark(&redraw, keys_area);
+
                 for (int i = 0; i < keymap_size; i++)
                 {
                     if (e.key.keysym.sym == keymap[i].key)
                     {
-                        for (int i = 0; i < MAX_VOICES; i++)
-                        {
-                            if (voices[i].active && voices[i].key == e.key.keysym.sym)
-                            {
-                                voices[i].active = 0;
-                                break;
-                            }
-                        }
+                        subtractive_note_off(&synth, keymap[i].key);
                     }
                 }
             }
         }
 
+        redraw_scope_live(&redraw, any_voice_active());
+
+        if (!redraw_begin(&redraw)) continue;
+
+        /* FillRect, unlike RenderClear, stays inside the dirty area */
         SDL_SetRenderDrawColor(ren, 20,20,20,255);
-        SDL_RenderClear(ren);
+        SDL_RenderFillRect(ren, NULL);
 
         SDL_SetRenderDrawColor(ren, 60,60,60,240);
         SDL_RenderFillRect(ren, &button_add);
-        draw_text(ren, font, 45, 28, "+", white);
+        text_draw(&text, 45, 28, "+", white);
 
         char wbuf[64];
         sprintf(wbuf, "Waveform: %s (TAB to change)", wave_names[wave]);
-        draw_text(ren, font, 120, 28, wbuf, white);
+        text_draw(&text, 120, 28, wbuf, white);
 
         int y = 90;
-        for (int i = 0; i < filter_count; i++)
+        for (int i = 0; i < synth.filter_count; i++)
         {
             if (i == selected)
             {
@@ -264,24 +250,27 @@ int main()
 
             char buf[128];
             sprintf(buf, "Filter %d: %s  Cutoff=%.0fHz  Res=%.2f",
-                i+1, filter_names[filters[i].type],
-                filters[i].cutoff, filters[i].res);
+                i+1, filter_names[synth.filters[i].type],
+                synth.filters[i].cutoff, synth.filters[i].res);
 
-            draw_text(ren, font, 30, y, buf, white);
+            text_draw(&text, 30, y, buf, white);
             y += 35;
         }
 
-        draw_text(ren, font, 50, 650,
+        text_draw(&text, 50, 650,
             " + add filter | Q type | arrows cutoff/res | 1/2 octave | click select | ESC exit", white);
         
-        draw_wave(ren);
-        draw_keyboard_hint(ren, font);
-
-        SDL_RenderPresent(ren);
-        SDL_Delay(16);
+        if (redraw_is_dirty(&redraw, scope_area))
+            draw_wave(ren);
+        if (redraw_is_dirty(&redraw, keys_area))
+            draw_keyboard_hint(ren);
 
+        redraw_end(&redraw);
+        text_frame(&text);
     }
 
+    redraw_free(&redraw);
+    text_free(&text);
     SDL_CloseAudio();
     SDL_Quit();
 }
@@ -304,161 +293,36 @@ void octave_down()
 }
 /* ==== poliphony ==== */
 
-void init_voices()
-{
-    for (int i = 0; i < MAX_VOICES; i++)
-        voices[i].active = 0;
-}
-
-int find_voice(SDL_Keycode key)
-{
-    for (int i = 0; i < MAX_VOICES; i++)
-        if (voices[i].active && voices[i].key == key)
-            return i;
-    return -1;
-}
-
-int alloc_voice()
-{
-    for (int i = 0; i < MAX_VOICES; i++)
-        if (!voices[i].active)
-            return i;
-    return 0; 
-}
-
 int is_key_active(SDL_Keycode key)
 {
-    for (int i = 0; i < MAX_VOICES; i++)
-        if (voices[i].active && voices[i].key == key)
-            return 1;
-    return 0;
+    return subtractive_is_key_active(&synth, key);
 }
 
-
-/* ===== oscillator ===== */
-float gen_voice(Voice *v)
+/* the scope only needs refreshing while something sounds */
+int any_voice_active()
 {
-    v->phase += 2 * PI * v->freq / SAMPLE_RATE;
-    if (v->phase > 2 * PI) v->phase -= 2 * PI;
-
-    if (wave == WAVE_SAW)
-        return 2.0f * (v->phase / (2 * PI)) - 1;
-    if (wave == WAVE_SQUARE)
-        return sin(v->phase) > 0 ? 1 : -1;
-    if (wave == WAVE_TRIANGLE)
-        return asin(sin(v->phase)) * 2 / PI;
-
+    for (int v = 0; v < MAX_VOICES; v++)
+        if (synth.voices[v].active) return 1;
     return 0;
 }
 
-/* ===== filter ===== */
-void update_filter(Filter *f)
-{
-    if (f->cutoff < 20) f->cutoff = 20;
-    if (f->cutoff > SAMPLE_RATE / 2 - 100) 
-        f->cutoff = SAMPLE_RATE / 2 - 100;
-
-    float w0 = 2.0f * PI * f->cutoff / SAMPLE_RATE;
-    float cosw = cosf(w0);
-    float sinw = sinf(w0);
-
-    if (f->res < 0.05f) f->res = 0.05f;   
-
-    float alpha = sinw / (2.0f * f->res);
-
-    float b0, b1, b2, a0, a1, a2;
-
-    switch (f->type)
-    {
-        case LPF:
-            b0 = (1 - cosw) / 2;
-            b1 = 1 - cosw;
-            b2 = (1 - cosw) / 2;
-            a0 = 1 + alpha;
-            a1 = -2 * cosw;
-            a2 = 1 - alpha;
-            break;
-
-        case HPF:
-            b0 = (1 + cosw) / 2;
-            b1 = -(1 + cosw);
-            b2 = (1 + cosw) / 2;
-            a0 = 1 + alpha;
-            a1 = -2 * cosw;
-            a2 = 1 - alpha;
-            break;
-
-        case BPF:
-            b0 = alpha;
-            b1 = 0;
-            b2 = -alpha;
-            a0 = 1 + alpha;
-            a1 = -2 * cosw;
-            a2 = 1 - alpha;
-            break;
-
-        case NOTCH:
-            b0 = 1;
-            b1 = -2 * cosw;
-            b2 = 1;
-            a0 = 1 + alpha;
-            a1 = -2 * cosw;
-            a2 = 1 - alpha;
-            break;
-    }
-
-    f->b0 = b0 / a0;
-    f->b1 = b1 / a0;
-    f->b2 = b2 / a0;
-    f->a1 = a1 / a0;
-    f->a2 = a2 / a0;
-}
-
-float process_filter(Filter *f, float x)
-{
-    float y = f->b0 * x
-            + f->b1 * f->x1
-            + f->b2 * f->x2
-            - f->a1 * f->y1
-            - f->a2 * f->y2;
-
-    f->x2 = f->x1;
-    f->x1 = x;
-    f->y2 = f->y1;
-    f->y1 = y;
-
-    return y;
-}
 
+/* ===== filter ===== */
 void add_filter()
 {
-    if (filter_count >= MAX_FILTERS) return;
-
-    filters[filter_count].type = LPF;
-    filters[filter_count].cutoff = 800;
-    filters[filter_count].res = 0.7f; 
-    filters[filter_count].x1 = filters[filter_count].x2 = 0;
-    filters[filter_count].y1 = filters[filter_count].y2 = 0;
-
-    update_filter(&filters[filter_count]);
-
-    selected = filter_count;
-    filter_count++;
+    int index = subtractive_add_filter(&synth);
+    if (index >= 0)
+        selected = index;
 }
 
 void remove_filter(int index)
 {
-    if (index < 0 || index >= filter_count) return;
+    subtractive_remove_filter(&synth, index);
 
-    for (int i = index; i < filter_count - 1; i++)
-        filters[i] = filters[i + 1];
-
-    filter_count--;
-
-    if (filter_count == 0)
+    if (synth.filter_count == 0)
         selected = -1;
-    else if (selected >= filter_count)
-        selected = filter_count - 1;
+    else if (selected >= synth.filter_count)
+        selected = synth.filter_count - 1;
 }
 
 /* ===== audio ===== */
@@ -466,93 +330,30 @@ void audio_callback(void *u, Uint8 *stream, int len)
 {
     float *buf = (float *)stream;
     int samples = len / sizeof(float);
-    float target_amp;
-    float amp;
-
-    for (int i = 0; i < samples; i++)
-    {
-        float s = 0.0f;
-
-        for (int v = 0; v < MAX_VOICES; v++)
-        {
-            if (voices[v].active)
-                s += gen_voice(&voices[v]);
-        }
-
-        s /= 2.5;
 
-        for (int f = 0; f < filter_count; f++)
-            s = process_filter(&filters[f], s);
-
-        buf[i] = s * 0.5f;
-
-        wave_vis[wave_pos] = s;
-        wave_pos = (wave_pos + 1) % WAVE_BUF;
-
-    }
+    synth_process(u, buf, samples);
+    capture_write(&capture, buf, samples);
 }
 
 /* ===== UI ===== */
 
-void draw_text(SDL_Renderer *r, TTF_Font *f, int x, int y, const char *txt, SDL_Color c)
-{
-    SDL_Surface *s = TTF_RenderText_Solid(f, txt, c);
-    SDL_Texture *t = SDL_CreateTextureFromSurface(r, s);
-    SDL_Rect dst = {x, y, s->w, s->h};
-    SDL_RenderCopy(r, t, NULL, &dst);
-    SDL_FreeSurface(s);
-    SDL_DestroyTexture(t);
-}
 
 void draw_wave(SDL_Renderer *r)
 {
-    int ox = 10;
-    int oy = 300;
-    int w  = 680;
-    int h  = 180;
+    /* twice the window, so there's room to look for a zero crossing */
+    float wave[2 * WAVE_BUF];
+    int n = capture_read(&capture, wave, 2 * WAVE_BUF);
+    int start = scope_trigger(wave, n, WAVE_BUF);
 
     SDL_SetRenderDrawColor(r, 40,40,40,255);
-    SDL_Rect bg = {ox, oy, w, h};
-    SDL_RenderFillRect(r, &bg);
-
-    int start = -1;
-
-    for (int i = 1; i < WAVE_BUF; i++)
-    {
-        int i0 = (wave_pos - i - 1 + WAVE_BUF) % WAVE_BUF;
-        int i1 = (wave_pos - i + WAVE_BUF) % WAVE_BUF;
-
-        if (wave_vis[i0] < 0.0f && wave_vis[i1] >= 0.0f)
-        {
-            start = i1;
-            break;
-        }
-    }
-
-    if (start < 0)
-        start = wave_pos;
+    SDL_RenderFillRect(r, &scope_area);
 
+    /* the scope shows the signal before the 0.5 output gain */
     SDL_SetRenderDrawColor(r, 255,192,203,240);
-
-    for (int i = 0; i < WAVE_BUF - 1; i++)
-    {
-        int i1 = (start + i) % WAVE_BUF;
-        int i2 = (start + i + 1) % WAVE_BUF;
-
-        float v1 = wave_vis[i1];
-        float v2 = wave_vis[i2];
-
-        int x1 = ox + i * w / WAVE_BUF;
-        int x2 = ox + (i + 1) * w / WAVE_BUF;
-
-        int y1 = oy + h/2 - (int)(v1 * h/2);
-        int y2 = oy + h/2 - (int)(v2 * h/2);
-
-        SDL_RenderDrawLine(r, x1, y1, x2, y2);
-    }
+    scope_draw(r, scope_area, wave + start, n - start < WAVE_BUF ? n - start : WAVE_BUF, 2.0f);
 }
 
-void draw_keyboard_hint(SDL_Renderer *r, TTF_Font *font)
+void draw_keyboard_hint(SDL_Renderer *r)
 {
     int x0 = 80;
     int y0 = 500;
@@ -600,9 +401,8 @@ void draw_keyboard_hint(SDL_Renderer *r, TTF_Font *font)
         SDL_SetRenderDrawColor(r, 0,0,0,255);
         SDL_RenderDrawRect(r, &k);
 
-        draw_text(
-            r,
-            font,
+        text_draw(
+            &text,
             k.x + white_w / 2 - 8,
             k.y + white_h - 28,
             white_labels[i],
@@ -627,9 +427,8 @@ void draw_keyboard_hint(SDL_Renderer *r, TTF_Font *font)
 
         SDL_RenderFillRect(r, &k);
 
-        draw_text(
-            r,
-            font,
+        text_draw(
+            &text,
             k.x + black_w / 2 - 6,
             k.y + black_h - 26,
             black_labels[i],
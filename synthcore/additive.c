@@ -0,0 +1,695 @@
+#include "additive.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* an Envelope in samples, for the audio thread */
+typedef struct
+{
+    int count;
+    int loop;
+    uint32_t time[ENV_POINTS];
+    float value[ENV_POINTS];
+} EnvShape;
+
+/* what the audio thread needs of an oscillator, worked out on the UI thread */
+typedef struct
+{
+    OscShape type;
+    uint32_t inc;
+    float amp;
+    int amp_env;        /* index into env[], -1 for none */
+    int freq_env;
+    int slot;
+    unsigned serial;
+} OscVoice;
+
+/* banks with fewer slots than this aren't worth waking the workers for */
+#define POOL_MIN_SLOTS 512
+
+/* slots per chunk, at least, and frames per pool_run() at most */
+#define CHUNK_SLOTS 128
+#define CHUNKS (MAX_OSC / CHUNK_SLOTS)
+#define PIECE_FRAMES 256
+
+/*
+ * The share of the piece's playing time the pool may take, the chunks the
+ * audio thread does again after the deadline included. Waiting ends early
+ * enough for that: by then every chunk is taken, so at most one per worker
+ * is left to do again, and the audio thread knows how long one takes it.
+ */
+#define DEADLINE_SHARE 0.5
+
+/* of that, how long to wait for the pool while an import has it for one of its short jobs */
+#define CLAIM_SHARE 0.05
+
+/* two, so one late worker doesn't keep the next piece off the pool */
+#define JOBS 2
+
+struct AdditiveWork
+{
+    OscBank bank;                       /* only the slots of the chunks this thread did are valid */
+    float out[CHUNKS][PIECE_FRAMES];
+};
+
+/*
+ * Everything run_chunk() reads. A worker that's late can still be reading
+ * it after pool_run() has returned, so it's never written again until
+ * pool_done_with() says that worker has let go of it.
+ */
+struct AdditiveJob
+{
+    OscBank src;                        /* slots 0 .. start[OSC_SHAPES] of the bank at the start of the piece */
+    int bound[CHUNKS + 1];              /* chunk c covers slots bound[c] .. bound[c + 1], whole vectors */
+    int chunks;
+    int frames;
+    unsigned epoch;                     /* of the pool_run() that used it, 0 for none */
+
+    AdditiveWork *work;
+    AdditiveSynth *synth;               /* for collect_chunk(), the audio thread */
+    float *out;
+};
+
+/* never changes once published, osc[] and env[] are in the same allocation */
+struct OscSet
+{
+    int count;
+    int env_count;
+    OscVoice *osc;
+    EnvShape *env;
+};
+
+/* ===== handover ===== */
+
+/* UI thread: frees what the audio thread has given back */
+static void collect_retired(AdditiveSynth *a)
+{
+    unsigned head = atomic_load_explicit(&a->retired_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&a->retired_tail, memory_order_acquire);
+
+    for (; head != tail; head++)
+        free(a->retired[head & (RETIRED_SIZE - 1)]);
+
+    atomic_store_explicit(&a->retired_head, head, memory_order_release);
+}
+
+/* audio thread: swaps in the newest snapshot, if there's one */
+static void pick_up(AdditiveSynth *a)
+{
+    if (!atomic_load_explicit(&a->pending, memory_order_relaxed)) return;
+
+    unsigned tail = atomic_load_explicit(&a->retired_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&a->retired_head, memory_order_acquire);
+
+    /* nowhere to put the old one yet, carry on with it for another block */
+    if (a->live && tail - head == RETIRED_SIZE) return;
+
+    OscSet *set = atomic_exchange_explicit(&a->pending, NULL, memory_order_acq_rel);
+
+    if (a->live)
+    {
+        a->retired[tail & (RETIRED_SIZE - 1)] = a->live;
+        atomic_store_explicit(&a->retired_tail, tail + 1, memory_order_release);
+    }
+
+    a->live = set;
+
+    /* a slot with a new oscillator in it starts from phase 0 */
+    for (int k = 0; k < set->count; k++)
+    {
+        OscVoice *v = &set->osc[k];
+
+        if (a->serial[v->slot] != v->serial)
+        {
+            a->serial[v->slot] = v->serial;
+            a->phase[v->slot] = 0;
+            a->env_start[v->slot] = a->clock;
+        }
+    }
+}
+
+static int audible(const AdditiveSynth *a, const Oscillator *o)
+{
+    return !o->muted && o->amp > ADDITIVE_SILENT && o->freq < a->sample_rate / 2;
+}
+
+/* adds e to the set, returns its index or -1 when it's empty */
+static int add_envelope(AdditiveSynth *a, OscSet *set, const Envelope *e)
+{
+    if (e->count <= 0) return -1;
+
+    EnvShape *shape = &set->env[set->env_count];
+
+    shape->count = e->count < ENV_POINTS ? e->count : ENV_POINTS;
+    shape->loop = e->loop;
+
+    for (int i = 0; i < shape->count; i++)
+    {
+        double t = e->time[i] > 0 ? e->time[i] * a->sample_rate : 0;
+
+        shape->time[i] = (uint32_t)t;
+        shape->value[i] = (float)e->value[i];
+
+        /* times that go backwards would divide by 0 below */
+        if (i > 0 && shape->time[i] < shape->time[i - 1])
+            shape->time[i] = shape->time[i - 1];
+    }
+
+    return set->env_count++;
+}
+
+int additive_publish(AdditiveSynth *a)
+{
+    collect_retired(a);
+
+    size_t size = sizeof(OscSet) + a->osc_count * (sizeof(OscVoice) + 2 * sizeof(EnvShape));
+
+    OscSet *set = malloc(size);
+    if (!set) return -1;
+
+    set->osc = (OscVoice *)(set + 1);
+    set->env = (EnvShape *)(set->osc + a->osc_count);
+    set->env_count = 0;
+
+    /* only the audible ones, packed together */
+    int n = 0;
+
+    for (int k = 0; k < a->osc_count; k++)
+    {
+        Oscillator *o = &a->osc[k];
+
+        if (!audible(a, o)) continue;
+
+        set->osc[n++] = (OscVoice){o->type, nco_increment(o->freq, a->sample_rate), (float)o->amp,
+                                   add_envelope(a, set, &o->amp_env), add_envelope(a, set, &o->freq_env),
+                                   o->slot, o->serial};
+    }
+
+    set->count = n;
+    a->active_count = n;
+
+    /* the contents are written before the audio thread can see the pointer */
+    OscSet *stale = atomic_exchange_explicit(&a->pending, set, memory_order_acq_rel);
+
+    /* published but never picked up, the audio thread hasn't seen it */
+    free(stale);
+    return 0;
+}
+
+/* ===== envelopes ===== */
+
+static float env_at(const EnvShape *e, uint32_t t)
+{
+    uint32_t length = e->time[e->count - 1];
+
+    if (e->loop && length > 0)
+        t %= length;
+
+    if (t <= e->time[0]) return e->value[0];
+
+    /* t is past time[i - 1], so time[i] > time[i - 1] when t is before it */
+    for (int i = 1; i < e->count; i++)
+    {
+        if (t < e->time[i])
+        {
+            float x = (float)(t - e->time[i - 1]) / (e->time[i] - e->time[i - 1]);
+            return e->value[i - 1] + x * (e->value[i] - e->value[i - 1]);
+        }
+    }
+
+    return e->value[e->count - 1];
+}
+
+/* the value at both ends of the control period, 1 without an envelope */
+static void env_period(const OscSet *set, int env, uint32_t t, int control, float *from, float *to)
+{
+    if (env < 0)
+    {
+        *from = *to = 1.0f;
+        return;
+    }
+
+    *from = env_at(&set->env[env], t);
+    *to = env_at(&set->env[env], t + control);
+}
+
+/*
+ * Sets amp / inc of every oscillator with an envelope to where the straight
+ * line between the two grid points around the clock is now, and the steps
+ * to follow it to the next one. It only depends on the clock, so it doesn't
+ * matter where a block started.
+ */
+static void set_ramps(AdditiveSynth *a, int control)
+{
+    OscBank *b = &a->bank;
+    IfftBank *f = &a->ifft;
+    OscSet *set = a->live;
+
+    uint32_t into = a->clock % control;
+    uint32_t grid = a->clock - into;
+
+    int slots = b->start[OSC_SHAPES];
+    int total = slots + f->count;
+
+    for (int j = 0; j < total; j++)
+    {
+        int owner = j < slots ? b->owner[j] : f->owner[j - slots];
+        if (owner < 0) continue;
+
+        OscVoice *v = &set->osc[owner];
+        if (v->amp_env < 0 && v->freq_env < 0) continue;
+
+        uint32_t start = a->env_start[v->slot];
+        uint32_t t = grid > start ? grid - start : 0;
+
+        float g0, g1, r0, r1;
+        env_period(set, v->amp_env, t, control, &g0, &g1);
+        env_period(set, v->freq_env, t, control, &r0, &r1);
+
+        double inc0 = v->inc * (double)r0;
+        double inc1 = v->inc * (double)r1;
+
+        float amp_step = v->amp * (g1 - g0) / control;
+        float amp = v->amp * g0 + amp_step * into;
+        int32_t inc_step = (int32_t)lrint((inc1 - inc0) / control);
+        uint32_t inc = (uint32_t)lrint(inc0) + (uint32_t)inc_step * into;
+
+        /* an envelope that takes it to Nyquist or past it mutes it there */
+        if (inc0 >= 2147483648.0 || inc1 >= 2147483648.0)
+        {
+            amp = amp_step = 0;
+            inc_step = 0;
+            inc = v->inc;
+        }
+
+        if (j < slots)
+        {
+            b->amp[j] = amp;
+            b->amp_step[j] = amp_step;
+            b->inc[j] = inc;
+            b->inc_step[j] = inc_step;
+        }
+        else
+        {
+            /* no ramps in the IFFT, it picks up the value once per hop */
+            f->amp[j - slots] = amp;
+            f->inc[j - slots] = inc;
+        }
+    }
+}
+
+/* ===== threads ===== */
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void copy_slots(OscBank *to, const OscBank *from, int lo, int hi)
+{
+    int n = hi - lo;
+
+    memcpy(&to->phase[lo], &from->phase[lo], n * sizeof(uint32_t));
+    memcpy(&to->inc[lo], &from->inc[lo], n * sizeof(uint32_t));
+    memcpy(&to->amp[lo], &from->amp[lo], n * sizeof(float));
+}
+
+/* and the ramps, for a copy that's rendered */
+static void copy_ramps(OscBank *to, const OscBank *from, int lo, int hi)
+{
+    int n = hi - lo;
+
+    memcpy(&to->amp_step[lo], &from->amp_step[lo], n * sizeof(float));
+    memcpy(&to->inc_step[lo], &from->inc_step[lo], n * sizeof(int32_t));
+}
+
+/*
+ * Any thread: renders chunk c from a copy of its slots, into the thread's
+ * own AdditiveWork. It reads nothing but the job, which stays as it is for
+ * as long as a late worker might be here.
+ */
+static void run_chunk(void *ctx, int c, int thread)
+{
+    AdditiveJob *job = ctx;
+    AdditiveWork *w = &job->work[thread];
+    int lo = job->bound[c];
+    int hi = job->bound[c + 1];
+    double start = thread == 0 ? now_ns() : 0;
+
+    copy_slots(&w->bank, &job->src, lo, hi);
+    copy_ramps(&w->bank, &job->src, lo, hi);
+    memcpy(w->bank.start, job->src.start, sizeof(w->bank.start));
+    w->bank.resonator = job->src.resonator;
+
+    memset(w->out[c], 0, job->frames * sizeof(float));
+    oscbank_render_range(&w->bank, lo, hi, w->out[c], job->frames);
+
+    /* the audio thread's own chunks, for the deadline */
+    if (thread == 0)
+    {
+        AdditiveSynth *a = job->synth;
+        a->chunk_ns += (now_ns() - start - a->chunk_ns) * 0.1;
+    }
+}
+
+/* audio thread: takes over what thread made of chunk c */
+static void collect_chunk(void *ctx, int c, int thread)
+{
+    AdditiveJob *job = ctx;
+    AdditiveWork *w = &job->work[thread];
+
+    copy_slots(&job->synth->bank, &w->bank, job->bound[c], job->bound[c + 1]);
+
+    for (int i = 0; i < job->frames; i++)
+        job->out[i] += w->out[c][i];
+}
+
+/* chunk c covers slots bound[c] .. bound[c + 1], whole vectors; returns the number of chunks */
+static int chunk_bounds(int *bound, int slots)
+{
+    int chunks = slots / CHUNK_SLOTS;
+    int vectors = slots / OSCBANK_LANES;
+
+    for (int c = 0; c <= chunks; c++)
+        bound[c] = vectors * c / chunks * OSCBANK_LANES;
+
+    return chunks;
+}
+
+/* the pool's chunks on this thread alone, added up in the same order, so it sounds the same to the bit */
+static void render_chunks_here(OscBank *b, float *out, int frames)
+{
+    int bound[CHUNKS + 1];
+    int chunks = chunk_bounds(bound, b->start[OSC_SHAPES]);
+    float part[PIECE_FRAMES];
+
+    for (int c = 0; c < chunks; c++)
+    {
+        memset(part, 0, frames * sizeof(float));
+        oscbank_render_range(b, bound[c], bound[c + 1], part, frames);
+
+        for (int i = 0; i < frames; i++)
+            out[i] += part[i];
+    }
+}
+
+/* a job no worker is on any more, NULL when they're all still taken */
+static AdditiveJob *free_job(AdditiveSynth *a)
+{
+    for (int i = 0; i < JOBS; i++)
+    {
+        AdditiveJob *job = &a->jobs[(a->next_job + i) % JOBS];
+
+        if (!job->epoch || pool_done_with(a->pool, job->epoch))
+        {
+            a->next_job = (a->next_job + i + 1) % JOBS;
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+/* the bank's share of a piece, on the pool when it's worth it */
+static void render_bank(AdditiveSynth *a, float *out, int frames)
+{
+    OscBank *b = &a->bank;
+    int slots = b->start[OSC_SHAPES];
+
+    if (!a->pool || slots < POOL_MIN_SLOTS)
+    {
+        oscbank_render(b, out, frames);
+        return;
+    }
+
+    AdditiveJob *job = free_job(a);
+
+    /* late workers still on both jobs, or someone else (an import) has the pool too long */
+    if (!job || !pool_claim_within(a->pool, CLAIM_SHARE * frames / a->sample_rate))
+    {
+        render_chunks_here(b, out, frames);
+        return;
+    }
+
+    job->chunks = chunk_bounds(job->bound, slots);
+    job->frames = frames;
+    job->out = out;
+
+    copy_slots(&job->src, b, 0, slots);
+    copy_ramps(&job->src, b, 0, slots);
+    memcpy(job->src.start, b->start, sizeof(b->start));
+    job->src.resonator = b->resonator;
+
+    /* room to do one chunk per worker again after the deadline */
+    double deadline = (DEADLINE_SHARE - CLAIM_SHARE) * frames / a->sample_rate - a->pool->threads * a->chunk_ns * 1e-9;
+    if (deadline < 0) deadline = 0;
+
+    job->epoch = pool_run(a->pool, run_chunk, collect_chunk, job, job->chunks, deadline);
+    pool_release(a->pool);
+}
+
+int additive_set_pool(AdditiveSynth *a, Pool *pool)
+{
+    free(a->work);
+    free(a->jobs);
+    a->work = NULL;
+    a->jobs = NULL;
+    a->pool = NULL;
+
+    if (!pool) return 0;
+
+    void *work, *jobs;
+    if (posix_memalign(&work, 64, (pool->threads + 1) * sizeof(AdditiveWork)) != 0)
+        return -1;
+
+    if (posix_memalign(&jobs, 64, JOBS * sizeof(AdditiveJob)) != 0)
+    {
+        free(work);
+        return -1;
+    }
+
+    a->work = work;
+    a->jobs = jobs;
+    a->next_job = 0;
+
+    for (int i = 0; i < JOBS; i++)
+        a->jobs[i] = (AdditiveJob){.epoch = 0, .work = a->work, .synth = a};
+
+    a->pool = pool;
+    return 0;
+}
+
+/* ===== rendering ===== */
+
+/* copies the live set into the bank grouped by shape, in IFFT mode the sines into the IFFT bank */
+static void load_bank(AdditiveSynth *a, AdditiveEngine engine)
+{
+    OscBank *b = &a->bank;
+    IfftBank *f = &a->ifft;
+    OscSet *set = a->live;
+    int use_ifft = engine == ADDITIVE_IFFT;
+    int count[OSC_SHAPES] = {0};
+
+    for (int k = 0; k < set->count; k++)
+        count[set->osc[k].type]++;
+
+    if (use_ifft)
+        count[OSC_SINE] = 0;
+
+    oscbank_layout(b, count);
+    b->resonator = engine == ADDITIVE_RESONATOR;
+    f->count = 0;
+
+    int next[OSC_SHAPES];
+    memcpy(next, b->start, sizeof(next));
+
+    for (int k = 0; k < set->count; k++)
+    {
+        OscVoice *v = &set->osc[k];
+
+        if (use_ifft && v->type == OSC_SINE)
+        {
+            int i = f->count++;
+
+            f->phase[i] = a->phase[v->slot];
+            f->inc[i] = v->inc;
+            f->amp[i] = v->amp;
+            f->owner[i] = k;
+            continue;
+        }
+
+        int slot = next[v->type]++;
+
+        b->phase[slot] = a->phase[v->slot];
+        b->inc[slot] = v->inc;
+        b->amp[slot] = v->amp;
+        b->owner[slot] = k;
+    }
+}
+
+static void store_phases(AdditiveSynth *a)
+{
+    OscBank *b = &a->bank;
+    IfftBank *f = &a->ifft;
+    OscSet *set = a->live;
+
+    for (int slot = 0; slot < b->start[OSC_SHAPES]; slot++)
+    {
+        if (b->owner[slot] >= 0)
+            a->phase[set->osc[b->owner[slot]].slot] = b->phase[slot];
+    }
+
+    for (int i = 0; i < f->count; i++)
+        a->phase[set->osc[f->owner[i]].slot] = f->phase[i];
+}
+
+static void additive_process(SynthState *s, float *out, int frames)
+{
+    AdditiveSynth *a = (AdditiveSynth *)s;
+
+    memset(out, 0, frames * sizeof(float));
+
+    pick_up(a);
+
+    int count = a->live ? a->live->count : 0;
+
+    /* once per block, so the whole block is one engine and one rate whatever the UI does meanwhile */
+    int playing = atomic_load_explicit(&a->playing, memory_order_relaxed);
+    AdditiveEngine engine = (AdditiveEngine)atomic_load_explicit(&a->engine, memory_order_relaxed);
+    int control = atomic_load_explicit(&a->control, memory_order_relaxed);
+
+    if (control <= 0)
+        control = ADDITIVE_CONTROL;
+
+    /* every envelope starts again with playing */
+    if (playing && !a->was_playing)
+    {
+        a->clock = 0;
+        memset(a->env_start, 0, sizeof(a->env_start));
+    }
+    a->was_playing = playing;
+
+    int use_ifft = playing && engine == ADDITIVE_IFFT;
+
+    /* the overlap left from before a pause or another engine is stale */
+    if (use_ifft && !a->ifft_running)
+        ifftbank_reset(&a->ifft);
+    a->ifft_running = use_ifft;
+
+    if (playing && count > 0)
+    {
+        int envelopes = a->live->env_count > 0;
+
+        load_bank(a, engine);
+
+        /* with envelopes, one piece per control period, in one go without (or per PIECE_FRAMES on the pool) */
+        for (int done = 0; done < frames; )
+        {
+            int n = frames - done;
+
+            if (a->pool && n > PIECE_FRAMES)
+                n = PIECE_FRAMES;
+
+            if (envelopes)
+            {
+                int left = control - (int)(a->clock % control);
+                if (n > left) n = left;
+
+                set_ramps(a, control);
+            }
+
+            render_bank(a, out + done, n);
+            if (use_ifft)
+                ifftbank_render(&a->ifft, out + done, n);
+
+            a->clock += n;
+            done += n;
+        }
+
+        store_phases(a);
+    }
+
+    if (count > 0)
+    {
+        float norm = 1.0f / count;
+
+        for (int i = 0; i < frames; i++)
+            out[i] *= norm;
+    }
+}
+
+void additive_init(AdditiveSynth *a, double sample_rate)
+{
+    memset(a, 0, sizeof(*a));
+
+    a->base.process = additive_process;
+    a->sample_rate = sample_rate;
+
+    atomic_init(&a->playing, 0);
+    atomic_init(&a->engine, ADDITIVE_POLY);
+    atomic_init(&a->control, ADDITIVE_CONTROL);
+
+    for (int i = 0; i < MAX_OSC; i++)
+        a->free_slots[i] = MAX_OSC - 1 - i;
+    a->free_count = MAX_OSC;
+
+    atomic_init(&a->pending, NULL);
+    atomic_init(&a->retired_head, 0);
+    atomic_init(&a->retired_tail, 0);
+
+    nco_init();
+    ifftbank_init(&a->ifft);
+}
+
+void additive_free(AdditiveSynth *a)
+{
+    collect_retired(a);
+
+    free(atomic_exchange(&a->pending, NULL));
+    free(a->live);
+    a->live = NULL;
+
+    additive_set_pool(a, NULL);
+}
+
+int additive_add(AdditiveSynth *a)
+{
+    if (a->osc_count >= MAX_OSC) return -1;
+
+    Oscillator *o = &a->osc[a->osc_count];
+
+    o->type = OSC_SINE;
+    o->freq = 220;
+    o->amp = 0.5;
+    o->muted = 0;
+    o->amp_env.count = 0;
+    o->freq_env.count = 0;
+    o->slot = a->free_slots[--a->free_count];
+    o->serial = ++a->next_serial;
+
+    return a->osc_count++;
+}
+
+void additive_remove(AdditiveSynth *a, int index)
+{
+    if (index < 0 || index >= a->osc_count) return;
+
+    a->free_slots[a->free_count++] = a->osc[index].slot;
+
+    for (int i = index; i < a->osc_count - 1; i++)
+        a->osc[i] = a->osc[i + 1];
+
+    a->osc_count--;
+}
+
+void additive_clear(AdditiveSynth *a)
+{
+    for (int i = 0; i < a->osc_count; i++)
+        a->free_slots[a->free_count++] = a->osc[i].slot;
+
+    a->osc_count = 0;
+}
@@ -0,0 +1,213 @@
+#ifndef ADDITIVE_H
+#define ADDITIVE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "ifftbank.h"
+#include "nco.h"
+#include "osc.h"
+#include "oscbank.h"
+#include "pool.h"
+#include "synth.h"
+
+/*
+ * The additive synth: a bank of up to MAX_OSC oscillators mixed together.
+ *
+ * osc[] is what the UI edits, and only the UI thread touches it. The audio
+ * thread never sees it: additive_publish() copies it into a new snapshot
+ * (an OscSet) and hands that over with one atomic pointer swap. The audio
+ * thread picks it up at the start of its next block and renders from it
+ * until the next one arrives, so a block always sees one whole, unchanging
+ * set of oscillators, however the UI adds, removes or shifts them meanwhile.
+ * The snapshot the audio thread lets go of goes back to the UI thread,
+ * which frees it on its next publish; the audio thread never allocates or
+ * frees anything.
+ *
+ * The phases stay with the audio thread, by slot. Every oscillator gets a
+ * slot when it's added and keeps it until it's removed, so removing one
+ * doesn't move the phases of the others. A new oscillator in an old slot
+ * has a new serial number, which tells the audio thread to start it at 0.
+ *
+ * A snapshot only holds the oscillators that can be heard: muted ones,
+ * ones quieter than ADDITIVE_SILENT and ones at or above Nyquist (which
+ * would only alias) are left out when it's built, so the audio thread never
+ * spends a cycle on them, and the mix is divided by the number of audible
+ * ones. active_count says how many made it in. A left out oscillator keeps
+ * the phase it had and carries on from there when it's audible again.
+ *
+ * The snapshot is built again from all of osc[] on every publish, not
+ * patched where something changed. It has to be a new copy anyway, since
+ * the audio thread may still be rendering the old one, and working out the
+ * entries on the way costs little more than copying them: at MAX_OSC it's
+ * a fraction of a millisecond, once per change, on the UI thread
+ * (additive_publish in bench_kernels). The audio thread's side is the same
+ * pointer swap whatever changed.
+ *
+ * Every block the oscillators of the snapshot are copied into an OscBank,
+ * sorted by shape, rendered there a vector at a time, and their phases
+ * copied back.
+ *
+ * Every oscillator can have two breakpoint envelopes, one that scales its
+ * amplitude and one that scales its frequency, running from when it was
+ * added or from when playing starts. They're worked out only every
+ * `control` samples (ADDITIVE_CONTROL unless you change it), on a grid
+ * counted from the start, and the bank ramps in a straight line from one
+ * point of the grid to the next (amp_step / inc_step), so an envelope costs
+ * next to nothing per sample and the result doesn't depend on the block
+ * size. The inverse FFT takes the value at the start of every block instead
+ * of a ramp, it only changes once per hop anyway.
+ *
+ * With a Pool (additive_set_pool()) and enough oscillators, the bank is
+ * cut into chunks of slots that the pool's threads render side by side,
+ * each from its own copy, and the audio thread adds their outputs up in
+ * chunk order. So the result is the same whatever thread did what, and a
+ * worker that's late is simply done without (see pool.h). The threads copy
+ * their slots from a job, a copy of the bank made for that piece, never from
+ * the bank itself, so a late worker can't read the next piece half set up;
+ * and a job is only filled again once no worker is on it any more. The
+ * pool can have a second caller (an import, see analysis.h); while that one
+ * has it claimed, the audio thread renders its pieces by itself, chunk by
+ * chunk in the same order, so it sounds the same, only slower.
+ *
+ * The engine decides how the sines are made: the polynomial of the bank,
+ * the resonator (one complex multiply per sample), which is cheaper when
+ * there are thousands of partials, or an inverse FFT per hop (IfftBank),
+ * whose cost hardly grows with the number of partials at all. They all sound
+ * the same, apart from the IFFT's hop of latency and its once-per-hop
+ * parameter updates, and switching between them doesn't move any phase.
+ */
+
+#define MAX_OSC 4096
+
+/* samples between two envelope points, by default */
+#define ADDITIVE_CONTROL 64
+
+/* quieter than this (-100 dB) counts as silent */
+#define ADDITIVE_SILENT 1e-5
+
+#if MAX_OSC > OSCBANK_MAX
+#error "MAX_OSC has to fit in the oscillator bank"
+#endif
+
+typedef enum
+{
+    ADDITIVE_POLY,
+    ADDITIVE_RESONATOR,
+    ADDITIVE_IFFT,
+    ADDITIVE_ENGINES
+} AdditiveEngine;
+
+#define ENV_POINTS 16
+
+/*
+ * Straight lines from point to point, the value of the first point before
+ * it and of the last one after it. With loop set it starts again after the
+ * last point. The value multiplies the amplitude or the frequency.
+ */
+typedef struct
+{
+    int count;                  /* 0 = no envelope, the value stays 1 */
+    int loop;
+    double time[ENV_POINTS];    /* seconds from the start, rising */
+    double value[ENV_POINTS];
+} Envelope;
+
+typedef struct
+{
+    OscShape type;
+    double freq;
+    double amp;
+    int muted;
+    Envelope amp_env;
+    Envelope freq_env;
+
+    int slot;           /* set by additive_add(), leave these two alone */
+    unsigned serial;
+} Oscillator;
+
+/* one published set of oscillators, see additive.c */
+typedef struct OscSet OscSet;
+
+/* one pool thread's copy of the bank and outputs, see additive.c */
+typedef struct AdditiveWork AdditiveWork;
+
+/* what the pool renders one piece from, see additive.c */
+typedef struct AdditiveJob AdditiveJob;
+
+/* snapshots the audio thread is done with, on their way back to the UI thread */
+#define RETIRED_SIZE 16     /* power of two */
+
+typedef struct
+{
+    SynthState base;
+
+    /* UI thread */
+    Oscillator osc[MAX_OSC];
+    int osc_count;
+    int active_count;                       /* audible ones in the last snapshot */
+    int free_slots[MAX_OSC];
+    int free_count;
+    unsigned next_serial;
+
+    /* set by the UI thread, the audio thread reads each once at the start of a block */
+    atomic_int playing;
+    atomic_int engine;                      /* an AdditiveEngine */
+    atomic_int control;                     /* samples between envelope points */
+
+    /* the handover */
+    _Atomic(OscSet *) pending;              /* published, not picked up yet */
+    OscSet *retired[RETIRED_SIZE];
+    atomic_uint retired_head;               /* written by the UI thread */
+    atomic_uint retired_tail;               /* written by the audio thread */
+
+    /* audio thread */
+    OscSet *live;
+    uint32_t phase[MAX_OSC];                /* by slot */
+    unsigned serial[MAX_OSC];               /* whose phase phase[slot] is */
+    uint32_t env_start[MAX_OSC];            /* by slot, clock when its envelopes started */
+    uint32_t clock;                         /* samples played since playing started */
+    int was_playing;
+
+    OscBank bank;
+    IfftBank ifft;
+    int ifft_running;
+
+    /* threads */
+    Pool *pool;
+    AdditiveWork *work;                     /* one per pool thread, the caller first */
+    AdditiveJob *jobs;                      /* used in turn */
+    int next_job;
+    double chunk_ns;                        /* what a chunk takes the audio thread, on average */
+
+    double sample_rate;
+} AdditiveSynth;
+
+void additive_init(AdditiveSynth *a, double sample_rate);
+
+/* frees the snapshots and the thread copies, once the audio thread is stopped */
+void additive_free(AdditiveSynth *a);
+
+/*
+ * Renders big banks on the threads of pool from now on, NULL for the audio
+ * thread alone. Not while the audio is running. Returns 0, or -1 when
+ * there's no memory for the threads' copies (it stays on one thread).
+ */
+int additive_set_pool(AdditiveSynth *a, Pool *pool);
+
+/* adds a 220 Hz sine, returns its index or -1 when the bank is full */
+int additive_add(AdditiveSynth *a);
+
+void additive_remove(AdditiveSynth *a, int index);
+
+/* removes every oscillator */
+void additive_clear(AdditiveSynth *a);
+
+/*
+ * Sends osc[] to the audio thread, call it after a change. Nothing reaches
+ * the audio before that. Returns 0, or -1 when there's no memory for the
+ * snapshot (the audio keeps the old one).
+ */
+int additive_publish(AdditiveSynth *a);
+
+#endif
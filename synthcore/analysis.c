@@ -0,0 +1,544 @@
+#include "analysis.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wav.h"
+
+#define PI 3.14159265358979323846
+
+#define SIZE ANALYSIS_SIZE
+#define HOP ANALYSIS_HOP
+#define BATCH ANALYSIS_BATCH
+
+/* samples a batch of frames covers */
+#define SPAN ((BATCH - 1) * HOP + SIZE)
+
+/* between tries for a pool someone else has claimed, in ns */
+#define CLAIM_NAP_NS 200000
+
+struct AnalysisWork
+{
+    float re[SIZE];
+    float im[SIZE];
+};
+
+/* one batch, the frames of it are the chunks of a pool job */
+typedef struct
+{
+    AnalysisWork *work;                 /* one per thread */
+    const float *buf;                   /* frame k of the batch starts at buf[k * HOP] */
+    int first;                          /* the frame of the batch chunk 0 of the pool job is */
+    double sample_rate;
+
+    AnalysisPeak peak[BATCH][ANALYSIS_PEAKS];   /* strongest first */
+    int peak_count[BATCH];
+} Batch;
+
+static FftPlan plan;
+static float window[SIZE];
+static float floor_power;               /* |X|^2 of a sine at ANALYSIS_FLOOR */
+static float amp_scale;                 /* sine amplitude per |X| */
+static int tables_ready;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void init_tables()
+{
+    double sum = 0;
+
+    fft_init(&plan, ANALYSIS_BITS);
+
+    /* 4-term Blackman-Harris, sidelobes below -92 dB, so below the floor */
+    for (int n = 0; n < SIZE; n++)
+    {
+        double x = 2 * PI * n / SIZE;
+        window[n] = (float)(0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x));
+        sum += window[n];
+    }
+
+    /* a sine of amplitude A peaks at |X| = A / 2 * sum(window) */
+    amp_scale = (float)(2 / sum);
+    floor_power = (float)(ANALYSIS_FLOOR / amp_scale * ANALYSIS_FLOOR / amp_scale);
+
+    tables_ready = 1;
+}
+
+/* ===== peaks ===== */
+
+/* keeps the strongest ANALYSIS_PEAKS, sorted */
+static void add_peak(AnalysisPeak *peak, int *count, float freq, float amp)
+{
+    int i = *count < ANALYSIS_PEAKS ? (*count)++ : ANALYSIS_PEAKS;
+
+    if (i == ANALYSIS_PEAKS && amp <= peak[ANALYSIS_PEAKS - 1].amp) return;
+
+    if (i == ANALYSIS_PEAKS) i--;
+
+    for (; i > 0 && peak[i - 1].amp < amp; i--)
+        peak[i] = peak[i - 1];
+
+    peak[i] = (AnalysisPeak){freq, amp};
+}
+
+/* PoolTask: the peaks of frame first + `chunk` of the batch */
+static void analyse_frame(void *ctx, int chunk, int thread)
+{
+    Batch *b = ctx;
+    AnalysisWork *w = &b->work[thread];
+    int frame = b->first + chunk;
+    const float *x = b->buf + frame * HOP;
+
+    for (int n = 0; n < SIZE; n++)
+    {
+        w->re[n] = x[n] * window[n];
+        w->im[n] = 0;
+    }
+
+    fft_forward(&plan, w->re, w->im);
+
+    /* power of bins 0 .. SIZE / 2, over re[] */
+    float *power = w->re;
+
+    for (int k = 0; k <= SIZE / 2; k++)
+        power[k] = w->re[k] * w->re[k] + w->im[k] * w->im[k];
+
+    AnalysisPeak *peak = b->peak[frame];
+    int count = 0;
+
+    for (int k = 1; k < SIZE / 2; k++)
+    {
+        if (power[k] <= floor_power || power[k] <= power[k - 1] || power[k] < power[k + 1])
+            continue;
+
+        /* parabola through the log power of the three bins, its top is the sine */
+        float l = logf(power[k - 1] + 1e-30f);
+        float c = logf(power[k]);
+        float r = logf(power[k + 1] + 1e-30f);
+        float d = 0.5f * (l - r) / (l - 2 * c + r);
+        float top = c - 0.25f * (l - r) * d;
+
+        float freq = (float)((k + d) * b->sample_rate / SIZE);
+        float amp = expf(0.5f * top) * amp_scale;
+
+        add_peak(peak, &count, freq, amp);
+    }
+
+    b->peak_count[frame] = count;
+}
+
+/* ===== tracks ===== */
+
+static AnalysisTrack *new_track(Analysis *an, long first)
+{
+    if (an->track_count == an->track_capacity)
+    {
+        int capacity = an->track_capacity ? 2 * an->track_capacity : 256;
+        AnalysisTrack *track = realloc(an->track, capacity * sizeof(AnalysisTrack));
+        if (!track) return NULL;
+
+        an->track = track;
+        an->track_capacity = capacity;
+    }
+
+    AnalysisTrack *t = &an->track[an->track_count++];
+    *t = (AnalysisTrack){first, 0, 0, NULL};
+    return t;
+}
+
+static int extend(AnalysisTrack *t, AnalysisPeak p)
+{
+    if (t->count == t->capacity)
+    {
+        int capacity = t->capacity ? 2 * t->capacity : 16;
+        AnalysisPeak *peak = realloc(t->peak, capacity * sizeof(AnalysisPeak));
+        if (!peak) return -1;
+
+        t->peak = peak;
+        t->capacity = capacity;
+    }
+
+    t->peak[t->count++] = p;
+    return 0;
+}
+
+/* a track that didn't make it past ANALYSIS_MIN_FRAMES is emptied, and swept out at the end */
+static void close_track(AnalysisTrack *t)
+{
+    if (t->count >= ANALYSIS_MIN_FRAMES) return;
+
+    free(t->peak);
+    *t = (AnalysisTrack){0, 0, 0, NULL};
+}
+
+/*
+ * Hands the peaks of frame f to the tracks that were open after frame f - 1
+ * (open[], by index), strongest peak first, each to the closest track within
+ * ANALYSIS_DRIFT. Peaks without one start a track, tracks without one end.
+ * open[] then holds the tracks still open after frame f.
+ */
+static int track_frame(Analysis *an, long f, const AnalysisPeak *peak, int count, int *open, int *open_count)
+{
+    int next[ANALYSIS_PEAKS];
+    int next_count = 0;
+    int taken[ANALYSIS_PEAKS] = {0};
+
+    for (int p = 0; p < count; p++)
+    {
+        int best = -1;
+        float best_dist = 0;
+
+        for (int i = 0; i < *open_count; i++)
+        {
+            if (taken[i]) continue;
+
+            AnalysisTrack *t = &an->track[open[i]];
+            float last = t->peak[t->count - 1].freq;
+            float dist = fabsf(peak[p].freq - last);
+
+            if (dist < ANALYSIS_DRIFT * last && (best < 0 || dist < best_dist))
+            {
+                best = i;
+                best_dist = dist;
+            }
+        }
+
+        int index;
+
+        if (best >= 0)
+        {
+            taken[best] = 1;
+            index = open[best];
+        }
+        else
+        {
+            if (!new_track(an, f)) return -1;
+            index = an->track_count - 1;
+        }
+
+        if (extend(&an->track[index], peak[p]) < 0) return -1;
+        next[next_count++] = index;
+    }
+
+    for (int i = 0; i < *open_count; i++)
+    {
+        if (!taken[i])
+            close_track(&an->track[open[i]]);
+    }
+
+    memcpy(open, next, next_count * sizeof(int));
+    *open_count = next_count;
+    return 0;
+}
+
+static void sweep(Analysis *an)
+{
+    int kept = 0;
+
+    for (int i = 0; i < an->track_count; i++)
+    {
+        if (an->track[i].count > 0)
+            an->track[kept++] = an->track[i];
+    }
+
+    an->track_count = kept;
+}
+
+/* ===== reading ===== */
+
+/* fills buf[from .. SPAN) from the file, with zeros past its end */
+static int fill(WavReader *r, float *buf, int from)
+{
+    while (from < SPAN)
+    {
+        int got = wav_reader_read(r, buf + from, SPAN - from);
+        if (got < 0) return -1;
+        if (got == 0) break;
+
+        from += got;
+    }
+
+    memset(buf + from, 0, (SPAN - from) * sizeof(float));
+    return 0;
+}
+
+int analysis_run(Analysis *an, const char *path, Pool *pool)
+{
+    WavReader r;
+    double start = now();
+
+    memset(an, 0, sizeof(*an));
+
+    if (!tables_ready)
+        init_tables();
+
+    if (wav_reader_open(&r, path) < 0) return -1;
+
+    an->sample_rate = r.sample_rate;
+    an->seconds = (double)r.frames / r.sample_rate;
+
+    /* frame f is centred on sample f * HOP, from the first sample to the last */
+    an->frames = r.frames / HOP + 1;
+
+    int threads = pool ? pool->threads + 1 : 1;
+    float *buf = malloc(SPAN * sizeof(float));
+    Batch *b = malloc(sizeof(Batch));
+    AnalysisWork *work = malloc(threads * sizeof(AnalysisWork));
+    int open[ANALYSIS_PEAKS];
+    int open_count = 0;
+    int result = -1;
+
+    if (!buf || !b || !work) goto done;
+
+    b->work = work;
+    b->buf = buf;
+    b->sample_rate = r.sample_rate;
+
+    /* the first frame is centred on sample 0, so half a frame of silence before it */
+    memset(buf, 0, SIZE / 2 * sizeof(float));
+    if (fill(&r, buf, SIZE / 2) < 0) goto done;
+
+    for (long f = 0; f < an->frames; f += BATCH)
+    {
+        int frames = an->frames - f < BATCH ? (int)(an->frames - f) : BATCH;
+
+        if (pool)
+        {
+            /*
+             * A frame per thread at a time, so the audio thread, which may
+             * want the pool for its next piece, waits for one frame at most.
+             * It holds it for a piece at a time.
+             */
+            for (b->first = 0; b->first < frames; b->first += threads)
+            {
+                int chunks = frames - b->first < threads ? frames - b->first : threads;
+
+                while (!pool_claim(pool))
+                    nanosleep(&(struct timespec){0, CLAIM_NAP_NS}, NULL);
+
+                pool_run(pool, analyse_frame, NULL, b, chunks, POOL_NO_DEADLINE);
+                pool_release(pool);
+            }
+        }
+        else
+        {
+            b->first = 0;
+            for (int k = 0; k < frames; k++)
+                analyse_frame(b, k, 0);
+        }
+
+        for (int k = 0; k < frames; k++)
+        {
+            if (track_frame(an, f + k, b->peak[k], b->peak_count[k], open, &open_count) < 0)
+                goto done;
+        }
+
+        /* the next batch starts BATCH hops on, keep the overlap */
+        memmove(buf, buf + BATCH * HOP, (SPAN - BATCH * HOP) * sizeof(float));
+        if (fill(&r, buf, SPAN - BATCH * HOP) < 0) goto done;
+    }
+
+    for (int i = 0; i < open_count; i++)
+        close_track(&an->track[open[i]]);
+
+    sweep(an);
+    result = 0;
+
+done:
+    free(buf);
+    free(b);
+    free(work);
+    wav_reader_close(&r);
+
+    an->wall_seconds = now() - start;
+    return result;
+}
+
+void analysis_free(Analysis *an)
+{
+    for (int i = 0; i < an->track_count; i++)
+        free(an->track[i].peak);
+
+    free(an->track);
+    memset(an, 0, sizeof(*an));
+}
+
+/* ===== resynthesis ===== */
+
+typedef struct
+{
+    double energy;
+    int index;
+} Ranked;
+
+static int by_energy(const void *x, const void *y)
+{
+    const Ranked *a = x;
+    const Ranked *b = y;
+
+    return (a->energy < b->energy) - (a->energy > b->energy);
+}
+
+/*
+ * Puts ENV_POINTS of the n points (t, v) into e: the two ends, and then
+ * again and again the point that's furthest from the lines through the ones
+ * picked so far. keep[] is scratch, n long.
+ */
+static void thin_out(const double *t, const double *v, int n, char *keep, Envelope *e)
+{
+    int kept = n < 2 ? n : 2;
+
+    memset(keep, n <= ENV_POINTS, n);
+    keep[0] = keep[n - 1] = 1;
+
+    while (n > ENV_POINTS && kept < ENV_POINTS)
+    {
+        int worst = -1;
+        double worst_err = 1e-4;
+        int left = 0;
+
+        for (int i = 1; i < n; i++)
+        {
+            if (keep[i])
+            {
+                left = i;
+                continue;
+            }
+
+            int right = i + 1;
+            while (!keep[right]) right++;
+
+            double x = (t[i] - t[left]) / (t[right] - t[left]);
+            double err = fabs(v[left] + x * (v[right] - v[left]) - v[i]);
+
+            if (err > worst_err)
+            {
+                worst = i;
+                worst_err = err;
+            }
+        }
+
+        if (worst < 0) break;
+
+        keep[worst] = 1;
+        kept++;
+    }
+
+    e->count = 0;
+    e->loop = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (!keep[i]) continue;
+
+        e->time[e->count] = t[i];
+        e->value[e->count] = v[i];
+        e->count++;
+    }
+}
+
+int analysis_to_additive(const Analysis *an, AdditiveSynth *a, int max_osc)
+{
+    int n = an->track_count;
+    int longest = 0;
+
+    if (n > max_osc) n = max_osc;
+    if (n > MAX_OSC) n = MAX_OSC;
+
+    Ranked *ranked = malloc(an->track_count * sizeof(Ranked) + 1);
+    if (!ranked) return 0;
+
+    for (int i = 0; i < an->track_count; i++)
+    {
+        const AnalysisTrack *t = &an->track[i];
+
+        ranked[i] = (Ranked){0, i};
+        for (int j = 0; j < t->count; j++)
+            ranked[i].energy += t->peak[j].amp * t->peak[j].amp;
+
+        if (t->count > longest) longest = t->count;
+    }
+
+    qsort(ranked, an->track_count, sizeof(Ranked), by_energy);
+
+    /* with room for a zero at each end */
+    double *time = malloc((longest + 2) * sizeof(double));
+    double *amp = malloc((longest + 2) * sizeof(double));
+    double *freq = malloc(longest * sizeof(double));
+    char *keep = malloc(longest + 2);
+
+    additive_clear(a);
+
+    for (int k = 0; k < n && time && amp && freq && keep; k++)
+    {
+        const AnalysisTrack *t = &an->track[ranked[k].index];
+        double sum = 0, weighted = 0, top = 0;
+
+        for (int j = 0; j < t->count; j++)
+        {
+            sum += t->peak[j].amp;
+            weighted += t->peak[j].amp * t->peak[j].freq;
+            if (t->peak[j].amp > top) top = t->peak[j].amp;
+        }
+
+        int index = additive_add(a);
+        if (index < 0) break;
+
+        Oscillator *o = &a->osc[index];
+
+        /* the mix is divided by the number of oscillators, so this gives back the level */
+        double level = top * n;
+
+        o->type = OSC_SINE;
+        o->freq = weighted / sum;
+        o->amp = level < 1 ? level : 1;
+
+        /* the amplitude fades in from the frame before and out to the frame after */
+        int points = 0;
+
+        if (t->first > 0)
+        {
+            time[points] = (t->first - 1) * (double)HOP / an->sample_rate;
+            amp[points++] = 0;
+        }
+
+        for (int j = 0; j < t->count; j++)
+        {
+            time[points] = (t->first + j) * (double)HOP / an->sample_rate;
+            amp[points++] = t->peak[j].amp / top * level / o->amp;
+        }
+
+        time[points] = (t->first + t->count) * (double)HOP / an->sample_rate;
+        amp[points++] = 0;
+
+        thin_out(time, amp, points, keep, &o->amp_env);
+
+        /* the frequency as a ratio of the mean, only if it moves at all (more than 1/10 of a cent) */
+        double *ftime = time + (t->first > 0);
+        int moves = 0;
+
+        for (int j = 0; j < t->count; j++)
+        {
+            freq[j] = t->peak[j].freq / o->freq;
+            if (fabs(freq[j] - 1) > 6e-5) moves = 1;
+        }
+
+        if (moves)
+            thin_out(ftime, freq, t->count, keep, &o->freq_env);
+    }
+
+    free(ranked);
+    free(time);
+    free(amp);
+    free(freq);
+    free(keep);
+
+    return a->osc_count;
+}
@@ -0,0 +1,114 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "additive.h"
+#include "fft.h"
+#include "pool.h"
+
+/*
+ * Turns a recording into sine partials the additive synth can play.
+ *
+ * The file is cut into frames of ANALYSIS_SIZE samples, ANALYSIS_HOP apart,
+ * each one windowed (Blackman-Harris) and put through an FFT. The peaks of
+ * every spectrum are the sines in that frame: their frequency and amplitude
+ * come from a parabola through the log magnitudes around the peak, which is
+ * a lot finer than a bin. Then the peaks are strung together from frame to
+ * frame into tracks, each peak continuing the track of the last frame that
+ * is closest in frequency, if there's one close enough. What's left is a
+ * list of partials, each with an amplitude and a frequency per frame.
+ *
+ * The file is read as a stream, a batch of ANALYSIS_BATCH frames at a time,
+ * so it never has to fit in memory, and the frames of a batch are analysed
+ * side by side on the threads of a Pool, if there is one. Only the tracking
+ * runs on one thread, it's cheap and every frame depends on the last one.
+ * The pool can be the one the audio thread renders with: a frame per
+ * thread at a time claims it (pool_claim()), waiting out the audio
+ * thread's pieces, and the audio thread waits for those few frames at most
+ * (pool_claim_within()) and then has it again.
+ *
+ * Two sines have to be about four bins (86 Hz) apart to come out as two
+ * peaks, closer ones blur into one that beats.
+ *
+ * Only magnitudes are kept, no phases, so the resynthesis sounds like the
+ * recording but doesn't give back the same waveform, and noise comes out as
+ * a cloud of short partials.
+ *
+ *   Analysis an;
+ *   analysis_run(&an, "voice.wav", &pool);
+ *   analysis_to_additive(&an, &synth, 256);
+ *   additive_publish(&synth);
+ *   analysis_free(&an);
+ */
+
+#define ANALYSIS_BITS 11
+#define ANALYSIS_SIZE (1 << ANALYSIS_BITS)  /* 2048 samples, 21.5 Hz per bin at 44.1 kHz */
+#define ANALYSIS_HOP (ANALYSIS_SIZE / 4)
+#define ANALYSIS_PEAKS 64                   /* the strongest ones per frame */
+#define ANALYSIS_BATCH 128                  /* frames read and analysed at once */
+
+/* peaks quieter than this (-80 dB) are ignored */
+#define ANALYSIS_FLOOR 1e-4
+
+/* a peak continues a track if their frequencies are less than this apart (3%) */
+#define ANALYSIS_DRIFT 0.03
+
+/* shorter tracks are dropped, they're mostly noise */
+#define ANALYSIS_MIN_FRAMES 4
+
+#if ANALYSIS_BITS > FFT_MAX_BITS
+#error "the analysis frame has to fit in the FFT"
+#endif
+
+#if ANALYSIS_BATCH > POOL_MAX_CHUNKS
+#error "a batch is one pool job, a frame per chunk"
+#endif
+
+typedef struct
+{
+    float freq;     /* Hz */
+    float amp;      /* peak amplitude of the sine, 1 = full scale */
+} AnalysisPeak;
+
+/* one partial, frames first .. first + count - 1 */
+typedef struct
+{
+    long first;
+    int count;
+    int capacity;
+    AnalysisPeak *peak;
+} AnalysisTrack;
+
+/* one thread's FFT and window buffers, see analysis.c */
+typedef struct AnalysisWork AnalysisWork;
+
+typedef struct
+{
+    double sample_rate;
+    double seconds;             /* length of the file */
+    long frames;                /* frame f is centred on sample f * ANALYSIS_HOP */
+    double wall_seconds;        /* how long the analysis took */
+
+    AnalysisTrack *track;
+    int track_count;
+    int track_capacity;
+} Analysis;
+
+/*
+ * Reads and analyses a WAV file, on the threads of pool when it isn't NULL.
+ * Returns 0, or -1 when the file can't be read or there's no memory.
+ * Either way, analysis_free() it afterwards.
+ */
+int analysis_run(Analysis *an, const char *path, Pool *pool);
+
+void analysis_free(Analysis *an);
+
+/*
+ * Replaces the oscillators of a with the strongest (by energy) max_osc
+ * tracks, as sines with an amplitude and a frequency envelope each, so that
+ * playing from the start gives back the analysed sound. The envelopes are
+ * thinned out to ENV_POINTS points, where they bend most. Returns how many
+ * oscillators it made. Publishing is up to the caller.
+ */
+int analysis_to_additive(const Analysis *an, AdditiveSynth *a, int max_osc);
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * How many additive oscillators fit in one audio callback.
+ *
+ * One 512-sample callback at 44.1 kHz has to be done in 11.6 ms. Every
+ * method renders 512-sample blocks with 8 up to OSCBANK_MAX oscillators
+ * and prints the time per block and the share of that budget, then how
+ * many oscillators would fill it. That's done twice: for a patch of all
+ * four shapes, one after the other, and for a patch of sine partials only.
+ *
+ *   gen_wave  - the original add_synth.c loop: per sample, per oscillator,
+ *               a switch on the type and sin() / asin() on a double phase
+ *   kernels   - one osc_kernels[] call per oscillator per block
+ *   bank      - the OscBank, OSCBANK_LANES oscillators per instruction
+ *   resonator - the OscBank with the sines made by complex rotation
+ *
+ * Then the sine partials once more, from 1 up, against the IfftBank, whose
+ * cost per partial is much lower but which pays for an FFT every hop, and
+ * where it starts to win.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ifftbank.h"
+#include "nco.h"
+#include "osc.h"
+#include "oscbank.h"
+
+#define SAMPLE_RATE 44100
+#define PI 3.14159265359
+#define BLOCK 512
+#define MIN_TIME 2e8    /* ns, per method and count */
+
+static const int counts[] = {8, 64, 512, OSCBANK_MAX};
+#define COUNTS (int)(sizeof(counts) / sizeof(counts[0]))
+
+static float out[BLOCK];
+static volatile float sink;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double freq_of(int k)
+{
+    return 55.0 + (k * 37) % 4000;
+}
+
+/* ===== the original loop ===== */
+
+typedef struct
+{
+    OscShape type;
+    double freq;
+    double amp;
+    double phase;
+} OldOsc;
+
+static OldOsc old[OSCBANK_MAX];
+
+static double gen_wave(OldOsc *o)
+{
+    double x = o->phase;
+    switch (o->type)
+    {
+        case OSC_SINE: return sin(x);
+        case OSC_SQUARE: return sin(x) >= 0 ? 1 : -1;
+        case OSC_TRIANGLE: return asin(sin(x)) * 2 / PI;
+        case OSC_SAW: return (2.0 * (x / (2 * PI))) - 1.0;
+        default: break;
+    }
+    return 0;
+}
+
+static void run_gen_wave(int n)
+{
+    for (int i = 0; i < BLOCK; i++)
+    {
+        double mix = 0;
+
+        for (int k = 0; k < n; k++)
+        {
+            mix += gen_wave(&old[k]) * old[k].amp;
+
+            old[k].phase += 2 * PI * old[k].freq / SAMPLE_RATE;
+            if (old[k].phase > 2 * PI)
+                old[k].phase -= 2 * PI;
+        }
+
+        out[i] = (float)(mix / n);
+    }
+}
+
+/* ===== one kernel per oscillator ===== */
+
+static Nco ncos[OSCBANK_MAX];
+
+static void run_kernels(int n)
+{
+    memset(out, 0, sizeof(out));
+
+    for (int k = 0; k < n; k++)
+        osc_kernels[old[k].type](&ncos[k], 0.5f, out, BLOCK);
+}
+
+/* ===== the bank ===== */
+
+static OscBank bank;
+
+static void run_bank(int n)
+{
+    (void)n;
+    memset(out, 0, sizeof(out));
+    bank.resonator = 0;
+    oscbank_render(&bank, out, BLOCK);
+}
+
+static void run_resonator(int n)
+{
+    (void)n;
+    memset(out, 0, sizeof(out));
+    bank.resonator = 1;
+    oscbank_render(&bank, out, BLOCK);
+}
+
+/* ===== inverse FFT ===== */
+
+static IfftBank ifft;
+
+static void run_ifft(int n)
+{
+    (void)n;
+    memset(out, 0, sizeof(out));
+    ifftbank_render(&ifft, out, BLOCK);
+}
+
+/* ===== setup ===== */
+
+static int shapes;  /* 1 = sines only, OSC_SHAPES = all of them in turn */
+
+static void setup(int n)
+{
+    int count[OSC_SHAPES] = {0};
+
+    for (int k = 0; k < n; k++)
+    {
+        old[k] = (OldOsc){k % shapes, freq_of(k), 0.5, 0};
+
+        ncos[k].phase = 0;
+        nco_set_freq(&ncos[k], freq_of(k), SAMPLE_RATE);
+
+        count[k % shapes]++;
+    }
+
+    oscbank_layout(&bank, count);
+
+    int next[OSC_SHAPES];
+    memcpy(next, bank.start, sizeof(next));
+
+    for (int k = 0; k < n; k++)
+    {
+        int slot = next[k % shapes]++;
+
+        bank.phase[slot] = 0;
+        bank.inc[slot] = ncos[k].inc;
+        bank.amp[slot] = 0.5f;
+        bank.owner[slot] = k;
+    }
+
+    ifftbank_reset(&ifft);
+    ifft.count = n;
+
+    for (int k = 0; k < n; k++)
+    {
+        ifft.phase[k] = 0;
+        ifft.inc[k] = ncos[k].inc;
+        ifft.amp[k] = 0.5f;
+        ifft.owner[k] = k;
+    }
+}
+
+/* ns per block */
+static double measure(void (*run)(int n), int n)
+{
+    double t0 = now_ns();
+    double t;
+    int blocks = 0;
+
+    do
+    {
+        run(n);
+        sink += out[BLOCK / 2];
+        blocks++;
+        t = now_ns() - t0;
+    }
+    while (t < MIN_TIME || blocks < 3);
+
+    return t / blocks;
+}
+
+int main()
+{
+    static const char *names[] = {"gen_wave", "kernels", "bank", "resonator"};
+    static void (*runs[])(int n) = {run_gen_wave, run_kernels, run_bank, run_resonator};
+
+    double budget = BLOCK * 1e9 / SAMPLE_RATE;
+
+    nco_init();
+    ifftbank_init(&ifft);
+
+    printf("one %d-sample callback = %.2f ms, oscillator bank lanes = %d\n",
+           BLOCK, budget / 1e6, OSCBANK_LANES);
+
+    static const int patches[] = {OSC_SHAPES, 1};
+
+    for (int pt = 0; pt < 2; pt++)
+    {
+        shapes = patches[pt];
+
+        printf("\n%s\n\n", shapes == 1 ? "sine partials" : "all four shapes");
+        printf("%-10s %6s %12s %10s\n", "method", "oscs", "us/block", "budget");
+
+        for (int m = 0; m < 4; m++)
+        {
+            double per_osc = 0;
+
+            for (int c = 0; c < COUNTS; c++)
+            {
+                setup(counts[c]);
+
+                double ns = measure(runs[m], counts[c]);
+                per_osc = ns / counts[c];
+
+                printf("%-10s %6d %12.1f %9.1f%%\n", names[m], counts[c], ns / 1000, ns / budget * 100);
+            }
+
+            printf("%-10s fits about %d oscillators in one callback\n\n", names[m], (int)(budget / per_osc));
+        }
+    }
+
+    printf("sine partials, oscillators against the inverse FFT (%d-sample frames, hop %d)\n\n",
+           IFFTBANK_SIZE, IFFTBANK_HOP);
+    printf("%6s %12s %12s %12s   us/block\n", "oscs", "bank", "resonator", "ifft");
+
+    int crossover = 0;
+    shapes = 1;
+
+    for (int n = 1; n <= OSCBANK_MAX; n *= 2)
+    {
+        setup(n);
+
+        double bank_ns = measure(run_bank, n);
+        double res_ns = measure(run_resonator, n);
+        double ifft_ns = measure(run_ifft, n);
+
+        printf("%6d %12.1f %12.1f %12.1f\n", n, bank_ns / 1000, res_ns / 1000, ifft_ns / 1000);
+
+        if (!crossover && ifft_ns < bank_ns && ifft_ns < res_ns)
+            crossover = n;
+    }
+
+    if (crossover)
+        printf("\nthe inverse FFT is the cheapest from about %d partials on\n", crossover);
+    else
+        printf("\nthe inverse FFT never got cheaper than the oscillators\n");
+
+    return 0;
+}
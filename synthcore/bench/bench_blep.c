@@ -0,0 +1,219 @@
+/*
+ * PolyBLEP quality / speed benchmark.
+ *
+ * Renders every oscillator at a high, "awkward" frequency and reports
+ *   - ns per sample
+ *   - inharmonic energy: everything in the spectrum that is not on the
+ *     intended harmonic series (aliasing, plus detune for the old saw),
+ *     relative to the total, in dB. Lower is better.
+ *
+ * The "legacy" rows are copies of the loops the programs used before.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "blep.h"
+
+#define SAMPLE_RATE 44100
+#define PI 3.14159265359
+#define FFT_N 16384
+#define TEST_FREQ 1318.51
+#define BENCH_SAMPLES (SAMPLE_RATE * 4)
+
+typedef void (*RenderFn)(float *out, int n, double freq);
+
+/* ===== oscillators under test ===== */
+
+/* saw_wave() + audio_callback() from waves.c before the wavetable */
+static void legacy_saw(float *out, int n, double freq)
+{
+    double sample_dt = freq / SAMPLE_RATE;
+    unsigned int sample_N = SAMPLE_RATE / freq;
+    unsigned int i_t = 0;
+
+    for (int k = 0; k < n; k++)
+    {
+        float noise = 0.0;
+        for (int h = 1; h < 40; h++)
+            noise += sin(h * 2 * PI * sample_dt * i_t) / h;
+
+        /* the old saw peaked around 1.85, bring it to the same scale */
+        out[k] = noise * (2 / PI);
+
+        i_t++;
+        if (i_t >= sample_N) i_t = 0;
+    }
+}
+
+/* gen_wave() saw from add_synth.c before PolyBLEP */
+static void naive_saw(float *out, int n, double freq)
+{
+    double t = 0.0, dt = freq / SAMPLE_RATE;
+
+    for (int k = 0; k < n; k++)
+    {
+        out[k] = (float)(2.0 * t - 1.0);
+        t = wrap_phase(t + dt);
+    }
+}
+
+static void naive_square(float *out, int n, double freq)
+{
+    double t = 0.0, dt = freq / SAMPLE_RATE;
+
+    for (int k = 0; k < n; k++)
+    {
+        out[k] = t < 0.5 ? 1.0f : -1.0f;
+        t = wrap_phase(t + dt);
+    }
+}
+
+static void naive_triangle(float *out, int n, double freq)
+{
+    double t = 0.0, dt = freq / SAMPLE_RATE;
+
+    for (int k = 0; k < n; k++)
+    {
+        out[k] = (float)(asin(sin(2 * PI * t)) * 2 / PI);
+        t = wrap_phase(t + dt);
+    }
+}
+
+#define BLEP_RENDER(name, fn)                                   \
+    static void name(float *out, int n, double freq)           \
+    {                                                           \
+        double t = 0.0, dt = freq / SAMPLE_RATE;                \
+        for (int k = 0; k < n; k++)                             \
+        {                                                       \
+            out[k] = fn(t, dt);                                 \
+            t = wrap_phase(t + dt);                             \
+        }                                                       \
+    }
+
+BLEP_RENDER(polyblep_saw, blep_saw)
+BLEP_RENDER(polyblep_square, blep_square)
+BLEP_RENDER(polyblep_triangle, blep_triangle)
+
+/* ===== spectrum ===== */
+
+static void fft(double *re, double *im, int n)
+{
+    for (int i = 1, j = 0; i < n; i++)
+    {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j)
+        {
+            double tr = re[i]; re[i] = re[j]; re[j] = tr;
+            double ti = im[i]; im[i] = im[j]; im[j] = ti;
+        }
+    }
+
+    for (int len = 2; len <= n; len <<= 1)
+    {
+        double a = -2 * PI / len;
+        for (int i = 0; i < n; i += len)
+        {
+            for (int k = 0; k < len / 2; k++)
+            {
+                double wr = cos(a * k), wi = sin(a * k);
+                double *ur = &re[i + k], *ui = &im[i + k];
+                double *vr = &re[i + k + len / 2], *vi = &im[i + k + len / 2];
+                double xr = *vr * wr - *vi * wi;
+                double xi = *vr * wi + *vi * wr;
+                *vr = *ur - xr; *vi = *ui - xi;
+                *ur += xr;      *ui += xi;
+            }
+        }
+    }
+}
+
+/* energy off the harmonic series of freq, relative to total, in dB */
+static double inharmonic_db(const float *x, double freq)
+{
+    static double re[FFT_N], im[FFT_N];
+    const double bin_hz = (double)SAMPLE_RATE / FFT_N;
+    double total = 0.0, off = 0.0;
+
+    for (int i = 0; i < FFT_N; i++)
+    {
+        /* Blackman-Harris, sidelobes are far below anything we measure */
+        double p = 2 * PI * i / FFT_N;
+        double w = 0.35875 - 0.48829 * cos(p) + 0.14128 * cos(2 * p) - 0.01168 * cos(3 * p);
+        re[i] = x[i] * w;
+        im[i] = 0.0;
+    }
+
+    fft(re, im, FFT_N);
+
+    for (int k = 1; k < FFT_N / 2; k++)
+    {
+        double pw = re[k] * re[k] + im[k] * im[k];
+        double h = round(k * bin_hz / freq);
+        int on_series = h >= 1 && fabs(k * bin_hz - h * freq) <= 6 * bin_hz;
+
+        total += pw;
+        if (!on_series) off += pw;
+    }
+
+    return 10 * log10(off / total + 1e-30);
+}
+
+/* ===== timing ===== */
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double ns_per_sample(RenderFn fn, float *buf)
+{
+    double best = 1e30;
+
+    for (int r = 0; r < 5; r++)
+    {
+        double t0 = now_ns();
+        fn(buf, BENCH_SAMPLES, TEST_FREQ);
+        double t1 = now_ns();
+
+        if (t1 - t0 < best) best = t1 - t0;
+    }
+
+    return best / BENCH_SAMPLES;
+}
+
+int main()
+{
+    static float buf[BENCH_SAMPLES];
+
+    struct { const char *name; RenderFn fn; } cases[] = {
+        {"legacy saw_wave (39 sin)", legacy_saw},
+        {"naive saw",                naive_saw},
+        {"polyblep saw",             polyblep_saw},
+        {"naive square",             naive_square},
+        {"polyblep square",          polyblep_square},
+        {"naive triangle",           naive_triangle},
+        {"polyblamp triangle",       polyblep_triangle},
+    };
+    int count = sizeof(cases) / sizeof(cases[0]);
+
+    printf("freq %.2f Hz, %d Hz sample rate\n\n", TEST_FREQ, SAMPLE_RATE);
+    printf("%-26s %12s %16s\n", "oscillator", "ns/sample", "inharmonic dB");
+
+    for (int i = 0; i < count; i++)
+    {
+        double ns = ns_per_sample(cases[i].fn, buf);
+
+        /* skip the start so every oscillator is measured mid-stream */
+        double db = inharmonic_db(buf + SAMPLE_RATE, TEST_FREQ);
+
+        printf("%-26s %12.2f %16.1f\n", cases[i].name, ns, db);
+    }
+
+    return 0;
+}
@@ -0,0 +1,348 @@
+/*
+ * Per-sample vs per-block dispatch.
+ *
+ * The "per-sample" side is the structure the programs had before the block
+ * kernels: a switch (or if chain) on the waveform / filter type inside the
+ * sample loop. It uses the same NCO, PolyBLEP and filter math as the
+ * kernels, so the only difference measured is where the decision is made.
+ *
+ * Every waveform of every program is rendered in 512-sample blocks.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "blep.h"
+#include "filter.h"
+#include "nco.h"
+#include "osc.h"
+#include "wavetable.h"
+
+#define SAMPLE_RATE 44100
+#define PI 3.14159265359
+#define BLOCK 512
+#define BLOCKS 2000
+#define ADD_OSCS 8
+#define SUB_VOICES 4
+#define SUB_FILTERS 2
+
+static const char *shape_names[OSC_SHAPES] = {"sine", "square", "triangle", "saw"};
+
+static float out[BLOCK];
+static volatile float sink;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void consume()
+{
+    sink += out[BLOCK / 2];
+}
+
+/* ===== wave generator ===== */
+
+static double waves_sample(OscShape shape, int biquad)
+{
+    (void)biquad;
+    /* one oscillator per table, the old callback switched between them every sample */
+    WavetableOsc o[OSC_SHAPES];
+    for (int k = 0; k < OSC_SHAPES; k++)
+    {
+        o[k].nco.phase = 0;
+        wt_osc_set(&o[k], k, 440.0, SAMPLE_RATE);
+    }
+
+    double t0 = now_ns();
+
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            float sample = 0;
+
+            switch (shape)
+            {
+                case OSC_SINE:     sample = wt_osc_next(&o[OSC_SINE]); break;
+                case OSC_SQUARE:   sample = wt_osc_next(&o[OSC_SQUARE]); break;
+                case OSC_TRIANGLE: sample = wt_osc_next(&o[OSC_TRIANGLE]); break;
+                case OSC_SAW:      sample = wt_osc_next(&o[OSC_SAW]); break;
+                default: break;
+            }
+
+            out[i] = sample * 0.7f;
+        }
+        consume();
+    }
+
+    return (now_ns() - t0) / ((double)BLOCKS * BLOCK);
+}
+
+static double waves_block(OscShape shape, int biquad)
+{
+    (void)biquad;
+    WavetableOsc o = {0};
+    double t0 = now_ns();
+
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        memset(out, 0, sizeof(out));
+        wt_osc_set(&o, shape, 440.0, SAMPLE_RATE);
+        wt_osc_render(&o, 0.7f, out, BLOCK);
+        consume();
+    }
+
+    return (now_ns() - t0) / ((double)BLOCKS * BLOCK);
+}
+
+/* ===== additive synth ===== */
+
+static float gen_wave(OscShape type, Nco *n)
+{
+    double t = nco_phase(n);
+    double dt = nco_dt(n);
+
+    switch (type)
+    {
+        case OSC_SINE: return nco_sin(n->phase);
+        case OSC_SQUARE: return blep_square(t, dt);
+        case OSC_TRIANGLE: return blep_triangle(t, dt);
+        case OSC_SAW: return blep_saw(t, dt);
+        default: return 0;
+    }
+}
+
+static void init_oscs(Nco *osc)
+{
+    for (int k = 0; k < ADD_OSCS; k++)
+    {
+        osc[k].phase = 0;
+        nco_set_freq(&osc[k], 110.0 * (k + 1) + 3.7 * k, SAMPLE_RATE);
+    }
+}
+
+static double additive_sample(OscShape shape, int biquad)
+{
+    (void)biquad;
+    Nco osc[ADD_OSCS];
+    init_oscs(osc);
+
+    double t0 = now_ns();
+
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            float mix = 0;
+            for (int k = 0; k < ADD_OSCS; k++)
+            {
+                mix += gen_wave(shape, &osc[k]) * 0.5f;
+                nco_advance(&osc[k]);
+            }
+            out[i] = mix / ADD_OSCS;
+        }
+        consume();
+    }
+
+    return (now_ns() - t0) / ((double)BLOCKS * BLOCK);
+}
+
+static double additive_block(OscShape shape, int biquad)
+{
+    (void)biquad;
+    Nco osc[ADD_OSCS];
+    init_oscs(osc);
+
+    double t0 = now_ns();
+
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        memset(out, 0, sizeof(out));
+        for (int k = 0; k < ADD_OSCS; k++)
+            osc_kernels[shape](&osc[k], 0.5f / ADD_OSCS, out, BLOCK);
+        consume();
+    }
+
+    return (now_ns() - t0) / ((double)BLOCKS * BLOCK);
+}
+
+/* ===== subtractive synth (SVF and biquad) ===== */
+
+static float svf_sample(SvfFilter *f, float x)
+{
+    float c = 2 * sinf(PI * f->cutoff / SAMPLE_RATE);
+    float r = f->res;
+
+    f->z1 += c * (x - f->z1 + r * (f->z1 - f->z2));
+    f->z2 += c * (f->z1 - f->z2);
+
+    switch (f->type)
+    {
+        case FILTER_LPF: return f->z2;
+        case FILTER_HPF: return x - f->z2;
+        case FILTER_BPF: return f->z1 - f->z2;
+        case FILTER_NOTCH: return x - (f->z1 - f->z2);
+        default: return x;
+    }
+}
+
+static float biquad_sample(BiquadFilter *f, float x)
+{
+    float y = f->b0 * x + f->b1 * f->x1 + f->b2 * f->x2 - f->a1 * f->y1 - f->a2 * f->y2;
+
+    f->x2 = f->x1;
+    f->x1 = x;
+    f->y2 = f->y1;
+    f->y1 = y;
+
+    return y;
+}
+
+static float gen_voice(OscShape wave, Nco *n)
+{
+    nco_advance(n);
+
+    double t = nco_phase(n);
+    double dt = nco_dt(n);
+
+    if (wave == OSC_SQUARE) return blep_square(t, dt);
+    if (wave == OSC_TRIANGLE) return blep_triangle(t, dt);
+    if (wave == OSC_SAW) return blep_saw(t, dt);
+
+    return 0;
+}
+
+static void init_sub(Nco *voices, SvfFilter *svf, BiquadFilter *bq)
+{
+    for (int v = 0; v < SUB_VOICES; v++)
+    {
+        voices[v].phase = 0;
+        nco_set_freq(&voices[v], 220.0 * pow(2, v / 3.0), SAMPLE_RATE);
+    }
+
+    for (int f = 0; f < SUB_FILTERS; f++)
+    {
+        svf[f] = (SvfFilter){FILTER_LPF, 800, 0.1f, 0, 0};
+        bq[f] = (BiquadFilter){.type = FILTER_LPF, .cutoff = 800, .res = 0.7f};
+        biquad_update(&bq[f], SAMPLE_RATE);
+    }
+}
+
+static double subtractive_sample(OscShape shape, int biquad)
+{
+    Nco voices[SUB_VOICES];
+    SvfFilter svf[SUB_FILTERS];
+    BiquadFilter bq[SUB_FILTERS];
+    init_sub(voices, svf, bq);
+
+    double t0 = now_ns();
+
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            float s = 0.0f;
+
+            for (int v = 0; v < SUB_VOICES; v++)
+                s += gen_voice(shape, &voices[v]);
+
+            s /= 2.5f;
+
+            for (int f = 0; f < SUB_FILTERS; f++)
+                s = biquad ? biquad_sample(&bq[f], s) : svf_sample(&svf[f], s);
+
+            out[i] = s * 0.5f;
+        }
+        consume();
+    }
+
+    return (now_ns() - t0) / ((double)BLOCKS * BLOCK);
+}
+
+static double subtractive_block(OscShape shape, int biquad)
+{
+    Nco voices[SUB_VOICES];
+    SvfFilter svf[SUB_FILTERS];
+    BiquadFilter bq[SUB_FILTERS];
+    init_sub(voices, svf, bq);
+
+    double t0 = now_ns();
+
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        memset(out, 0, sizeof(out));
+
+        OscKernel kernel = osc_kernels[shape];
+        for (int v = 0; v < SUB_VOICES; v++)
+            kernel(&voices[v], 1 / 2.5f, out, BLOCK);
+
+        for (int f = 0; f < SUB_FILTERS; f++)
+        {
+            if (biquad)
+                biquad_process_block(&bq[f], out, BLOCK);
+            else
+                svf_process_block(&svf[f], out, BLOCK, SAMPLE_RATE);
+        }
+
+        for (int i = 0; i < BLOCK; i++)
+            out[i] *= 0.5f;
+
+        consume();
+    }
+
+    return (now_ns() - t0) / ((double)BLOCKS * BLOCK);
+}
+
+/* ===== report ===== */
+
+typedef double (*BenchFn)(OscShape shape, int biquad);
+
+/* best of a few runs, the machine is rarely quiet */
+static double best(BenchFn fn, OscShape shape, int biquad)
+{
+    double b = 1e30;
+
+    for (int r = 0; r < 5; r++)
+    {
+        double ns = fn(shape, biquad);
+        if (ns < b) b = ns;
+    }
+
+    return b;
+}
+
+static void row(const char *program, OscShape shape, int biquad, BenchFn per_sample, BenchFn per_block)
+{
+    double s = best(per_sample, shape, biquad);
+    double b = best(per_block, shape, biquad);
+
+    printf("%-22s %-9s %12.2f %12.2f %8.2fx\n", program, shape_names[shape], s, b, s / b);
+}
+
+int main()
+{
+    nco_init();
+    wt_init(SAMPLE_RATE);
+
+    printf("%d-sample blocks, ns per output sample\n\n", BLOCK);
+    printf("%-22s %-9s %12s %12s %9s\n", "program", "wave", "per-sample", "per-block", "speedup");
+
+    for (int s = 0; s < OSC_SHAPES; s++)
+        row("wave generator", s, 0, waves_sample, waves_block);
+
+    for (int s = 0; s < OSC_SHAPES; s++)
+        row("additive (8 osc)", s, 0, additive_sample, additive_block);
+
+    /* the subtractive synth has no sine */
+    for (int s = OSC_SQUARE; s < OSC_SHAPES; s++)
+        row("subtractive svf", s, 0, subtractive_sample, subtractive_block);
+
+    for (int s = OSC_SQUARE; s < OSC_SHAPES; s++)
+        row("subtractive biquad", s, 1, subtractive_sample, subtractive_block);
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * What the FM synth costs.
+ *
+ * All FM_VOICES voices held down, rendered in 512-sample blocks, for every
+ * algorithm. Prints the time per block, how much of a callback that is,
+ * and the time per operator per sample. Then the same six-operator stack
+ * the plain way for comparison: one voice after the other, one sample after
+ * the other, with sinf(), to show what the vectors and the polynomial buy.
+ *
+ *   ./bench/bench_fm
+ */
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "fm.h"
+
+#define SAMPLE_RATE 44100
+#define BLOCK 512
+#define MIN_TIME 3e8    /* ns, per row */
+#define PI 3.14159265358979323846
+
+static const char *names[FM_ALGORITHMS] = {"stack", "two stacks", "three pairs", "branch", "one to three", "organ"};
+
+static FmSynth fm;
+static float out[BLOCK];
+static volatile float sink;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* ns per block */
+static double measure(void (*render)())
+{
+    double t0 = now_ns();
+    double t;
+    int blocks = 0;
+
+    do
+    {
+        render();
+        sink += out[BLOCK / 2];
+        blocks++;
+        t = now_ns() - t0;
+    }
+    while (t < MIN_TIME || blocks < 3);
+
+    return t / blocks;
+}
+
+static void render_fm()
+{
+    synth_process(&fm.base, out, BLOCK);
+}
+
+/* ===== the plain way ===== */
+
+static double ref_phase[FM_VOICES][FM_OPS];
+static double ref_inc[FM_VOICES][FM_OPS];
+static float ref_fb[FM_VOICES][2];
+
+/* 6 > 5 > 4 > 3 > 2 > 1, feedback on 6, fixed levels */
+static void render_reference()
+{
+    for (int i = 0; i < BLOCK; i++)
+        out[i] = 0;
+
+    for (int v = 0; v < FM_VOICES; v++)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            float mod = (ref_fb[v][0] + ref_fb[v][1]) * 0.5f * fm.feedback * 0.5f / FM_DEPTH;
+
+            for (int op = FM_OPS - 1; op >= 0; op--)
+            {
+                float y = sinf((float)(2 * PI * ref_phase[v][op]) + 2 * (float)PI * FM_DEPTH * mod) * fm.op[op].level;
+
+                if (op == FM_OPS - 1)
+                {
+                    ref_fb[v][1] = ref_fb[v][0];
+                    ref_fb[v][0] = y;
+                }
+
+                ref_phase[v][op] += ref_inc[v][op];
+                if (ref_phase[v][op] >= 1) ref_phase[v][op] -= 1;
+                mod = y;
+            }
+
+            out[i] += mod;
+        }
+    }
+}
+
+int main()
+{
+    double budget = BLOCK * 1e9 / SAMPLE_RATE;
+    double per_op = BLOCK * FM_VOICES * FM_OPS;
+
+    printf("%d voices x %d operators, one %d-sample callback = %.2f ms\n\n",
+           FM_VOICES, FM_OPS, BLOCK, budget / 1e6);
+    printf("%-14s %12s %10s %14s\n", "algorithm", "us/block", "budget", "ns/op/sample");
+
+    double stack = 0;
+
+    for (int alg = 0; alg < FM_ALGORITHMS; alg++)
+    {
+        fm_init(&fm, SAMPLE_RATE);
+        fm.algorithm = alg;
+
+        /* held notes, and sustains that never let the levels fall to 0 */
+        for (int op = 0; op < FM_OPS; op++)
+            fm.op[op].sustain = 0.5f;
+        for (int v = 0; v < FM_VOICES; v++)
+            fm_note_on(&fm, v, 110.0f * (v + 1));
+
+        double ns = measure(render_fm);
+        if (alg == FM_STACK) stack = ns;
+
+        printf("%-14s %12.1f %9.1f%% %14.3f\n", names[alg], ns / 1000, ns / budget * 100, ns / per_op);
+    }
+
+    for (int v = 0; v < FM_VOICES; v++)
+        for (int op = 0; op < FM_OPS; op++)
+            ref_inc[v][op] = 110.0 * (v + 1) * fm.op[op].ratio / SAMPLE_RATE;
+
+    double ns = measure(render_reference);
+
+    printf("%-14s %12.1f %9.1f%% %14.3f   (stack with sinf(), %.1fx slower)\n",
+           "plain", ns / 1000, ns / budget * 100, ns / per_op, ns / stack);
+
+    return 0;
+}
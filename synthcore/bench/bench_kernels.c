@@ -0,0 +1,560 @@
+/*
+ * Microbenchmarks for every DSP kernel in synthcore, at several block
+ * sizes, voice counts and filter-chain lengths.
+ *
+ *   ./bench/bench_kernels [-json] [-o FILE] [-c BASELINE.csv] [-t PERCENT]
+ *
+ * Prints one line per case as CSV (or JSON with -json):
+ *
+ *   id,ns_per_sample,samples_per_sec
+ *
+ * Save the CSV of a known good build with -o, then run again later with
+ * -c to see the change of every case. Cases that got slower than the
+ * threshold (default 10%) are marked and the program exits with 1.
+ *
+ * The old names from the programs map like this:
+ *   sine_wave / saw_wave   -> osc/<shape>, wavetable/<shape>
+ *   gen_wave               -> wavegen, additive
+ *   generate_sample        -> drum/<preset>, drum_cache/<preset> (a hit)
+ *   gen_voice              -> subtractive
+ *   (new)                  -> fm/<algorithm>
+ *   process_filter         -> svf/<type>, biquad
+ *   update_filter          -> biquad_update (one "sample" is one call)
+ *   (new)                  -> additive_publish (one "sample" is one oscillator published)
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "additive.h"
+#include "drum.h"
+#include "drumcache.h"
+#include "fm.h"
+#include "filter.h"
+#include "osc.h"
+#include "subtractive.h"
+#include "wavegen.h"
+#include "wavetable.h"
+
+#define SAMPLE_RATE 44100
+#define MAX_BLOCK 4096
+#define RUNS 5
+#define MAX_CASES 256
+
+/* samples rendered per run, whatever the block size */
+#define RUN_SAMPLES (1 << 18)
+
+static const char *shape_names[OSC_SHAPES] = {"sine", "square", "triangle", "saw"};
+static const char *filter_names[FILTER_TYPES] = {"lpf", "hpf", "bpf", "notch"};
+
+static const int block_sizes[] = {64, 512, 2048};
+#define BLOCK_SIZES (int)(sizeof(block_sizes) / sizeof(block_sizes[0]))
+
+static float buf[MAX_BLOCK];
+static float noise[MAX_BLOCK];
+static volatile float sink;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* ===== results ===== */
+
+typedef struct
+{
+    char id[64];
+    double ns;
+} Result;
+
+static Result results[MAX_CASES];
+static int result_count;
+
+/* renders one block of frames samples into buf */
+typedef void (*BenchRun)(void *ctx, int frames);
+
+/* best of RUNS runs, the machine is rarely quiet */
+static void measure(const char *id, BenchRun run, void *ctx, int block)
+{
+    double best = 1e30;
+    int blocks = RUN_SAMPLES / block;
+    if (blocks < 1) blocks = 1;
+
+    for (int r = 0; r < RUNS; r++)
+    {
+        double t0 = now_ns();
+
+        for (int b = 0; b < blocks; b++)
+        {
+            run(ctx, block);
+            sink += buf[block / 2];
+        }
+
+        double ns = (now_ns() - t0) / ((double)blocks * block);
+        if (ns < best) best = ns;
+    }
+
+    if (result_count < MAX_CASES)
+    {
+        Result *res = &results[result_count++];
+        snprintf(res->id, sizeof(res->id), "%s", id);
+        res->ns = best;
+    }
+
+    fprintf(stderr, "  %-32s %9.2f ns/sample\n", id, best);
+}
+
+/* ===== oscillators ===== */
+
+typedef struct
+{
+    OscShape shape;
+    Nco nco;
+    WavetableOsc wt;
+} OscCtx;
+
+static void run_osc(void *ctx, int frames)
+{
+    OscCtx *c = ctx;
+    memset(buf, 0, frames * sizeof(float));
+    osc_kernels[c->shape](&c->nco, 0.5f, buf, frames);
+}
+
+static void run_wavetable(void *ctx, int frames)
+{
+    OscCtx *c = ctx;
+    memset(buf, 0, frames * sizeof(float));
+    wt_osc_set(&c->wt, c->shape, 440.0, SAMPLE_RATE);
+    wt_osc_render(&c->wt, 0.5f, buf, frames);
+}
+
+static void bench_oscillators()
+{
+    char id[64];
+
+    for (int s = 0; s < OSC_SHAPES; s++)
+    {
+        for (int b = 0; b < BLOCK_SIZES; b++)
+        {
+            OscCtx c = {.shape = s};
+            nco_set_freq(&c.nco, 440.0, SAMPLE_RATE);
+
+            snprintf(id, sizeof(id), "osc/%s/b%d", shape_names[s], block_sizes[b]);
+            measure(id, run_osc, &c, block_sizes[b]);
+
+            snprintf(id, sizeof(id), "wavetable/%s/b%d", shape_names[s], block_sizes[b]);
+            measure(id, run_wavetable, &c, block_sizes[b]);
+        }
+    }
+}
+
+/* ===== engines ===== */
+
+static void run_synth(void *ctx, int frames)
+{
+    synth_process(ctx, buf, frames);
+}
+
+static WaveGen wavegen;
+static AdditiveSynth additive;
+static SubtractiveSynth sub;
+static float drum_buf[MAX_SAMPLES];
+static DrumCache drum_cache;
+static FmSynth fm;
+
+static void bench_wavegen()
+{
+    char id[64];
+
+    for (int s = 0; s < OSC_SHAPES; s++)
+    {
+        for (int b = 0; b < BLOCK_SIZES; b++)
+        {
+            wavegen_init(&wavegen, SAMPLE_RATE);
+            wavegen.wave = s;
+            wavegen.frequency = 440.0;
+
+            snprintf(id, sizeof(id), "wavegen/%s/b%d", shape_names[s], block_sizes[b]);
+            measure(id, run_synth, &wavegen, block_sizes[b]);
+        }
+    }
+}
+
+static void bench_additive()
+{
+    static const int counts[] = {1, 4, 8, 512};
+    static const char *engines[ADDITIVE_ENGINES] = {"additive", "additive_res", "additive_ifft"};
+    char id[64];
+
+    for (int e = 0; e < ADDITIVE_ENGINES; e++)
+    {
+        for (int n = 0; n < 4; n++)
+        {
+            for (int b = 0; b < BLOCK_SIZES; b++)
+            {
+                additive_init(&additive, SAMPLE_RATE);
+                additive.engine = e;
+
+                for (int k = 0; k < counts[n]; k++)
+                {
+                    int i = additive_add(&additive);
+                    additive.osc[i].type = k % OSC_SHAPES;
+                    additive.osc[i].freq = 110.0 * (k % 64 + 1);
+                }
+                additive_publish(&additive);
+                additive.playing = 1;
+
+                snprintf(id, sizeof(id), "%s/o%d/b%d", engines[e], counts[n], block_sizes[b]);
+                measure(id, run_synth, &additive, block_sizes[b]);
+                additive_free(&additive);
+            }
+        }
+    }
+}
+
+/* frames / osc_count whole snapshots, so a "sample" is one oscillator */
+static void run_publish(void *ctx, int frames)
+{
+    AdditiveSynth *a = ctx;
+
+    for (int i = 0; i < frames; i += a->osc_count)
+        additive_publish(a);
+}
+
+/* the UI thread's side: a full snapshot of MAX_OSC oscillators, with and without envelopes */
+static void bench_publish()
+{
+    static const Envelope pluck = {4, 1, {0, 0.01, 0.8, 1.0}, {0, 1, 0, 0}};
+    static const Envelope vibrato = {5, 1, {0, 0.05, 0.1, 0.15, 0.2}, {1, 1.01, 1, 0.99, 1}};
+
+    for (int env = 0; env < 2; env++)
+    {
+        additive_init(&additive, SAMPLE_RATE);
+
+        for (int k = 0; k < MAX_OSC; k++)
+        {
+            int i = additive_add(&additive);
+            additive.osc[i].freq = 55.0 * (k % 256 + 1);
+            additive.osc[i].amp = 0.5;
+
+            if (env)
+            {
+                additive.osc[i].amp_env = pluck;
+                additive.osc[i].freq_env = vibrato;
+            }
+        }
+
+        measure(env ? "additive_publish/o4096/env" : "additive_publish/o4096", run_publish, &additive, MAX_OSC);
+        additive_free(&additive);
+    }
+}
+
+static void run_drum(void *ctx, int frames)
+{
+    (void)frames;
+    generate_sample(drum_buf, ctx, SAMPLE_RATE);
+    buf[0] = drum_buf[0];
+}
+
+static void run_drum_cache(void *ctx, int frames)
+{
+    (void)frames;
+    drum_cache_render(&drum_cache, drum_buf, ctx, SAMPLE_RATE);
+    buf[0] = drum_buf[0];
+}
+
+static void bench_drum()
+{
+    static const char *names[] = {"kick", "snare", "tom", "hihat"};
+    static void (*presets[])(DrumParams *p) = {play_kick, play_snare, play_tom, play_hihat};
+    char id[64];
+
+    for (int k = 0; k < 4; k++)
+    {
+        DrumParams p = {.seed = 1};
+        presets[k](&p);
+
+        /* one "block" is the whole sample */
+        snprintf(id, sizeof(id), "drum/%s", names[k]);
+        measure(id, run_drum, &p, p.length);
+    }
+
+    /* the same sounds again, found in the cache */
+    drum_cache_init(&drum_cache, 16);
+
+    for (int k = 0; k < 4; k++)
+    {
+        DrumParams p = {.seed = 1};
+        presets[k](&p);
+
+        snprintf(id, sizeof(id), "drum_cache/%s", names[k]);
+        measure(id, run_drum_cache, &p, p.length);
+    }
+
+    drum_cache_free(&drum_cache);
+}
+
+static void bench_subtractive()
+{
+    static const int voices[] = {1, 4, MAX_VOICES};
+    static const int filters[] = {0, 1, MAX_FILTERS};
+    char id[64];
+
+    for (int m = 0; m < 2; m++)
+    {
+        for (int v = 0; v < 3; v++)
+        {
+            for (int f = 0; f < 3; f++)
+            {
+                subtractive_init(&sub, m ? FILTER_MODEL_BIQUAD : FILTER_MODEL_SVF, SAMPLE_RATE);
+
+                for (int k = 0; k < voices[v]; k++)
+                    subtractive_note_on(&sub, k, 220.0f * powf(2, k / 12.0f));
+
+                for (int k = 0; k < filters[f]; k++)
+                    subtractive_add_filter(&sub);
+
+                snprintf(id, sizeof(id), "subtractive/%s/v%d/f%d/b512",
+                         m ? "biquad" : "svf", voices[v], filters[f]);
+                measure(id, run_synth, &sub, 512);
+            }
+        }
+    }
+}
+
+/* every voice held, costs the same however many are */
+static void bench_fm()
+{
+    static const char *algorithms[FM_ALGORITHMS] = {"stack", "two_stacks", "three_pairs", "branch", "one_to_three", "organ"};
+    char id[64];
+
+    for (int a = 0; a < FM_ALGORITHMS; a++)
+    {
+        fm_init(&fm, SAMPLE_RATE);
+        fm.algorithm = a;
+
+        for (int v = 0; v < FM_VOICES; v++)
+            fm_note_on(&fm, v, 110.0f * (v + 1));
+
+        snprintf(id, sizeof(id), "fm/%s/b512", algorithms[a]);
+        measure(id, run_synth, &fm, 512);
+    }
+}
+
+/* ===== filters ===== */
+
+typedef struct
+{
+    int count;
+    SvfFilter svf[MAX_FILTERS];
+    BiquadFilter bq[MAX_FILTERS];
+} FilterCtx;
+
+/* fresh noise every block, filtering the same buffer over and over ends in denormals */
+static void run_svf(void *ctx, int frames)
+{
+    FilterCtx *c = ctx;
+    memcpy(buf, noise, frames * sizeof(float));
+
+    for (int f = 0; f < c->count; f++)
+        svf_process_block(&c->svf[f], buf, frames, SAMPLE_RATE);
+}
+
+static void run_biquad(void *ctx, int frames)
+{
+    FilterCtx *c = ctx;
+    memcpy(buf, noise, frames * sizeof(float));
+
+    for (int f = 0; f < c->count; f++)
+        biquad_process_block(&c->bq[f], buf, frames);
+}
+
+static void run_biquad_update(void *ctx, int frames)
+{
+    BiquadFilter *f = ctx;
+
+    for (int i = 0; i < frames; i++)
+    {
+        f->cutoff = 200.0f + (i & 1023) * 10.0f;
+        biquad_update(f, SAMPLE_RATE);
+    }
+    buf[frames / 2] = f->b0;
+}
+
+static void bench_filters()
+{
+    static const int chains[] = {1, 2, MAX_FILTERS};
+    char id[64];
+
+    for (int i = 0; i < MAX_BLOCK; i++)
+        noise[i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+
+    for (int t = 0; t < FILTER_TYPES; t++)
+    {
+        for (int n = 0; n < 3; n++)
+        {
+            for (int b = 0; b < BLOCK_SIZES; b++)
+            {
+                FilterCtx c = {.count = chains[n]};
+
+                for (int f = 0; f < chains[n]; f++)
+                {
+                    c.svf[f] = (SvfFilter){t, 800, 0.1f, 0, 0};
+                    c.bq[f] = (BiquadFilter){.type = t, .cutoff = 800, .res = 0.7f};
+                    biquad_update(&c.bq[f], SAMPLE_RATE);
+                }
+
+                snprintf(id, sizeof(id), "svf/%s/f%d/b%d", filter_names[t], chains[n], block_sizes[b]);
+                measure(id, run_svf, &c, block_sizes[b]);
+
+                snprintf(id, sizeof(id), "biquad/%s/f%d/b%d", filter_names[t], chains[n], block_sizes[b]);
+                measure(id, run_biquad, &c, block_sizes[b]);
+            }
+        }
+    }
+
+    for (int t = 0; t < FILTER_TYPES; t++)
+    {
+        BiquadFilter f = {.type = t, .cutoff = 800, .res = 0.7f};
+
+        snprintf(id, sizeof(id), "biquad_update/%s", filter_names[t]);
+        measure(id, run_biquad_update, &f, 1024);
+    }
+}
+
+/* ===== output ===== */
+
+static void write_csv(FILE *f)
+{
+    fprintf(f, "id,ns_per_sample,samples_per_sec\n");
+
+    for (int i = 0; i < result_count; i++)
+        fprintf(f, "%s,%.3f,%.0f\n", results[i].id, results[i].ns, 1e9 / results[i].ns);
+}
+
+static void write_json(FILE *f)
+{
+    fprintf(f, "[\n");
+
+    for (int i = 0; i < result_count; i++)
+    {
+        fprintf(f, "  {\"id\": \"%s\", \"ns_per_sample\": %.3f, \"samples_per_sec\": %.0f}%s\n",
+                results[i].id, results[i].ns, 1e9 / results[i].ns,
+                i + 1 < result_count ? "," : "");
+    }
+
+    fprintf(f, "]\n");
+}
+
+/* prints the change of every case found in the baseline CSV, returns how many got slower */
+static int compare(const char *path, double threshold)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+
+    char line[256];
+    int slower = 0;
+
+    printf("\n%-32s %12s %12s %9s\n", "id", "baseline", "now", "change");
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char id[64];
+        double ns;
+
+        if (sscanf(line, "%63[^,],%lf", id, &ns) != 2)
+            continue;   /* header */
+
+        for (int i = 0; i < result_count; i++)
+        {
+            if (strcmp(results[i].id, id) != 0)
+                continue;
+
+            double change = (results[i].ns - ns) / ns * 100.0;
+            int bad = change > threshold;
+
+            printf("%-32s %12.2f %12.2f %+8.1f%%%s\n",
+                   id, ns, results[i].ns, change, bad ? "  SLOWER" : "");
+
+            slower += bad;
+            break;
+        }
+    }
+
+    fclose(f);
+    return slower;
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    const char *baseline = NULL;
+    double threshold = 10.0;
+    int json = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-json") == 0) json = 1;
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) baseline = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) threshold = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: bench_kernels [-json] [-o FILE] [-c BASELINE.csv] [-t PERCENT]\n");
+            return 2;
+        }
+    }
+
+    nco_init();
+    wt_init(SAMPLE_RATE);
+    srand(1);
+
+    bench_oscillators();
+    bench_wavegen();
+    bench_additive();
+    bench_publish();
+    bench_drum();
+    bench_subtractive();
+    bench_fm();
+    bench_filters();
+
+    FILE *out = stdout;
+    if (out_path)
+    {
+        out = fopen(out_path, "w");
+        if (!out)
+        {
+            perror(out_path);
+            return 1;
+        }
+    }
+
+    if (json)
+        write_json(out);
+    else
+        write_csv(out);
+
+    if (out != stdout)
+        fclose(out);
+
+    if (baseline)
+    {
+        int slower = compare(baseline, threshold);
+        if (slower != 0)
+        {
+            if (slower > 0)
+                printf("\n%d case(s) more than %.0f%% slower than %s\n", slower, threshold, baseline);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * What the drum sampler costs.
+ *
+ * A hi-hat on one pad, hit faster and faster, in 512-sample blocks: from a
+ * hit per block up to one every 16 samples, which keeps every voice busy
+ * and steals one for each new hit. Prints the time per block, how much of
+ * a callback that is, how many voices were playing, and the time per
+ * playing voice per sample.
+ *
+ *   ./bench/bench_sampler
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "drum.h"
+#include "drumsampler.h"
+
+#define SAMPLE_RATE 44100
+#define BLOCK 512
+#define MIN_TIME 3e8    /* ns, per row */
+
+static DrumSampler sampler;
+static float hat[MAX_SAMPLES];
+static float out[BLOCK];
+static volatile float sink;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* hits per block, the queue only has room for so many */
+static void measure(int every)
+{
+    int hits = BLOCK / every;
+    if (hits < 1) hits = 1;
+
+    drum_sampler_init(&sampler, SAMPLE_RATE);
+    drum_sampler_load(&sampler, 0, hat, 15000);
+
+    /* until the voices are as busy as they get */
+    for (int b = 0; b < 64; b++)
+    {
+        for (int h = 0; h < hits; h++)
+            drum_sampler_hit(&sampler, 0, 0.8f);
+        synth_process(&sampler.base, out, BLOCK);
+    }
+
+    double t0 = now_ns();
+    double t;
+    long blocks = 0;
+    long voices = 0;
+
+    do
+    {
+        for (int h = 0; h < hits; h++)
+            drum_sampler_hit(&sampler, 0, 0.8f);
+
+        synth_process(&sampler.base, out, BLOCK);
+        sink += out[BLOCK / 2];
+
+        voices += atomic_load(&sampler.playing);
+        blocks++;
+        t = now_ns() - t0;
+    }
+    while (t < MIN_TIME || blocks < 3);
+
+    double ns = t / blocks;
+    double budget = BLOCK * 1e9 / SAMPLE_RATE;
+    double playing = (double)voices / blocks;
+
+    printf("%6d %10.0f %12.2f %9.2f%% %8.1f %12.3f\n",
+           every, hits * (double)SAMPLE_RATE / BLOCK, ns / 1000, ns / budget * 100,
+           playing, ns / (playing * BLOCK));
+
+    drum_sampler_free(&sampler);
+}
+
+int main()
+{
+    DrumParams p = {.seed = 1};
+    play_hihat(&p);
+    generate_sample(hat, &p, SAMPLE_RATE);
+
+    printf("hi-hat (%d samples), %d voices, one %d-sample callback = %.2f ms\n\n",
+           p.length, DRUM_SAMPLER_VOICES, BLOCK, BLOCK * 1e3 / SAMPLE_RATE);
+    printf("%6s %10s %12s %10s %8s %12s\n", "every", "hits/s", "us/block", "budget", "voices", "ns/voice/smp");
+
+    static const int every[] = {512, 256, 128, 64, 32, 16};
+
+    for (int k = 0; k < (int)(sizeof(every) / sizeof(every[0])); k++)
+        measure(every[k]);
+
+    return 0;
+}
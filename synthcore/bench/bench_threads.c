@@ -0,0 +1,123 @@
+/*
+ * How the additive synth scales with threads.
+ *
+ * 4096 sine partials (and then 4096 of every shape) rendered in 512-sample
+ * blocks by the AdditiveSynth, first on one thread, then on a Pool with 1,
+ * 2 ... more workers. Prints the time per block, the slowest block, the
+ * speedup over one thread, and how many chunks the audio thread had to take
+ * over from a late worker. Rows with more threads than cores are marked, they can only
+ * get slower.
+ *
+ *   ./bench/bench_threads [MAX_THREADS]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "additive.h"
+#include "pool.h"
+
+#define SAMPLE_RATE 44100
+#define BLOCK 512
+#define MIN_TIME 5e8    /* ns, per row */
+
+static AdditiveSynth additive;
+static Pool pool;
+static float out[BLOCK];
+static volatile float sink;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void setup(int shapes)
+{
+    additive_init(&additive, SAMPLE_RATE);
+
+    for (int k = 0; k < MAX_OSC; k++)
+    {
+        int i = additive_add(&additive);
+        additive.osc[i].type = k % shapes;
+        additive.osc[i].freq = 55.0 + (k * 37) % 4000;
+    }
+
+    additive_publish(&additive);
+    additive.playing = 1;
+}
+
+/* ns per block, and of the slowest one */
+static double measure(double *worst)
+{
+    double t0 = now_ns();
+    double t = 0;
+    int blocks = 0;
+
+    *worst = 0;
+
+    do
+    {
+        double b0 = t;
+
+        synth_process(&additive.base, out, BLOCK);
+        sink += out[BLOCK / 2];
+        blocks++;
+        t = now_ns() - t0;
+
+        if (t - b0 > *worst) *worst = t - b0;
+    }
+    while (t < MIN_TIME || blocks < 3);
+
+    return t / blocks;
+}
+
+int main(int argc, char **argv)
+{
+    int cores = pool_cores();
+    int max_threads = argc > 1 ? atoi(argv[1]) : (cores > 4 ? cores : 4);
+    double budget = BLOCK * 1e9 / SAMPLE_RATE;
+
+    if (max_threads > POOL_MAX_THREADS + 1) max_threads = POOL_MAX_THREADS + 1;
+
+    printf("%d cores, one %d-sample callback = %.2f ms, %d oscillators\n",
+           cores, BLOCK, budget / 1e6, MAX_OSC);
+
+    static const int patches[] = {1, OSC_SHAPES};
+
+    for (int pt = 0; pt < 2; pt++)
+    {
+        printf("\n%s\n\n", patches[pt] == 1 ? "sine partials" : "all four shapes");
+        printf("%8s %12s %10s %12s %9s %12s\n", "threads", "us/block", "budget", "worst us", "speedup", "taken over");
+
+        double single = 0;
+
+        for (int t = 1; t <= max_threads; t++)
+        {
+            setup(patches[pt]);
+
+            if (t > 1)
+            {
+                pool_init(&pool, t - 1);
+                additive_set_pool(&additive, &pool);
+            }
+
+            /* one block first, so the workers are awake */
+            synth_process(&additive.base, out, BLOCK);
+
+            double worst;
+            double ns = measure(&worst);
+            if (t == 1) single = ns;
+
+            printf("%8d %12.1f %9.1f%% %12.1f %8.2fx %12ld%s\n", t, ns / 1000, ns / budget * 100, worst / 1000, single / ns,
+                   pool.taken_over, t > cores ? "   (more threads than cores)" : "");
+
+            additive_free(&additive);
+            pool_free(&pool);
+            pool.taken_over = 0;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#ifndef BLEP_H
+#define BLEP_H
+
+#include <math.h>
+
+/*
+ * PolyBLEP / PolyBLAMP band-limited oscillators.
+ *
+ * A naive saw or square jumps in a single sample, which puts energy above
+ * Nyquist that folds back as aliasing. PolyBLEP smooths every jump with a
+ * small polynomial over the two samples around it. The triangle has no jumps,
+ * only corners (jumps in slope), so it gets the integrated version, PolyBLAMP.
+ *
+ * All functions take
+ *   t  - phase in cycles, 0..1
+ *   dt - phase increment per sample (freq / sample rate), below 0.5
+ * and do a few multiply-adds, no tables and no state.
+ */
+
+/* correction for a step of height 1 at t = 0 */
+static inline double blep(double t, double dt)
+{
+    if (t < dt)
+    {
+        double x = t / dt - 1.0;
+        return -0.5 * x * x;
+    }
+    if (t > 1.0 - dt)
+    {
+        double x = (t - 1.0) / dt + 1.0;
+        return 0.5 * x * x;
+    }
+    return 0.0;
+}
+
+/* correction for a slope change of 1 per sample at t = 0 */
+static inline double blamp(double t, double dt)
+{
+    if (t < dt)
+    {
+        double x = 1.0 - t / dt;
+        return x * x * x / 6.0;
+    }
+    if (t > 1.0 - dt)
+    {
+        double x = (t - 1.0) / dt + 1.0;
+        return x * x * x / 6.0;
+    }
+    return 0.0;
+}
+
+static inline double wrap_phase(double t)
+{
+    return t >= 1.0 ? t - 1.0 : t;
+}
+
+/* rising saw, -1..1, drops at t = 0 */
+static inline float blep_saw(double t, double dt)
+{
+    return (float)(2.0 * t - 1.0 - 2.0 * blep(t, dt));
+}
+
+/* +1 for the first half of the cycle, -1 for the second */
+static inline float blep_square(double t, double dt)
+{
+    double y = t < 0.5 ? 1.0 : -1.0;
+
+    y += 2.0 * blep(t, dt);
+    y -= 2.0 * blep(wrap_phase(t + 0.5), dt);
+
+    return (float)y;
+}
+
+/* same phase as sin(2 PI t): 0 at t = 0, peak at 0.25, trough at 0.75 */
+static inline float blep_triangle(double t, double dt)
+{
+    double u = wrap_phase(t + 0.25);
+    double y = 1.0 - 4.0 * fabs(u - 0.5);
+
+    /* slope goes -4 -> +4 per cycle at the trough and back at the peak */
+    y += 8.0 * dt * blamp(u, dt);
+    y -= 8.0 * dt * blamp(wrap_phase(u + 0.5), dt);
+
+    return (float)y;
+}
+
+#endif
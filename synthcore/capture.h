@@ -0,0 +1,90 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdatomic.h>
+
+/*
+ * The last CAPTURE_SIZE samples the audio thread played, for the scope.
+ *
+ * The audio thread writes every block into a ring and then moves the
+ * `written` counter on with a release store, so a reader that sees the new
+ * count also sees the samples before it. The UI thread copies the newest
+ * ones out whenever it draws. Neither side waits for the other: the audio
+ * thread simply keeps writing, and if it laps the reader during the copy,
+ * the reader notices and drops the samples that were overwritten (the
+ * oldest ones of the copy).
+ *
+ * It notices from `writing`, not `written`: a block still being written has
+ * overwritten samples already, and `written` only counts them once the whole
+ * block is in. `writing` says where that block will end, and it's stored
+ * before the block, behind a release fence, so a reader that has copied any
+ * sample of the block sees it after its acquire fence (a seqlock, with the
+ * count as the sequence).
+ *
+ * The samples are relaxed atomics, so the two threads can touch the same
+ * one at once without a data race; on every CPU we run on that's a plain
+ * load or store.
+ */
+
+#define CAPTURE_SIZE 4096   /* power of two */
+
+typedef struct
+{
+    _Atomic float buf[CAPTURE_SIZE];
+    atomic_uint written;    /* samples written so far, by the audio thread */
+    atomic_uint writing;    /* written, once the block in flight is in */
+} CaptureRing;
+
+static inline void capture_init(CaptureRing *c)
+{
+    for (int i = 0; i < CAPTURE_SIZE; i++)
+        atomic_init(&c->buf[i], 0.0f);
+    atomic_init(&c->written, 0);
+    atomic_init(&c->writing, 0);
+}
+
+/* audio thread, after every block */
+static inline void capture_write(CaptureRing *c, const float *in, int n)
+{
+    unsigned w = atomic_load_explicit(&c->written, memory_order_relaxed);
+
+    /* a reader that gets any of the new samples also sees where they end */
+    atomic_store_explicit(&c->writing, w + n, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (int i = 0; i < n; i++)
+        atomic_store_explicit(&c->buf[(w + i) & (CAPTURE_SIZE - 1)], in[i], memory_order_relaxed);
+
+    /* the samples are written before the reader can see the new count */
+    atomic_store_explicit(&c->written, w + n, memory_order_release);
+}
+
+/*
+ * UI thread: copies the newest n samples (at most CAPTURE_SIZE), oldest
+ * first, to out. Returns how many of them are good, from out[0] on; fewer
+ * than n only when the audio thread overwrote some during the copy.
+ */
+static inline int capture_read(CaptureRing *c, float *out, int n)
+{
+    if (n > CAPTURE_SIZE) n = CAPTURE_SIZE;
+
+    unsigned end = atomic_load_explicit(&c->written, memory_order_acquire);
+
+    for (int i = 0; i < n; i++)
+        out[i] = atomic_load_explicit(&c->buf[(end - n + i) & (CAPTURE_SIZE - 1)], memory_order_relaxed);
+
+    /* the copy is done before we look how far the writer got meanwhile, the block in flight too */
+    atomic_thread_fence(memory_order_acquire);
+    unsigned now = atomic_load_explicit(&c->writing, memory_order_relaxed);
+
+    int lapped = (int)(now - end) - (CAPTURE_SIZE - n);
+    if (lapped <= 0) return n;
+    if (lapped >= n) return 0;
+
+    for (int i = 0; i < n - lapped; i++)
+        out[i] = out[i + lapped];
+
+    return n - lapped;
+}
+
+#endif
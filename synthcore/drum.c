@@ -0,0 +1,481 @@
+#include "drum.h"
+#include "drumcache.h"
+#include "nco.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* ===== sample generation ===== */
+
+/*
+ * One loop for every combination of the optional stages. Each kernel below
+ * calls it with constant flags, so the compiler drops the stages that are
+ * off and no per-sample "if (p->use_...)" is left in the loop.
+ *
+ * It carries on where the last call for the voice stopped: everything that
+ * changes from sample to sample is in the voice, so n samples at once and
+ * the same n in pieces come out the same, bit for bit.
+ */
+static inline __attribute__((always_inline))
+void render_stages(DrumVoice *v, float *buffer, int n,
+                   int use_env, int use_fm, int use_osc2, int use_noise)
+{
+    /* a copy, so nothing of it has to be reloaded after every store to buffer */
+    const DrumParams params = v->params;
+    const DrumParams *p = &params;
+    double sample_rate = v->sample_rate;
+
+    Nco nco1 = v->nco1;
+    Nco nco2 = v->nco2;
+    uint32_t noise_state = v->noise_state;
+    int start = v->pos;
+
+    for (int k = 0; k < n; k++)
+    {
+        int i = start + k;
+        float t = (float)i / sample_rate;
+
+        /* ===== amplitude envelope ===== */
+        float env = 1.0f;
+        if (use_env)
+            env = expf(-p->env_k * t);
+
+        /* ===== main oscillator ===== */
+        float osc1 = nco_sin(nco1.phase);
+        float osc = osc1;
+
+        /* ===== wave addition ===== */
+        if (use_osc2)
+        {
+            float osc2 = nco_sin(nco2.phase);
+            osc = (1.0f - p->mix2) * osc1 + p->mix2 * osc2;
+        }
+
+        /* ===== noise ===== */
+        float noise = 0.0f;
+        if (use_noise)
+        {
+            noise_state = noise_state * 1664525u + 1013904223u;
+            noise = p->noise_amt *
+                    ((float)((int)(noise_state >> 8) % 200 - 100) / 100.0f);
+        }
+
+        buffer[k] = env * (osc + noise);
+
+        /* ===== pitch envelope ===== */
+        if (use_fm)
+        {
+            float freq_mod = p->fm_amount * expf(-p->fm_k * t);
+            nco_set_freq(&nco1, p->freq1 + freq_mod, sample_rate);
+        }
+
+        /* ===== phase advancement ===== */
+        nco_advance(&nco1);
+        nco_advance(&nco2);
+    }
+
+    v->nco1 = nco1;
+    v->nco2 = nco2;
+    v->noise_state = noise_state;
+    v->pos = start + n;
+}
+
+#define DRUM_KERNEL(n)                                                          \
+    static void render_##n(DrumVoice *v, float *buffer, int count)              \
+    {                                                                           \
+        render_stages(v, buffer, count, (n) & 8, (n) & 4, (n) & 2, (n) & 1);    \
+    }
+
+DRUM_KERNEL(0)  DRUM_KERNEL(1)  DRUM_KERNEL(2)  DRUM_KERNEL(3)
+DRUM_KERNEL(4)  DRUM_KERNEL(5)  DRUM_KERNEL(6)  DRUM_KERNEL(7)
+DRUM_KERNEL(8)  DRUM_KERNEL(9)  DRUM_KERNEL(10) DRUM_KERNEL(11)
+DRUM_KERNEL(12) DRUM_KERNEL(13) DRUM_KERNEL(14) DRUM_KERNEL(15)
+
+typedef void (*DrumKernel)(DrumVoice *v, float *buffer, int count);
+
+/* index bits: env, fm, osc2, noise */
+static const DrumKernel drum_kernels[16] =
+{
+    render_0,  render_1,  render_2,  render_3,
+    render_4,  render_5,  render_6,  render_7,
+    render_8,  render_9,  render_10, render_11,
+    render_12, render_13, render_14, render_15,
+};
+
+void drum_voice_start(DrumVoice *v, const DrumParams *p, double sample_rate)
+{
+    v->params = *p;
+    v->sample_rate = sample_rate;
+
+    v->nco1 = (Nco){0, 0};
+    v->nco2 = (Nco){0, 0};
+    nco_set_freq(&v->nco1, p->freq1, sample_rate);
+    nco_set_freq(&v->nco2, p->freq2, sample_rate);
+
+    v->noise_state = p->seed;
+    v->pos = 0;
+
+    v->kernel = (p->use_env   ? 8 : 0)
+              | (p->use_fm    ? 4 : 0)
+              | (p->mix2 > 0  ? 2 : 0)
+              | (p->use_noise ? 1 : 0);
+}
+
+int drum_voice_render(DrumVoice *v, float *out, int n)
+{
+    int left = v->params.length - v->pos;
+    if (n > left) n = left;
+    if (n <= 0) return 0;
+
+    drum_kernels[v->kernel](v, out, n);
+    return n;
+}
+
+void generate_sample(float *buffer, DrumParams *p, double sample_rate)
+{
+    DrumVoice v;
+
+    drum_voice_start(&v, p, sample_rate);
+    drum_voice_render(&v, buffer, p->length);
+}
+
+/* ===== presets ===== */
+void play_kick(DrumParams *p)
+{
+    p->freq1 = 80.0f;
+    p->freq2 = 0.0f;
+    p->mix2 = 0.0f;
+
+    p->use_fm = 1;
+    p->fm_amount = 40.0f;
+    p->fm_k = 15.0f;
+
+    p->use_noise = 0;
+    p->noise_amt = 0.0f;
+
+    p->use_env = 1;
+    p->env_k = 10.0f;
+
+    p->length = 12000;
+}
+
+void play_snare(DrumParams *p)
+{
+    p->freq1 = 180.0f;
+    p->freq2 = 0.0f;
+    p->mix2 = 0.0f;
+
+    p->use_fm = 0;
+    p->fm_amount = 0.0f;
+    p->fm_k = 0.0f;
+
+    p->use_noise = 1;
+    p->noise_amt = 0.4f;
+
+    p->use_env = 1;
+    p->env_k = 7.0f;
+
+    p->length = 12000;
+}
+
+void play_hihat(DrumParams *p)
+{
+    p->freq1 = 8000.0f;
+    p->freq2 = 11000.0f;
+    p->mix2 = 0.5f;
+
+    p->use_fm = 0;
+
+    p->use_noise = 1;
+    p->noise_amt = 0.7f;
+
+    p->use_env = 1;
+    p->env_k = 8.0f;
+
+    p->length = 15000;
+}
+
+void play_tom(DrumParams *p)
+{
+    p->freq1 = 200.0f;
+    p->freq2 = 300.0f;
+    p->mix2 = 0.3f;
+
+    p->use_fm = 1;
+    p->fm_amount = 50.0f;
+    p->fm_k = 10.0f;
+
+    p->use_noise = 0;
+    p->noise_amt = 0.0f;
+
+    p->use_env = 1;
+    p->env_k = 8.0f;
+
+    p->length = 10000;
+}
+
+/* ===== handover ===== */
+
+static long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* the sampler pad with these params on it, or -1 */
+static int find_pad(DrumSynth *d, const DrumParams *p)
+{
+    for (int k = 0; k < DRUM_SAMPLER_PADS; k++)
+        if (d->pad_loaded[k] && memcmp(&d->pad_params[k], p, sizeof(*p)) == 0)
+            return k;
+
+    return -1;
+}
+
+/* the pad used the longest ago */
+static int oldest_pad(DrumSynth *d)
+{
+    int oldest = 0;
+
+    for (int k = 1; k < DRUM_SAMPLER_PADS; k++)
+        if (d->pad_clock - d->pad_used[k] > d->pad_clock - d->pad_used[oldest])
+            oldest = k;
+
+    return oldest;
+}
+
+/*
+ * Renders a hit into the back buffer and hands it over, to the audio
+ * thread or to the sampler. Only one thread may do this at a time: the
+ * worker, or without one, the caller of drum_trigger().
+ */
+static void render_hit(DrumSynth *d, DrumParams *p, long requested_ns)
+{
+    DrumSample *s = &d->sample[d->back];
+
+    long t0 = now_ns();
+
+    /* on a pad already: nothing to render */
+    if (d->sampler)
+    {
+        int pad = find_pad(d, p);
+
+        if (pad >= 0)
+        {
+            d->pad_used[pad] = ++d->pad_clock;
+            drum_sampler_hit(d->sampler, pad, 0.8f);
+            atomic_store(&d->render_ns, now_ns() - t0);
+            return;
+        }
+    }
+
+    if (d->cache)
+        s->len = drum_cache_render(d->cache, s->buf, p, d->sample_rate);
+    else
+    {
+        generate_sample(s->buf, p, d->sample_rate);
+        s->len = p->length;
+    }
+    atomic_store(&d->render_ns, now_ns() - t0);
+
+    s->requested_ns = requested_ns;
+
+    pthread_mutex_lock(&d->lock);
+    memcpy(d->preview, s->buf, s->len * sizeof(float));
+    d->preview_len = s->len;
+    pthread_mutex_unlock(&d->lock);
+
+    if (d->sampler)
+    {
+        int pad = oldest_pad(d);
+
+        /* without memory for the sound the pad keeps its old one, and hitting it would play that */
+        d->pad_loaded[pad] = 0;
+        if (drum_sampler_load(d->sampler, pad, s->buf, s->len) < 0)
+            return;
+
+        d->pad_params[pad] = *p;
+        d->pad_loaded[pad] = 1;
+        d->pad_used[pad] = ++d->pad_clock;
+        drum_sampler_hit(d->sampler, pad, 0.8f);
+        return;
+    }
+
+    /* the buffer is written before the audio thread can see it's fresh */
+    d->back = atomic_exchange(&d->middle, d->back | DRUM_FRESH) & ~DRUM_FRESH;
+}
+
+static void *worker(void *arg)
+{
+    DrumSynth *d = arg;
+
+    pthread_mutex_lock(&d->lock);
+
+    for (;;)
+    {
+        while (!d->requests && !d->quit)
+            pthread_cond_wait(&d->wake, &d->lock);
+
+        if (d->quit) break;
+
+        /* hits asked for while the last one rendered: only the newest counts */
+        DrumParams p = d->request;
+        long requested_ns = d->request_ns;
+        d->requests = 0;
+
+        pthread_mutex_unlock(&d->lock);
+
+        render_hit(d, &p, requested_ns);
+
+        if (d->on_rendered)
+            d->on_rendered(d->on_rendered_ctx);
+
+        pthread_mutex_lock(&d->lock);
+    }
+
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+
+/* ===== playback ===== */
+static void drum_process(SynthState *s, float *out, int frames)
+{
+    DrumSynth *d = (DrumSynth *)s;
+
+    /* a new hit starts with the block */
+    if (atomic_load_explicit(&d->middle, memory_order_relaxed) & DRUM_FRESH)
+    {
+        d->front = atomic_exchange(&d->middle, d->front) & ~DRUM_FRESH;
+        d->playing = 1;
+        d->play_pos = 0;
+
+        atomic_store_explicit(&d->latency_ns, now_ns() - d->sample[d->front].requested_ns,
+                              memory_order_relaxed);
+    }
+
+    DrumSample *sample = &d->sample[d->front];
+
+    for (int i = 0; i < frames; i++)
+    {
+        if (d->playing && d->play_pos < sample->len)
+            out[i] = sample->buf[d->play_pos++] * 0.8f;
+        else
+        {
+            out[i] = 0;
+            d->playing = 0;
+            d->play_pos = 0;
+        }
+    }
+}
+
+void drum_init(DrumSynth *d, double sample_rate)
+{
+    memset(d, 0, sizeof(*d));
+
+    d->base.process = drum_process;
+    d->sample_rate = sample_rate;
+
+    d->params = (DrumParams)
+    {
+        .freq1 = 180.0f,
+        .freq2 = 350.0f,
+        .mix2 = 0.0f,
+
+        .use_fm = 0,
+        .fm_amount = 80.0f,
+        .fm_k = 12.0f,
+
+        .use_noise = 0,
+        .noise_amt = 0.4f,
+
+        .use_env = 0,
+        .env_k = 7.0f,
+
+        .length = 12000,
+        .seed = 1
+    };
+
+    d->front = 0;
+    atomic_init(&d->middle, 1);
+    d->back = 2;
+
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->wake, NULL);
+    atomic_init(&d->render_ns, 0);
+    atomic_init(&d->latency_ns, 0);
+
+    nco_init();
+
+    /* something to draw before the first hit */
+    generate_sample(d->preview, &d->params, sample_rate);
+    d->preview_len = d->params.length;
+}
+
+void drum_free(DrumSynth *d)
+{
+    if (d->worker_running)
+    {
+        pthread_mutex_lock(&d->lock);
+        d->quit = 1;
+        pthread_cond_signal(&d->wake);
+        pthread_mutex_unlock(&d->lock);
+
+        pthread_join(d->thread, NULL);
+        d->worker_running = 0;
+    }
+
+    pthread_cond_destroy(&d->wake);
+    pthread_mutex_destroy(&d->lock);
+}
+
+void drum_trigger(DrumSynth *d)
+{
+    render_hit(d, &d->params, now_ns());
+}
+
+int drum_start_worker(DrumSynth *d)
+{
+    if (d->worker_running) return 0;
+
+    d->quit = 0;
+    d->requests = 0;
+
+    if (pthread_create(&d->thread, NULL, worker, d) != 0)
+        return -1;
+
+    d->worker_running = 1;
+    return 0;
+}
+
+void drum_request(DrumSynth *d)
+{
+    long t = now_ns();
+
+    if (!d->worker_running)
+    {
+        d->request_ns = t;
+        render_hit(d, &d->params, t);
+        return;
+    }
+
+    pthread_mutex_lock(&d->lock);
+    d->request = d->params;
+    d->request_ns = t;
+    d->requests++;
+    pthread_cond_signal(&d->wake);
+    pthread_mutex_unlock(&d->lock);
+}
+
+void drum_clamp_params(DrumParams *p, int max_length)
+{
+    if (p->mix2 < 0) p->mix2 = 0;
+    if (p->mix2 > 1) p->mix2 = 1;
+    if (p->noise_amt < 0) p->noise_amt = 0;
+    if (p->env_k < 0.1f) p->env_k = 0.1f;
+    if (p->fm_k < 0.1f) p->fm_k = 0.1f;
+    if (p->length < 100) p->length = 100;
+    if (p->length > max_length) p->length = max_length;
+}
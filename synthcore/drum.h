@@ -0,0 +1,175 @@
+#ifndef DRUM_H
+#define DRUM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "drumsampler.h"
+#include "nco.h"
+#include "synth.h"
+
+/*
+ * The drum sample synth: two sine oscillators, a pitch envelope, noise and
+ * an amplitude envelope, rendered into a buffer that is then played back.
+ *
+ * There are three buffers, and each one belongs to somebody: the audio
+ * thread plays the front one, whoever renders writes the back one, and the
+ * middle one is the handover. A finished back buffer is swapped with the
+ * middle one (one atomic exchange) and marked fresh; at the start of its
+ * next block the audio thread swaps a fresh middle buffer with its front
+ * one and plays it from the start. So a hit never plays a buffer that's
+ * being written, and nobody waits for anybody. If a new hit is finished
+ * before the audio thread took the last one, the last one is dropped.
+ *
+ * drum_trigger() renders on the calling thread, which is what the offline
+ * tools want. The UI uses drum_request() instead, which hands the current
+ * params to a worker thread (drum_start_worker()) and returns at once; the
+ * hit sounds as soon as the worker is done with it. latency_ns says how
+ * long the last one took from the request to the block it started in.
+ *
+ * The noise comes from its own generator, started from params.seed for
+ * every hit, so the same params always give the same sample. That's what
+ * lets a DrumCache (drumcache.h) hand out samples rendered before.
+ *
+ * With a DrumSampler (drumsampler.h) set, finished hits go to that instead
+ * of the three buffers, and play on top of each other. Every pad of the
+ * sampler holds the sound of one set of params; a hit with params that are
+ * on a pad already only hits the pad, anything else is rendered into the
+ * back buffer and loaded on the pad that was used the longest ago.
+ *
+ * The rendering itself is a DrumVoice, which can also be run a block at a
+ * time right in the audio callback, with no buffer at all (drumstream.h).
+ * generate_sample() is a voice run to the end in one go, so both give the
+ * same samples.
+ */
+
+#define MAX_SAMPLES 44100
+
+/* the middle buffer has a new hit that wasn't played yet */
+#define DRUM_FRESH 4
+
+typedef struct
+{
+    float freq1;
+    float freq2;
+    float mix2;
+
+    int use_fm;
+    float fm_amount;
+    float fm_k;
+
+    int use_noise;
+    float noise_amt;
+    unsigned seed;          /* of the noise */
+
+    int use_env;
+    float env_k;
+
+    int length;
+} DrumParams;
+
+/* one hit being rendered, picks up where the last drum_voice_render() stopped */
+typedef struct
+{
+    DrumParams params;
+    double sample_rate;
+
+    Nco nco1, nco2;
+    uint32_t noise_state;
+    int pos;                /* samples rendered so far */
+    int kernel;             /* which stages are on */
+} DrumVoice;
+
+typedef struct
+{
+    float buf[MAX_SAMPLES];
+    int len;
+    long requested_ns;      /* when the hit was asked for, for the latency */
+} DrumSample;
+
+typedef struct
+{
+    SynthState base;
+
+    DrumParams params;
+
+    /* NULL, or where the renderer looks for the sample first */
+    struct DrumCache *cache;
+
+    /* NULL, or where the hits play; the pads are the renderer's */
+    DrumSampler *sampler;
+    DrumParams pad_params[DRUM_SAMPLER_PADS];
+    int pad_loaded[DRUM_SAMPLER_PADS];
+    unsigned pad_used[DRUM_SAMPLER_PADS];
+    unsigned pad_clock;
+
+    DrumSample sample[3];
+    int back;                   /* the renderer's */
+    atomic_int middle;          /* index | DRUM_FRESH */
+    int front;                  /* the audio thread's */
+    int play_pos;
+    int playing;
+
+    /* the worker, everything below the lock is shared with the UI thread */
+    pthread_t thread;
+    int worker_running;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int requests;               /* hits asked for, not rendered yet */
+    int quit;
+    DrumParams request;         /* the params of the newest one */
+    long request_ns;            /* UI thread, when the newest hit was asked for */
+
+    /* a copy of the last hit rendered, for drawing */
+    float preview[MAX_SAMPLES];
+    int preview_len;
+
+    /* called on the worker after every hit it rendered, e.g. to wake the UI */
+    void (*on_rendered)(void *ctx);
+    void *on_rendered_ctx;
+
+    /* the last hit, in ns */
+    atomic_long render_ns;      /* rendering it */
+    atomic_long latency_ns;     /* from the request to the block it started in */
+
+    double sample_rate;
+} DrumSynth;
+
+void drum_init(DrumSynth *d, double sample_rate);
+
+/* stops the worker, if there is one */
+void drum_free(DrumSynth *d);
+
+/* renders p->length samples of the drum described by p into buffer */
+void generate_sample(float *buffer, DrumParams *p, double sample_rate);
+
+void drum_voice_start(DrumVoice *v, const DrumParams *p, double sample_rate);
+
+/* renders the next n samples, fewer at the end of the hit; returns how many */
+int drum_voice_render(DrumVoice *v, float *out, int n);
+
+/*
+ * Renders a hit from d->params right here and starts it with the next block.
+ * Not while the worker runs, it owns the back buffer then.
+ */
+void drum_trigger(DrumSynth *d);
+
+/* starts the render thread, returns 0 or -1 */
+int drum_start_worker(DrumSynth *d);
+
+/*
+ * Asks the worker for a hit with the current d->params and returns at once.
+ * Without a worker it's drum_trigger().
+ */
+void drum_request(DrumSynth *d);
+
+/* keeps the parameters in a range that still makes sense, max_length is MAX_SAMPLES for DrumSynth */
+void drum_clamp_params(DrumParams *p, int max_length);
+
+/* presets */
+void play_kick(DrumParams *p);
+void play_snare(DrumParams *p);
+void play_hihat(DrumParams *p);
+void play_tom(DrumParams *p);
+
+#endif
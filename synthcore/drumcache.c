@@ -0,0 +1,170 @@
+#include "drumcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ===== key ===== */
+
+/* the params with what the sample doesn't depend on zeroed (the memset zeroes the padding too) */
+static void make_key(DrumParams *key, const DrumParams *p)
+{
+    memset(key, 0, sizeof(*key));
+
+    key->freq1 = p->freq1;
+    key->length = p->length;
+
+    if (p->mix2 > 0)
+    {
+        key->freq2 = p->freq2;
+        key->mix2 = p->mix2;
+    }
+
+    if (p->use_fm)
+    {
+        key->use_fm = 1;
+        key->fm_amount = p->fm_amount;
+        key->fm_k = p->fm_k;
+    }
+
+    if (p->use_noise)
+    {
+        key->use_noise = 1;
+        key->noise_amt = p->noise_amt;
+        key->seed = p->seed;
+    }
+
+    if (p->use_env)
+    {
+        key->use_env = 1;
+        key->env_k = p->env_k;
+    }
+}
+
+/* FNV-1a over the bytes of the key */
+static uint32_t hash_key(const DrumParams *key, double sample_rate)
+{
+    const unsigned char *b = (const unsigned char *)key;
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < sizeof(*key); i++)
+        h = (h ^ b[i]) * 16777619u;
+
+    b = (const unsigned char *)&sample_rate;
+    for (size_t i = 0; i < sizeof(sample_rate); i++)
+        h = (h ^ b[i]) * 16777619u;
+
+    return h;
+}
+
+/* ===== least recently used list ===== */
+
+static void unlink_entry(DrumCache *c, DrumCacheEntry *e)
+{
+    if (e->newer) e->newer->older = e->older;
+    else c->newest = e->older;
+
+    if (e->older) e->older->newer = e->newer;
+    else c->oldest = e->newer;
+}
+
+static void push_newest(DrumCache *c, DrumCacheEntry *e)
+{
+    e->newer = NULL;
+    e->older = c->newest;
+
+    if (c->newest) c->newest->newer = e;
+    else c->oldest = e;
+
+    c->newest = e;
+}
+
+static size_t entry_bytes(int len)
+{
+    return sizeof(DrumCacheEntry) + len * sizeof(float);
+}
+
+static void evict_oldest(DrumCache *c)
+{
+    DrumCacheEntry *e = c->oldest;
+
+    DrumCacheEntry **link = &c->bucket[e->hash & (DRUM_CACHE_BUCKETS - 1)];
+    while (*link != e)
+        link = &(*link)->next;
+    *link = e->next;
+
+    unlink_entry(c, e);
+
+    c->bytes -= entry_bytes(e->len);
+    c->count--;
+    free(e);
+}
+
+/* ===== cache ===== */
+
+void drum_cache_init(DrumCache *c, double max_mb)
+{
+    memset(c, 0, sizeof(*c));
+
+    c->max_bytes = (size_t)(max_mb * 1024 * 1024);
+    atomic_init(&c->hits, 0);
+    atomic_init(&c->misses, 0);
+}
+
+void drum_cache_free(DrumCache *c)
+{
+    while (c->oldest)
+        evict_oldest(c);
+}
+
+int drum_cache_render(DrumCache *c, float *out, const DrumParams *p, double sample_rate)
+{
+    DrumParams key;
+    make_key(&key, p);
+
+    uint32_t h = hash_key(&key, sample_rate);
+    DrumCacheEntry **bucket = &c->bucket[h & (DRUM_CACHE_BUCKETS - 1)];
+
+    for (DrumCacheEntry *e = *bucket; e; e = e->next)
+    {
+        if (e->hash == h && e->sample_rate == sample_rate && memcmp(&e->key, &key, sizeof(key)) == 0)
+        {
+            unlink_entry(c, e);
+            push_newest(c, e);
+
+            memcpy(out, e->buf, e->len * sizeof(float));
+            atomic_fetch_add_explicit(&c->hits, 1, memory_order_relaxed);
+            return e->len;
+        }
+    }
+
+    /* the key renders the same sample as p, with less to look at */
+    generate_sample(out, &key, sample_rate);
+    atomic_fetch_add_explicit(&c->misses, 1, memory_order_relaxed);
+
+    int len = key.length;
+    size_t size = entry_bytes(len);
+
+    if (size > c->max_bytes) return len;
+
+    while (c->bytes + size > c->max_bytes)
+        evict_oldest(c);
+
+    /* no memory just means no caching */
+    DrumCacheEntry *e = malloc(size);
+    if (!e) return len;
+
+    e->key = key;
+    e->sample_rate = sample_rate;
+    e->hash = h;
+    e->len = len;
+    memcpy(e->buf, out, len * sizeof(float));
+
+    e->next = *bucket;
+    *bucket = e;
+    push_newest(c, e);
+
+    c->bytes += size;
+    c->count++;
+
+    return len;
+}
@@ -0,0 +1,76 @@
+#ifndef DRUMCACHE_H
+#define DRUMCACHE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "drum.h"
+
+/*
+ * Drum samples rendered before, by their params.
+ *
+ * A sample only depends on its DrumParams (the noise too, through the
+ * seed) and the sample rate, so a hit with params that were rendered before
+ * can be copied instead of rendered again. Hitting the same sound over and
+ * over, or going back and forth between presets, then costs a lookup and a
+ * copy.
+ *
+ * The key is the params with every field the sample doesn't depend on set
+ * to 0 (the pitch envelope when it's off, the noise when it's off, ...),
+ * so a preset finds its sample whatever was left in the unused fields. It
+ * is found by a hash, and then the whole key is compared, so two sounds
+ * with the same hash can't get mixed up.
+ *
+ * The cache holds at most max_bytes of samples. When a new one doesn't fit,
+ * the ones that were used the longest ago are thrown out (least recently
+ * used), so a pattern of a few sounds stays in for good.
+ *
+ * Only one thread may use a cache, the one that renders (the drum worker,
+ * or whoever calls drum_trigger()). hits and misses can be read anywhere.
+ *
+ *   DrumCache cache;
+ *   drum_cache_init(&cache, 16);
+ *   drum.cache = &cache;
+ */
+
+#define DRUM_CACHE_BUCKETS 256      /* power of two */
+
+typedef struct DrumCacheEntry DrumCacheEntry;
+
+struct DrumCacheEntry
+{
+    DrumParams key;
+    double sample_rate;
+    uint32_t hash;
+
+    DrumCacheEntry *next;           /* in the same bucket */
+    DrumCacheEntry *newer, *older;  /* by last use */
+
+    int len;
+    float buf[];
+};
+
+typedef struct DrumCache
+{
+    DrumCacheEntry *bucket[DRUM_CACHE_BUCKETS];
+    DrumCacheEntry *newest, *oldest;
+
+    size_t bytes;       /* of all entries */
+    size_t max_bytes;
+    int count;
+
+    atomic_ulong hits;
+    atomic_ulong misses;
+} DrumCache;
+
+void drum_cache_init(DrumCache *c, double max_mb);
+void drum_cache_free(DrumCache *c);
+
+/*
+ * generate_sample(), but from the cache when these params were rendered
+ * before. A miss is rendered and kept. Returns the length of the sample.
+ */
+int drum_cache_render(DrumCache *c, float *out, const DrumParams *p, double sample_rate);
+
+#endif
@@ -0,0 +1,307 @@
+#include "drumsampler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* samples of one voice side by side */
+#ifdef __AVX__
+#define LANES 8
+#else
+#define LANES 4
+#endif
+
+typedef float vf __attribute__((vector_size(LANES * 4)));
+
+static inline vf load_f(const float *p)
+{
+    vf v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store_f(float *p, vf v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* ===== handover ===== */
+
+/* loading thread: frees what the audio thread has given back */
+static void collect_retired(DrumSampler *s)
+{
+    unsigned head = atomic_load_explicit(&s->retired_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&s->retired_tail, memory_order_acquire);
+
+    for (; head != tail; head++)
+        free(s->retired[head & (DRUM_SAMPLER_RETIRED - 1)]);
+
+    atomic_store_explicit(&s->retired_head, head, memory_order_release);
+}
+
+/* audio thread: gives back the replaced sounds nobody plays any more, as many as fit */
+static void retire_drained(DrumSampler *s)
+{
+    unsigned tail = atomic_load_explicit(&s->retired_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&s->retired_head, memory_order_acquire);
+
+    for (int i = 0; i < s->draining_count; )
+    {
+        DrumSound *d = s->draining[i];
+
+        if (d->users > 0 || tail - head == DRUM_SAMPLER_RETIRED)
+        {
+            i++;
+            continue;
+        }
+
+        s->retired[tail++ & (DRUM_SAMPLER_RETIRED - 1)] = d;
+        s->draining[i] = s->draining[--s->draining_count];
+    }
+
+    atomic_store_explicit(&s->retired_tail, tail, memory_order_release);
+}
+
+/* audio thread: swaps in pad p's newly loaded sound, if it has one */
+static void take_pending(DrumSampler *s, int p)
+{
+    if (!atomic_load_explicit(&s->pending[p], memory_order_relaxed)) return;
+
+    /* no room to park the old one (see DRUM_SAMPLER_DRAIN, it can't happen): next time */
+    if (s->pad[p] && s->draining_count == DRUM_SAMPLER_DRAIN) return;
+
+    DrumSound *sound = atomic_exchange_explicit(&s->pending[p], NULL, memory_order_acq_rel);
+    if (!sound) return;
+
+    if (s->pad[p])
+        s->draining[s->draining_count++] = s->pad[p];
+
+    s->pad[p] = sound;
+}
+
+static void pick_up(DrumSampler *s)
+{
+    for (int p = 0; p < DRUM_SAMPLER_PADS; p++)
+        take_pending(s, p);
+}
+
+int drum_sampler_load(DrumSampler *s, int pad, const float *buf, int len)
+{
+    collect_retired(s);
+
+    if (pad < 0 || pad >= DRUM_SAMPLER_PADS || len <= 0) return -1;
+
+    int peaks = (len + DRUM_SAMPLER_PEAK_BLOCK - 1) / DRUM_SAMPLER_PEAK_BLOCK;
+
+    DrumSound *sound = malloc(sizeof(DrumSound) + (len + peaks) * sizeof(float));
+    if (!sound) return -1;
+
+    sound->len = len;
+    sound->users = 0;
+    sound->peak = sound->buf + len;
+    memcpy(sound->buf, buf, len * sizeof(float));
+
+    for (int k = 0; k < peaks; k++)
+    {
+        float peak = 0;
+
+        for (int i = k * DRUM_SAMPLER_PEAK_BLOCK; i < len && i < (k + 1) * DRUM_SAMPLER_PEAK_BLOCK; i++)
+        {
+            float a = buf[i] < 0 ? -buf[i] : buf[i];
+            if (a > peak) peak = a;
+        }
+
+        sound->peak[k] = peak;
+    }
+
+    /* the sound is written before the audio thread can see the pointer */
+    DrumSound *stale = atomic_exchange_explicit(&s->pending[pad], sound, memory_order_acq_rel);
+
+    /* loaded but never picked up, the audio thread hasn't seen it */
+    free(stale);
+    return 0;
+}
+
+/* ===== hits ===== */
+
+int drum_sampler_hit(DrumSampler *s, int pad, float gain)
+{
+    return paramq_push(&s->hits, pad, gain);
+}
+
+/* how loud voice v is around where it's playing */
+static float loudness(const DrumSampler *s, int v)
+{
+    const DrumSound *sound = s->sound[v];
+    return s->gain[v] * sound->peak[s->pos[v] / DRUM_SAMPLER_PEAK_BLOCK];
+}
+
+static int find_voice(DrumSampler *s)
+{
+    for (int v = 0; v < DRUM_SAMPLER_VOICES; v++)
+        if (!s->sound[v])
+            return v;
+
+    /* all busy: the quietest, the oldest of those */
+    int best = 0;
+    float best_loudness = loudness(s, 0);
+
+    for (int v = 1; v < DRUM_SAMPLER_VOICES; v++)
+    {
+        float l = loudness(s, v);
+
+        if (l < best_loudness ||
+            (l == best_loudness && s->hit_count - s->age[v] > s->hit_count - s->age[best]))
+        {
+            best = v;
+            best_loudness = l;
+        }
+    }
+
+    s->sound[best]->users--;
+    atomic_fetch_add_explicit(&s->stolen, 1, memory_order_relaxed);
+    return best;
+}
+
+int drum_sampler_play(DrumSampler *s, int pad, float gain)
+{
+    DrumSound *sound = NULL;
+
+    /*
+     * A load that came before the hit may have missed pick_up(). The queue
+     * made it visible here: its pending store is before the hit's push.
+     */
+    if (pad >= 0 && pad < DRUM_SAMPLER_PADS)
+    {
+        take_pending(s, pad);
+        sound = s->pad[pad];
+    }
+
+    if (!sound)
+    {
+        atomic_fetch_add_explicit(&s->dropped, 1, memory_order_relaxed);
+        return -1;
+    }
+
+    int v = find_voice(s);
+
+    s->sound[v] = sound;
+    s->pos[v] = 0;
+    s->gain[v] = gain;
+    s->age[v] = s->hit_count++;
+    sound->users++;
+    return 0;
+}
+
+static void apply_hits(DrumSampler *s)
+{
+    ParamMsg m;
+    int any = 0;
+
+    while (paramq_pop(&s->hits, &m))
+        any |= drum_sampler_play(s, m.id, (float)m.value) == 0;
+
+    if (any)
+        atomic_store_explicit(&s->hit_ns, now_ns(), memory_order_relaxed);
+}
+
+void drum_sampler_update(DrumSampler *s)
+{
+    retire_drained(s);
+    pick_up(s);
+    apply_hits(s);
+}
+
+/* ===== process ===== */
+
+/* out += in * gain, a vector at a time */
+static void mix_voice(float *out, const float *in, float gain, int n)
+{
+    int i = 0;
+
+    for (; i + 2 * LANES <= n; i += 2 * LANES)
+    {
+        store_f(out + i, load_f(out + i) + load_f(in + i) * gain);
+        store_f(out + i + LANES, load_f(out + i + LANES) + load_f(in + i + LANES) * gain);
+    }
+
+    for (; i < n; i++)
+        out[i] += in[i] * gain;
+}
+
+static void drum_sampler_process(SynthState *st, float *out, int frames)
+{
+    DrumSampler *s = (DrumSampler *)st;
+    int playing = 0;
+
+    drum_sampler_update(s);
+
+    memset(out, 0, frames * sizeof(float));
+
+    for (int v = 0; v < DRUM_SAMPLER_VOICES; v++)
+    {
+        DrumSound *sound = s->sound[v];
+        if (!sound) continue;
+
+        int n = sound->len - s->pos[v];
+        if (n > frames) n = frames;
+
+        mix_voice(out, sound->buf + s->pos[v], s->gain[v], n);
+        s->pos[v] += n;
+
+        if (s->pos[v] >= sound->len)
+        {
+            sound->users--;
+            s->sound[v] = NULL;
+        }
+        else
+            playing++;
+    }
+
+    atomic_store_explicit(&s->playing, playing, memory_order_relaxed);
+}
+
+void drum_sampler_init(DrumSampler *s, double sample_rate)
+{
+    memset(s, 0, sizeof(*s));
+
+    s->base.process = drum_sampler_process;
+    s->sample_rate = sample_rate;
+
+    paramq_init(&s->hits);
+
+    for (int p = 0; p < DRUM_SAMPLER_PADS; p++)
+        atomic_init(&s->pending[p], NULL);
+
+    atomic_init(&s->retired_head, 0);
+    atomic_init(&s->retired_tail, 0);
+    atomic_init(&s->playing, 0);
+    atomic_init(&s->stolen, 0);
+    atomic_init(&s->dropped, 0);
+    atomic_init(&s->hit_ns, 0);
+}
+
+void drum_sampler_free(DrumSampler *s)
+{
+    collect_retired(s);
+
+    for (int p = 0; p < DRUM_SAMPLER_PADS; p++)
+    {
+        free(atomic_exchange(&s->pending[p], NULL));
+        free(s->pad[p]);
+        s->pad[p] = NULL;
+    }
+
+    for (int i = 0; i < s->draining_count; i++)
+        free(s->draining[i]);
+    s->draining_count = 0;
+
+    memset(s->sound, 0, sizeof(s->sound));
+}
@@ -0,0 +1,123 @@
+#ifndef DRUMSAMPLER_H
+#define DRUMSAMPLER_H
+
+#include <stdatomic.h>
+
+#include "paramq.h"
+#include "synth.h"
+
+/*
+ * A sampler for rendered drum sounds: DRUM_SAMPLER_PADS pads with a sound
+ * each, and DRUM_SAMPLER_VOICES voices that play them, as many at once and
+ * as often as you like, so hits overlap instead of cutting each other off.
+ *
+ * One other thread (the UI, or the drum render thread) loads a sound into
+ * a pad with drum_sampler_load(), which copies it and hands it over with
+ * one atomic pointer swap, and hits a pad with drum_sampler_hit(), through
+ * the parameter queue. The audio thread picks both up at the start of its
+ * next block. A hit takes its pad's new sound if there is one, so a load
+ * and then a hit from the same thread always play the new sound, even
+ * when they land in the middle of the audio thread's pick-up.
+ *
+ * A sound never changes once it's loaded, and the audio thread never frees
+ * anything: the sound a pad had before keeps playing in the voices that
+ * started it, and when the last of them is done it goes back to the
+ * loading thread, which frees it on its next load (the same way the
+ * additive synth hands back its snapshots).
+ *
+ * When every voice is busy, a hit takes the one that's quietest right now,
+ * the oldest of those if several are. How loud a voice is comes from the
+ * peak of its sound around where it's playing, worked out per
+ * DRUM_SAMPLER_PEAK_BLOCK samples on load. In a dense roll the quietest
+ * voices are the tails of old hits, which are close to silent anyway.
+ *
+ * Every voice is mixed a vector of samples at a time (4, 8 with AVX). The
+ * voices play different sounds at different positions, so there's nothing
+ * to gain from putting voices side by side in a vector; the samples of one
+ * voice are next to each other in memory and load in one go.
+ */
+
+#define DRUM_SAMPLER_PADS 16
+#define DRUM_SAMPLER_VOICES 64
+#define DRUM_SAMPLER_PEAK_BLOCK 256     /* samples per point of the loudness estimate */
+
+/*
+ * Replaced sounds still playing, and ones on their way back to the loading
+ * thread. Big enough never to fill: a replaced sound waits only while a
+ * voice plays it, or for a block after it's picked up (one per pad at
+ * most), and the loading thread empties the way back before every load,
+ * which is the only way a sound gets replaced.
+ */
+#define DRUM_SAMPLER_DRAIN (DRUM_SAMPLER_VOICES + DRUM_SAMPLER_PADS)
+#define DRUM_SAMPLER_RETIRED 128        /* power of two, more than DRUM_SAMPLER_DRAIN */
+
+/* the samples never change once loaded, peak[] and buf[] are in the same allocation */
+typedef struct
+{
+    int len;
+    float *peak;            /* per DRUM_SAMPLER_PEAK_BLOCK samples */
+    int users;              /* voices playing it, audio thread only */
+    float buf[];
+} DrumSound;
+
+typedef struct
+{
+    SynthState base;
+
+    ParamQueue hits;                                    /* id = pad, value = gain */
+
+    /* the handover */
+    _Atomic(DrumSound *) pending[DRUM_SAMPLER_PADS];    /* loaded, not picked up yet */
+    DrumSound *retired[DRUM_SAMPLER_RETIRED];
+    atomic_uint retired_head;                           /* written by the loading thread */
+    atomic_uint retired_tail;                           /* written by the audio thread */
+
+    /* audio thread */
+    DrumSound *pad[DRUM_SAMPLER_PADS];
+    DrumSound *draining[DRUM_SAMPLER_DRAIN];            /* replaced, waiting for their voices */
+    int draining_count;
+
+    DrumSound *sound[DRUM_SAMPLER_VOICES];              /* NULL when the voice is free */
+    int pos[DRUM_SAMPLER_VOICES];
+    float gain[DRUM_SAMPLER_VOICES];
+    unsigned age[DRUM_SAMPLER_VOICES];
+    unsigned hit_count;
+
+    /* for the UI */
+    atomic_int playing;             /* voices busy after the last block */
+    atomic_uint stolen;             /* hits that took a busy voice */
+    atomic_uint dropped;            /* hits on an empty pad */
+    atomic_long hit_ns;             /* CLOCK_MONOTONIC when the newest hit started */
+
+    double sample_rate;
+} DrumSampler;
+
+void drum_sampler_init(DrumSampler *s, double sample_rate);
+
+/* frees every sound, once the audio thread is stopped */
+void drum_sampler_free(DrumSampler *s);
+
+/*
+ * Copies len samples into pad, for the hits from the next block on.
+ * Returns 0, or -1 when there's no memory (the pad keeps its sound).
+ */
+int drum_sampler_load(DrumSampler *s, int pad, const float *buf, int len);
+
+/* plays pad from the next block on; returns -1 when the queue is full */
+int drum_sampler_hit(DrumSampler *s, int pad, float gain);
+
+/*
+ * Audio thread, between two blocks: plays pad from the start of the next
+ * one, with no queue in between. A sequencer renders up to the sample a
+ * hit falls on, calls this, and renders on. Returns -1 when the pad is empty.
+ */
+int drum_sampler_play(DrumSampler *s, int pad, float gain);
+
+/*
+ * Audio thread: picks up the loaded sounds and the queued hits now instead
+ * of at the next block, which does it anyway. For a sequencer whose hit
+ * falls on the first sample of a block, before anything is rendered.
+ */
+void drum_sampler_update(DrumSampler *s);
+
+#endif
@@ -0,0 +1,158 @@
+#include "drumseq.h"
+
+#include <math.h>
+#include <string.h>
+
+/* the level of a hit, the same as DrumSynth's */
+#define DRUM_SEQ_GAIN 0.8f
+
+/* ===== timing ===== */
+
+/* samples per sixteenth note */
+static double step_length(const DrumSeq *s)
+{
+    return s->sample_rate * 60.0 / s->tempo / 4.0;
+}
+
+/* where the next step is due, unswung: a step after the last one, at the tempo now */
+static double next_grid(const DrumSeq *s)
+{
+    return s->first ? s->grid : s->grid + step_length(s);
+}
+
+int64_t drum_seq_next_onset(const DrumSeq *s)
+{
+    double at = next_grid(s);
+
+    if (s->step & 1)
+        at += s->swing * step_length(s);
+
+    return (int64_t)floor(at + 0.5);
+}
+
+/* ===== events ===== */
+
+static void apply_events(DrumSeq *s)
+{
+    ParamMsg m;
+
+    while (paramq_pop(&s->events, &m))
+    {
+        switch (m.id)
+        {
+            case DRUM_SEQ_RUNNING:
+                if (m.value && !s->running)
+                {
+                    /* from step 0, on the first sample of this block */
+                    s->running = 1;
+                    s->step = 0;
+                    s->grid = (double)s->clock;
+                    s->first = 1;
+                }
+                else if (!m.value)
+                {
+                    s->running = 0;
+                    atomic_store_explicit(&s->shown_step, -1, memory_order_relaxed);
+                }
+                break;
+
+            case DRUM_SEQ_TEMPO:
+                s->tempo = m.value < 20 ? 20 : m.value > 400 ? 400 : m.value;
+                break;
+
+            case DRUM_SEQ_SWING:
+                s->swing = m.value < 0 ? 0 : m.value > 0.5 ? 0.5 : m.value;
+                break;
+
+            case DRUM_SEQ_STEPS:
+                s->steps = m.value < 1 ? 1 : m.value > DRUM_SEQ_MAX_STEPS ? DRUM_SEQ_MAX_STEPS : (int)m.value;
+                if (s->step >= s->steps) s->step = 0;
+                break;
+
+            default:
+                if (m.id >= DRUM_SEQ_PATTERN && m.id < DRUM_SEQ_PATTERN + DRUM_SEQ_TRACKS)
+                    s->pattern[m.id - DRUM_SEQ_PATTERN] = (uint32_t)m.value;
+                break;
+        }
+    }
+}
+
+int drum_seq_set(DrumSeq *s, DrumSeqParam param, double value)
+{
+    return paramq_push(&s->events, param, value);
+}
+
+/* ===== process ===== */
+
+static void drum_seq_process(SynthState *st, float *out, int frames)
+{
+    DrumSeq *s = (DrumSeq *)st;
+    int done = 0;
+
+    apply_events(s);
+
+    /* sounds loaded since the last block, for a hit on its first sample */
+    drum_sampler_update(&s->sampler);
+
+    /* the steps that fall into this block, each on its own sample */
+    while (s->running)
+    {
+        int64_t at = drum_seq_next_onset(s) - s->clock;
+        if (at >= frames) break;
+
+        int offset = at < done ? done : (int)at;
+
+        if (offset > done)
+        {
+            synth_process(&s->sampler.base, out + done, offset - done);
+            done = offset;
+        }
+
+        for (int t = 0; t < DRUM_SEQ_TRACKS; t++)
+            if (s->pattern[t] >> s->step & 1)
+                drum_sampler_play(&s->sampler, t, DRUM_SEQ_GAIN);
+
+        atomic_store_explicit(&s->shown_step, s->step, memory_order_relaxed);
+
+        /*
+         * The step after is worked out when it's due, with the tempo then.
+         * A step that was overdue at a new tempo counts from where it played,
+         * so the ones after it don't all pile onto the same sample.
+         */
+        double due = next_grid(s);
+
+        if (at < offset)
+            due = (double)(s->clock + offset) - (s->step & 1 ? s->swing * step_length(s) : 0);
+
+        s->grid = due;
+        s->first = 0;
+        s->step = (s->step + 1) % s->steps;
+    }
+
+    if (frames > done)
+        synth_process(&s->sampler.base, out + done, frames - done);
+
+    s->clock += frames;
+}
+
+void drum_seq_init(DrumSeq *s, double sample_rate)
+{
+    memset(s, 0, sizeof(*s));
+
+    s->base.process = drum_seq_process;
+    s->sample_rate = sample_rate;
+
+    drum_sampler_init(&s->sampler, sample_rate);
+    paramq_init(&s->events);
+
+    s->tempo = 120;
+    s->swing = 0;
+    s->steps = 16;
+
+    atomic_init(&s->shown_step, -1);
+}
+
+void drum_seq_free(DrumSeq *s)
+{
+    drum_sampler_free(&s->sampler);
+}
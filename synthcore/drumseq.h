@@ -0,0 +1,87 @@
+#ifndef DRUMSEQ_H
+#define DRUMSEQ_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "drumsampler.h"
+#include "paramq.h"
+#include "synth.h"
+
+/*
+ * A step sequencer for the drums: DRUM_SEQ_TRACKS tracks of up to
+ * DRUM_SEQ_MAX_STEPS sixteenth-note steps, each track a pad of its own
+ * DrumSampler, played in a loop at a tempo with some swing.
+ *
+ * The sequencer runs inside the audio callback, in samples, not in
+ * callbacks: it knows the sample every step falls on, and when one falls
+ * inside the block it renders the sampler up to that sample, starts the
+ * hits there and renders on. So a hit starts on its sample whatever the
+ * block size is and however late the callback runs, instead of on the next
+ * block after a key press. The steps are counted on a grid in doubles, one
+ * step length after the other, and rounded to the nearest sample only when
+ * they're played, so the rounding never adds up. The next step is one step
+ * length after the last one at the tempo when it's due, so a new tempo
+ * moves the very next step, the same way a new swing does (to the first
+ * sample of the block, if at the new tempo it's due already).
+ *
+ * Swing makes every second step (the off-beat sixteenths) late by that
+ * fraction of a step: 0 is straight, 1/3 is a triplet shuffle.
+ *
+ * running, tempo, swing, steps and pattern[] belong to the audio thread.
+ * From another thread change them with drum_seq_set(), which goes through
+ * the parameter queue; single-threaded code (the offline renderer) can
+ * write them directly between blocks. A tempo or swing change starts with
+ * the next step. The sounds of the tracks are loaded with
+ * drum_sampler_load() on seq->sampler, pad = track, from one thread.
+ */
+
+#define DRUM_SEQ_TRACKS 4           /* kick, snare, tom, hi-hat */
+#define DRUM_SEQ_MAX_STEPS 32
+
+typedef enum
+{
+    DRUM_SEQ_RUNNING,               /* 1 starts from step 0, 0 stops */
+    DRUM_SEQ_TEMPO,                 /* beats (quarter notes) per minute */
+    DRUM_SEQ_SWING,                 /* 0 .. 0.5 of a step */
+    DRUM_SEQ_STEPS,                 /* 1 .. DRUM_SEQ_MAX_STEPS */
+    DRUM_SEQ_PATTERN                /* + track, a bit per step, step 0 the lowest */
+} DrumSeqParam;
+
+typedef struct
+{
+    SynthState base;
+
+    DrumSampler sampler;            /* the sounds, pad = track */
+    ParamQueue events;              /* from the UI thread */
+
+    int running;
+    double tempo;
+    double swing;
+    int steps;
+    uint32_t pattern[DRUM_SEQ_TRACKS];
+
+    /* audio thread */
+    int64_t clock;                  /* samples played since the start */
+    double grid;                    /* where the last step was due, unswung, in samples */
+    int first;                      /* no step played since the start: the next is due at grid */
+    int step;                       /* the next step */
+
+    atomic_int shown_step;          /* the last step played, -1 when stopped, for the UI */
+
+    double sample_rate;
+} DrumSeq;
+
+/* stopped, 120 BPM, straight, 16 steps, empty pattern, no sounds */
+void drum_seq_init(DrumSeq *s, double sample_rate);
+
+/* frees the sounds, once the audio thread is stopped */
+void drum_seq_free(DrumSeq *s);
+
+/* safe to call from the UI thread while the audio thread is running */
+int drum_seq_set(DrumSeq *s, DrumSeqParam param, double value);
+
+/* the sample the next step starts on, for the tools */
+int64_t drum_seq_next_onset(const DrumSeq *s);
+
+#endif
@@ -0,0 +1,130 @@
+#include "drumstream.h"
+
+#include <string.h>
+
+/* ===== events ===== */
+
+static void start_hit(DrumStream *s)
+{
+    int v = -1;
+
+    for (int i = 0; i < DRUM_STREAM_VOICES; i++)
+    {
+        if (!s->active[i])
+        {
+            v = i;
+            break;
+        }
+    }
+
+    /* all busy: the one that started first goes */
+    if (v < 0)
+    {
+        v = 0;
+        for (int i = 1; i < DRUM_STREAM_VOICES; i++)
+            if (s->hits - s->age[i] > s->hits - s->age[v])
+                v = i;
+    }
+
+    drum_voice_start(&s->voice[v], &s->next, s->sample_rate);
+    s->active[v] = 1;
+    s->age[v] = s->hits++;
+}
+
+static void apply_events(DrumStream *s)
+{
+    ParamMsg m;
+    DrumParams *p = &s->next;
+
+    while (paramq_pop(&s->events, &m))
+    {
+        switch (m.id)
+        {
+            case DRUM_FREQ1:     p->freq1 = (float)m.value; break;
+            case DRUM_FREQ2:     p->freq2 = (float)m.value; break;
+            case DRUM_MIX2:      p->mix2 = (float)m.value; break;
+            case DRUM_USE_FM:    p->use_fm = (int)m.value; break;
+            case DRUM_FM_AMOUNT: p->fm_amount = (float)m.value; break;
+            case DRUM_FM_K:      p->fm_k = (float)m.value; break;
+            case DRUM_USE_NOISE: p->use_noise = (int)m.value; break;
+            case DRUM_NOISE_AMT: p->noise_amt = (float)m.value; break;
+            case DRUM_SEED:      p->seed = (unsigned)m.value; break;
+            case DRUM_USE_ENV:   p->use_env = (int)m.value; break;
+            case DRUM_ENV_K:     p->env_k = (float)m.value; break;
+            case DRUM_LENGTH:    p->length = (int)m.value; break;
+            case DRUM_HIT:       start_hit(s); break;
+        }
+    }
+}
+
+int drum_stream_hit(DrumStream *s, const DrumParams *p)
+{
+    /* all of it or nothing, so a hit never starts with half the params of the last one */
+    if (paramq_space(&s->events) < DRUM_PARAMS) return -1;
+
+    /* every field fits a double exactly, so the voice gets the very same params */
+    paramq_push(&s->events, DRUM_FREQ1, p->freq1);
+    paramq_push(&s->events, DRUM_FREQ2, p->freq2);
+    paramq_push(&s->events, DRUM_MIX2, p->mix2);
+    paramq_push(&s->events, DRUM_USE_FM, p->use_fm);
+    paramq_push(&s->events, DRUM_FM_AMOUNT, p->fm_amount);
+    paramq_push(&s->events, DRUM_FM_K, p->fm_k);
+    paramq_push(&s->events, DRUM_USE_NOISE, p->use_noise);
+    paramq_push(&s->events, DRUM_NOISE_AMT, p->noise_amt);
+    paramq_push(&s->events, DRUM_SEED, p->seed);
+    paramq_push(&s->events, DRUM_USE_ENV, p->use_env);
+    paramq_push(&s->events, DRUM_ENV_K, p->env_k);
+    paramq_push(&s->events, DRUM_LENGTH, p->length);
+    paramq_push(&s->events, DRUM_HIT, 0);
+
+    return 0;
+}
+
+/* ===== process ===== */
+
+static void drum_stream_process(SynthState *st, float *out, int frames)
+{
+    DrumStream *s = (DrumStream *)st;
+    float chunk[DRUM_STREAM_CHUNK];
+
+    apply_events(s);
+
+    memset(out, 0, frames * sizeof(float));
+
+    for (int v = 0; v < DRUM_STREAM_VOICES; v++)
+    {
+        if (!s->active[v]) continue;
+
+        for (int done = 0; done < frames; )
+        {
+            int want = frames - done;
+            if (want > DRUM_STREAM_CHUNK) want = DRUM_STREAM_CHUNK;
+
+            int got = drum_voice_render(&s->voice[v], chunk, want);
+
+            /* same level as DrumSynth */
+            for (int i = 0; i < got; i++)
+                out[done + i] += chunk[i] * 0.8f;
+
+            done += got;
+
+            if (got < want)
+            {
+                s->active[v] = 0;
+                break;
+            }
+        }
+    }
+}
+
+void drum_stream_init(DrumStream *s, double sample_rate)
+{
+    memset(s, 0, sizeof(*s));
+
+    s->base.process = drum_stream_process;
+    s->sample_rate = sample_rate;
+
+    paramq_init(&s->events);
+
+    nco_init();
+}
@@ -0,0 +1,72 @@
+#ifndef DRUMSTREAM_H
+#define DRUMSTREAM_H
+
+#include "drum.h"
+#include "paramq.h"
+
+/*
+ * The drum synth without sample buffers: every hit is a DrumVoice that the
+ * audio callback renders as it plays, a block at a time.
+ *
+ * A hit starts at the beginning of the next block, with nothing rendered
+ * up front, so there's no synthesis delay between the trigger and the
+ * sound. A voice is a few dozen bytes whatever the length of the hit, so
+ * hits can be as long as you like (params.length isn't held to
+ * MAX_SAMPLES), and up to DRUM_STREAM_VOICES of them ring at once; a new
+ * hit when all are busy takes the place of the oldest one.
+ *
+ * The price is that the synthesis runs in the audio thread, every time,
+ * about as much per voice and sample as DrumSynth spends on rendering.
+ *
+ * A voice gives the same samples as generate_sample() for the same params
+ * (and seed), bit for bit, however the blocks are cut; synth_render's
+ * kick_stream etc. play the same script as kick etc., to check that with
+ * -c and -t 0.
+ *
+ * Hits come from another thread through drum_stream_hit(), by the
+ * parameter queue: one message per field of the params, then DRUM_HIT.
+ */
+
+#define DRUM_STREAM_VOICES 8
+#define DRUM_STREAM_CHUNK 256   /* samples per voice rendered at once */
+
+typedef enum
+{
+    DRUM_FREQ1,
+    DRUM_FREQ2,
+    DRUM_MIX2,
+    DRUM_USE_FM,
+    DRUM_FM_AMOUNT,
+    DRUM_FM_K,
+    DRUM_USE_NOISE,
+    DRUM_NOISE_AMT,
+    DRUM_SEED,
+    DRUM_USE_ENV,
+    DRUM_ENV_K,
+    DRUM_LENGTH,
+    DRUM_HIT,               /* starts a voice with the params sent so far */
+    DRUM_PARAMS
+} DrumParam;
+
+typedef struct
+{
+    SynthState base;
+
+    ParamQueue events;      /* hits from the UI thread */
+
+    /* audio thread */
+    DrumParams next;        /* the params of the next hit, as they come in */
+    DrumVoice voice[DRUM_STREAM_VOICES];
+    int active[DRUM_STREAM_VOICES];
+    unsigned age[DRUM_STREAM_VOICES];
+    unsigned hits;
+
+    double sample_rate;
+} DrumStream;
+
+void drum_stream_init(DrumStream *s, double sample_rate);
+
+/* a hit with params p, from the next block on; returns -1 when the queue is full */
+int drum_stream_hit(DrumStream *s, const DrumParams *p);
+
+#endif
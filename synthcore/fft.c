@@ -0,0 +1,92 @@
+#include "fft.h"
+
+#include <math.h>
+
+#define PI 3.14159265358979323846
+
+int fft_init(FftPlan *p, int bits)
+{
+    if (bits < 1 || bits > FFT_MAX_BITS) return -1;
+
+    p->bits = bits;
+    p->n = 1 << bits;
+
+    for (int k = 0; k < p->n / 2; k++)
+    {
+        p->tw_re[k] = (float)cos(2 * PI * k / p->n);
+        p->tw_im[k] = (float)-sin(2 * PI * k / p->n);
+    }
+
+    for (int i = 0; i < p->n; i++)
+    {
+        int r = 0;
+
+        for (int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+
+        p->rev[i] = (uint16_t)r;
+    }
+
+    return 0;
+}
+
+/* sign = 1 for the forward twiddles, -1 for their conjugates */
+static void transform(const FftPlan *p, float *re, float *im, float sign)
+{
+    int n = p->n;
+
+    for (int i = 0; i < n; i++)
+    {
+        int r = p->rev[i];
+
+        if (r > i)
+        {
+            float t = re[i]; re[i] = re[r]; re[r] = t;
+            t = im[i]; im[i] = im[r]; im[r] = t;
+        }
+    }
+
+    for (int len = 2; len <= n; len <<= 1)
+    {
+        int half = len / 2;
+        int step = n / len;
+
+        for (int start = 0; start < n; start += len)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                float wr = p->tw_re[k * step];
+                float wi = sign * p->tw_im[k * step];
+
+                int a = start + k;
+                int b = a + half;
+
+                float xr = re[b] * wr - im[b] * wi;
+                float xi = re[b] * wi + im[b] * wr;
+
+                re[b] = re[a] - xr;
+                im[b] = im[a] - xi;
+                re[a] += xr;
+                im[a] += xi;
+            }
+        }
+    }
+}
+
+void fft_forward(const FftPlan *p, float *re, float *im)
+{
+    transform(p, re, im, 1.0f);
+}
+
+void fft_inverse(const FftPlan *p, float *re, float *im)
+{
+    transform(p, re, im, -1.0f);
+
+    float scale = 1.0f / p->n;
+
+    for (int i = 0; i < p->n; i++)
+    {
+        re[i] *= scale;
+        im[i] *= scale;
+    }
+}
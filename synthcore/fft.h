@@ -0,0 +1,36 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+
+/*
+ * In-place complex FFT, radix 2, for power-of-two sizes up to FFT_MAX.
+ *
+ * The real and imaginary parts are two separate arrays. fft_init() works
+ * out the twiddle factors and the bit-reversed order once, so a transform
+ * is only the butterflies, no sin() / cos().
+ */
+
+#define FFT_MAX_BITS 12
+#define FFT_MAX (1 << FFT_MAX_BITS)
+
+typedef struct
+{
+    int bits;
+    int n;
+
+    float tw_re[FFT_MAX / 2];   /* cos(2 PI k / n) */
+    float tw_im[FFT_MAX / 2];   /* -sin(2 PI k / n) */
+    uint16_t rev[FFT_MAX];
+} FftPlan;
+
+/* n = 2^bits, returns -1 when bits is out of range */
+int fft_init(FftPlan *p, int bits);
+
+/* X[k] = sum x[n] e^(-2 PI i k n / N) */
+void fft_forward(const FftPlan *p, float *re, float *im);
+
+/* x[n] = 1/N sum X[k] e^(2 PI i k n / N), undoes fft_forward() */
+void fft_inverse(const FftPlan *p, float *re, float *im);
+
+#endif
@@ -0,0 +1,132 @@
+#include "filter.h"
+
+#include <math.h>
+
+#define PI 3.14159265359
+
+/* ===== state-variable filter ===== */
+
+/* same loop for every type, only the output tap differs */
+#define SVF_KERNEL(name, out)                                           \
+    static void name(SvfFilter *f, float c, float *buf, int frames)     \
+    {                                                                   \
+        float r = f->res;                                               \
+        float z1 = f->z1, z2 = f->z2;                                   \
+                                                                        \
+        for (int i = 0; i < frames; i++)                                \
+        {                                                               \
+            float x = buf[i];                                           \
+            z1 += c * (x - z1 + r * (z1 - z2));                         \
+            z2 += c * (z1 - z2);                                        \
+            buf[i] = (out);                                             \
+        }                                                               \
+                                                                        \
+        f->z1 = z1;                                                     \
+        f->z2 = z2;                                                     \
+    }
+
+SVF_KERNEL(svf_lpf,   z2)
+SVF_KERNEL(svf_hpf,   x - z2)
+SVF_KERNEL(svf_bpf,   z1 - z2)
+SVF_KERNEL(svf_notch, x - (z1 - z2))
+
+typedef void (*SvfKernel)(SvfFilter *f, float c, float *buf, int frames);
+
+static const SvfKernel svf_kernels[FILTER_TYPES] =
+{
+    [FILTER_LPF]   = svf_lpf,
+    [FILTER_HPF]   = svf_hpf,
+    [FILTER_BPF]   = svf_bpf,
+    [FILTER_NOTCH] = svf_notch,
+};
+
+void svf_process_block(SvfFilter *f, float *buf, int frames, double sample_rate)
+{
+    float c = 2 * sinf(PI * f->cutoff / sample_rate);
+
+    svf_kernels[f->type](f, c, buf, frames);
+}
+
+/* ===== biquad ===== */
+
+void biquad_update(BiquadFilter *f, double sample_rate)
+{
+    if (f->cutoff < 20) f->cutoff = 20;
+    if (f->cutoff > sample_rate / 2 - 100)
+        f->cutoff = sample_rate / 2 - 100;
+
+    float w0 = 2.0f * PI * f->cutoff / sample_rate;
+    float cosw = cosf(w0);
+    float sinw = sinf(w0);
+
+    if (f->res < 0.05f) f->res = 0.05f;
+
+    float alpha = sinw / (2.0f * f->res);
+
+    float b0 = 1, b1 = 0, b2 = 0;
+    float a0 = 1 + alpha;
+    float a1 = -2 * cosw;
+    float a2 = 1 - alpha;
+
+    switch (f->type)
+    {
+        case FILTER_LPF:
+            b0 = (1 - cosw) / 2;
+            b1 = 1 - cosw;
+            b2 = (1 - cosw) / 2;
+            break;
+
+        case FILTER_HPF:
+            b0 = (1 + cosw) / 2;
+            b1 = -(1 + cosw);
+            b2 = (1 + cosw) / 2;
+            break;
+
+        case FILTER_BPF:
+            b0 = alpha;
+            b1 = 0;
+            b2 = -alpha;
+            break;
+
+        case FILTER_NOTCH:
+            b0 = 1;
+            b1 = -2 * cosw;
+            b2 = 1;
+            break;
+
+        default:
+            break;
+    }
+
+    f->b0 = b0 / a0;
+    f->b1 = b1 / a0;
+    f->b2 = b2 / a0;
+    f->a1 = a1 / a0;
+    f->a2 = a2 / a0;
+}
+
+void biquad_process_block(BiquadFilter *f, float *buf, int frames)
+{
+    float b0 = f->b0, b1 = f->b1, b2 = f->b2;
+    float a1 = f->a1, a2 = f->a2;
+    float x1 = f->x1, x2 = f->x2;
+    float y1 = f->y1, y2 = f->y2;
+
+    for (int i = 0; i < frames; i++)
+    {
+        float x = buf[i];
+        float y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+
+        buf[i] = y;
+    }
+
+    f->x1 = x1;
+    f->x2 = x2;
+    f->y1 = y1;
+    f->y2 = y2;
+}
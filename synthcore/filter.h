@@ -0,0 +1,54 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+/*
+ * The two filters from the subtractive synth, working on whole blocks.
+ *
+ * SvfFilter is the simple state-variable style filter from
+ * subtractive_synth.c, BiquadFilter the RBJ biquad from
+ * true_subtractive_synth.c. The filter type is resolved once per block:
+ * the SVF picks one of its per-type kernels, the biquad has it baked
+ * into the coefficients by biquad_update().
+ */
+
+typedef enum
+{
+    FILTER_LPF,
+    FILTER_HPF,
+    FILTER_BPF,
+    FILTER_NOTCH,
+    FILTER_TYPES
+} FilterType;
+
+typedef struct
+{
+    FilterType type;
+    float cutoff;
+    float res;
+    float z1, z2;
+} SvfFilter;
+
+typedef struct
+{
+    FilterType type;
+
+    float cutoff;
+    float res;
+
+    float b0, b1, b2;
+    float a1, a2;
+
+    float x1, x2;
+    float y1, y2;
+} BiquadFilter;
+
+/* filters buf[0..frames) in place */
+void svf_process_block(SvfFilter *f, float *buf, int frames, double sample_rate);
+
+/* clamps cutoff / res and recomputes the coefficients, call after any change */
+void biquad_update(BiquadFilter *f, double sample_rate);
+
+/* filters buf[0..frames) in place */
+void biquad_process_block(BiquadFilter *f, float *buf, int frames);
+
+#endif
@@ -0,0 +1,451 @@
+#include "fm.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "nco.h"
+
+/* voices side by side, one per lane, the whole FM_VOICES in one or two vectors */
+#ifdef __AVX__
+#define LANES 8
+#else
+#define LANES 4
+#endif
+
+#if FM_VOICES % LANES
+#error "FM_VOICES has to be a multiple of the vector width"
+#endif
+
+typedef float vf __attribute__((vector_size(LANES * 4)));
+typedef int32_t vi __attribute__((vector_size(LANES * 4)));
+typedef uint32_t vu __attribute__((vector_size(LANES * 4)));
+
+/* the mix of all voices, divided by the carriers */
+#define FM_GAIN 0.3f
+
+/* phase shift of the feedback at 1, in cycles (half a cycle, PI, like the DX7's top setting) */
+#define FEEDBACK_DEPTH 0.5f
+
+/*
+ * Who modulates whom: mod[op] has a bit for every operator that shifts the
+ * phase of op, always higher ones, so working them out from the top down
+ * has every input ready in time.
+ */
+typedef struct
+{
+    uint8_t mod[FM_OPS];
+    uint8_t carriers;
+    int feedback;       /* the operator that modulates itself */
+} FmGraph;
+
+static const FmGraph graphs[FM_ALGORITHMS] =
+{
+    [FM_STACK]        = {{1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 0}, 1 << 0, 5},
+    [FM_TWO_STACKS]   = {{1 << 1, 1 << 2, 0, 1 << 4, 1 << 5, 0}, 1 << 0 | 1 << 3, 5},
+    [FM_THREE_PAIRS]  = {{1 << 1, 0, 1 << 3, 0, 1 << 5, 0}, 1 << 0 | 1 << 2 | 1 << 4, 5},
+    [FM_BRANCH]       = {{1 << 1 | 1 << 2 | 1 << 3, 0, 0, 0, 1 << 5, 0}, 1 << 0 | 1 << 4, 5},
+    [FM_ONE_TO_THREE] = {{1 << 1, 0, 1 << 5, 1 << 5, 1 << 5, 0}, 1 << 0 | 1 << 2 | 1 << 3 | 1 << 4, 5},
+    [FM_ORGAN]        = {{0, 0, 0, 0, 0, 0}, 0x3f, 5},
+};
+
+static inline vu load_u(const uint32_t *p)
+{
+    vu v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline vf load_f(const float *p)
+{
+    vf v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store_u(uint32_t *p, vu v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void store_f(float *p, vf v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline vf vabs(vf x)
+{
+    return (vf)((vu)x & 0x7fffffffu);
+}
+
+/* sin(2 PI phase), the polynomial of oscbank.c, error below 1e-6 */
+static inline vf vsin(vu p)
+{
+    vf x = __builtin_convertvector((vi)p, vf) * (1.0f / 2147483648.0f);
+    vu sign = (vu)x & 0x80000000u;
+
+    vf a = 0.5f - vabs(0.5f - vabs(x));
+    vf a2 = a * a;
+
+    vf s = a * (3.14159265f + a2 * (-5.16771278f + a2 * (2.55016404f +
+           a2 * (-0.59926453f + a2 * (0.08214589f + a2 * -0.00737043f)))));
+
+    return (vf)((vu)s | sign);
+}
+
+/*
+ * A modulation (in levels) as a phase offset. Six operators and feedback
+ * stay well inside +-128 cycles, so 24 bits of fraction fit in an int32;
+ * the shift then drops the whole cycles.
+ */
+static inline vu phase_shift(vf mod)
+{
+    vi fixed = __builtin_convertvector(mod * (FM_DEPTH * 16777216.0f), vi);
+    return (vu)fixed << 8;
+}
+
+/* ===== kernels ===== */
+
+/*
+ * Adds frames samples of voices from .. from + LANES - 1 to out, with graph
+ * g. It's inlined once per algorithm with g a constant, so the loops over
+ * the operators unroll and the graph turns into straight code.
+ */
+static inline __attribute__((always_inline)) void render_lanes(FmSynth *f, float *out, int frames, int from,
+                                                               const FmGraph *g)
+{
+    vu phase[FM_OPS], inc[FM_OPS];
+    vf level[FM_OPS], step[FM_OPS], o[FM_OPS];
+
+    int carriers = __builtin_popcount(g->carriers);
+    float gain = FM_GAIN / carriers;
+    float fb_scale = 0.5f * f->feedback * FEEDBACK_DEPTH / FM_DEPTH;
+
+    for (int op = 0; op < FM_OPS; op++)
+    {
+        phase[op] = load_u(&f->phase[op][from]);
+        inc[op] = load_u(&f->inc[op][from]);
+        level[op] = load_f(&f->level[op][from]);
+        step[op] = load_f(&f->level_step[op][from]);
+        o[op] = (vf){0};
+    }
+
+    vf fb0 = load_f(&f->fb[0][from]);
+    vf fb1 = load_f(&f->fb[1][from]);
+
+    for (int i = 0; i < frames; i++)
+    {
+        vf mix = {0};
+
+#pragma GCC unroll 6
+        for (int op = FM_OPS - 1; op >= 0; op--)
+        {
+            vf mod = {0};
+
+#pragma GCC unroll 6
+            for (int m = op + 1; m < FM_OPS; m++)
+                if (g->mod[op] >> m & 1) mod += o[m];
+
+            if (op == g->feedback)
+                mod += (fb0 + fb1) * fb_scale;
+
+            o[op] = vsin(phase[op] + phase_shift(mod)) * level[op];
+
+            if (g->carriers >> op & 1)
+                mix += o[op];
+
+            phase[op] += inc[op];
+            level[op] += step[op];
+        }
+
+        fb1 = fb0;
+        fb0 = o[g->feedback];
+
+        float sum = 0;
+        for (int v = 0; v < LANES; v++)
+            sum += mix[v];
+
+        out[i] += sum * gain;
+    }
+
+    for (int op = 0; op < FM_OPS; op++)
+    {
+        store_u(&f->phase[op][from], phase[op]);
+        store_f(&f->level[op][from], level[op]);
+    }
+
+    store_f(&f->fb[0][from], fb0);
+    store_f(&f->fb[1][from], fb1);
+}
+
+static inline __attribute__((always_inline)) void render(FmSynth *f, float *out, int frames, const FmGraph *g)
+{
+    for (int from = 0; from < FM_VOICES; from += LANES)
+        render_lanes(f, out, frames, from, g);
+}
+
+static void render_stack(FmSynth *f, float *out, int n)       { render(f, out, n, &graphs[FM_STACK]); }
+static void render_two_stacks(FmSynth *f, float *out, int n)  { render(f, out, n, &graphs[FM_TWO_STACKS]); }
+static void render_three_pairs(FmSynth *f, float *out, int n) { render(f, out, n, &graphs[FM_THREE_PAIRS]); }
+static void render_branch(FmSynth *f, float *out, int n)      { render(f, out, n, &graphs[FM_BRANCH]); }
+static void render_one_to_three(FmSynth *f, float *out, int n){ render(f, out, n, &graphs[FM_ONE_TO_THREE]); }
+static void render_organ(FmSynth *f, float *out, int n)       { render(f, out, n, &graphs[FM_ORGAN]); }
+
+static void (*const kernels[FM_ALGORITHMS])(FmSynth *, float *, int) =
+{
+    render_stack, render_two_stacks, render_three_pairs, render_branch, render_one_to_three, render_organ,
+};
+
+/* ===== envelopes ===== */
+
+/* how much is left of a fall after one control period, for a time constant of t seconds */
+static float fall(float t, double sample_rate)
+{
+    return t > 0 ? expf((float)(-FM_CONTROL / (t * sample_rate))) : 0;
+}
+
+/*
+ * At a control point: moves every envelope on by one period, sets the
+ * levels to ramp there, and frees the voices that have died away. The
+ * increments are redone here too, so a ratio change is heard within a
+ * period.
+ */
+static void control(FmSynth *f)
+{
+    for (int op = 0; op < FM_OPS; op++)
+    {
+        const FmOperator *o = &f->op[op];
+        float rise = o->attack > 0 ? (float)(FM_CONTROL / (o->attack * f->sample_rate)) : 1;
+        float decay = fall(o->decay, f->sample_rate);
+        float release = fall(o->release, f->sample_rate);
+
+        for (int v = 0; v < FM_VOICES; v++)
+        {
+            float env = f->env[op][v];
+
+            switch (f->stage[op][v])
+            {
+                case FM_OFF:     env = 0; break;
+                case FM_ATTACK:  env += rise; break;
+                case FM_DECAY:   env = o->sustain + (env - o->sustain) * decay; break;
+                case FM_RELEASE: env *= release; break;
+            }
+
+            if (f->stage[op][v] == FM_ATTACK && env >= 1)
+            {
+                env = 1;
+                f->stage[op][v] = FM_DECAY;
+            }
+
+            /* start the ramp where the last one should have ended, no drift */
+            f->level[op][v] = o->level * f->env[op][v];
+            f->level_step[op][v] = (o->level * env - f->level[op][v]) / FM_CONTROL;
+            f->env[op][v] = env;
+
+            if (f->active[v])
+                f->inc[op][v] = nco_increment(f->freq[v] * o->ratio, f->sample_rate);
+        }
+    }
+
+    for (int v = 0; v < FM_VOICES; v++)
+    {
+        int done = f->active[v];
+
+        for (int op = 0; op < FM_OPS && done; op++)
+            done = f->stage[op][v] == FM_RELEASE && f->env[op][v] < FM_SILENT;
+
+        if (!done) continue;
+
+        f->active[v] = 0;
+
+        for (int op = 0; op < FM_OPS; op++)
+        {
+            f->stage[op][v] = FM_OFF;
+            f->env[op][v] = f->level[op][v] = f->level_step[op][v] = 0;
+        }
+    }
+}
+
+/* ===== notes ===== */
+
+static int find_voice(FmSynth *f, int key)
+{
+    for (int v = 0; v < FM_VOICES; v++)
+        if (f->active[v] && f->key[v] == key) return v;
+    return -1;
+}
+
+/* a free voice, else the oldest note */
+static int alloc_voice(FmSynth *f)
+{
+    int oldest = 0;
+
+    for (int v = 0; v < FM_VOICES; v++)
+    {
+        if (!f->active[v]) return v;
+        if (f->age[v] < f->age[oldest]) oldest = v;
+    }
+
+    return oldest;
+}
+
+static void start_note(FmSynth *f, int key, float freq)
+{
+    int v = find_voice(f, key);
+    if (v < 0) v = alloc_voice(f);
+
+    /*
+     * A silent voice starts every operator at phase 0, so a note sounds the
+     * same every time. One still sounding (the same key again, or the oldest
+     * note taken over) keeps its phases and feedback: the envelopes pick up
+     * from where they are, and jumping the sines back to 0 would click.
+     */
+    if (!f->active[v])
+    {
+        f->fb[0][v] = f->fb[1][v] = 0;
+
+        for (int op = 0; op < FM_OPS; op++)
+            f->phase[op][v] = 0;
+    }
+
+    f->key[v] = key;
+    f->freq[v] = freq;
+    f->active[v] = 1;
+    f->age[v] = ++f->notes;
+
+    for (int op = 0; op < FM_OPS; op++)
+    {
+        f->inc[op][v] = nco_increment(freq * f->op[op].ratio, f->sample_rate);
+        f->stage[op][v] = FM_ATTACK;
+    }
+}
+
+static void stop_note(FmSynth *f, int key)
+{
+    int v = find_voice(f, key);
+    if (v < 0) return;
+
+    for (int op = 0; op < FM_OPS; op++)
+        f->stage[op][v] = FM_RELEASE;
+}
+
+/* a message is key << 1 | on, and the frequency */
+static void apply_events(FmSynth *f)
+{
+    ParamMsg m;
+
+    while (paramq_pop(&f->events, &m))
+    {
+        int key = (int)((unsigned)m.id >> 1);
+
+        if (m.id & 1)
+            start_note(f, key, (float)m.value);
+        else
+            stop_note(f, key);
+    }
+}
+
+static void apply_params(FmSynth *f)
+{
+    ParamMsg m;
+
+    while (paramq_pop(&f->params, &m))
+    {
+        switch (m.id)
+        {
+            case FM_ALGORITHM:
+                if (m.value >= 0 && m.value < FM_ALGORITHMS) f->algorithm = (FmAlgorithm)m.value;
+                break;
+            case FM_FEEDBACK:
+                f->feedback = m.value < 0 ? 0 : m.value > 1 ? 1 : (float)m.value;
+                break;
+            default: break;
+        }
+    }
+}
+
+int fm_note_on(FmSynth *f, int key, float freq)
+{
+    return paramq_push(&f->events, (int)((unsigned)key << 1 | 1), freq);
+}
+
+int fm_note_off(FmSynth *f, int key)
+{
+    return paramq_push(&f->events, (int)((unsigned)key << 1), 0);
+}
+
+int fm_set(FmSynth *f, FmParam param, double value)
+{
+    return paramq_push(&f->params, param, value);
+}
+
+/* ===== process ===== */
+
+static void fm_process(SynthState *s, float *out, int frames)
+{
+    FmSynth *f = (FmSynth *)s;
+    int any = 0;
+
+    apply_params(f);
+    apply_events(f);
+
+    for (int v = 0; v < FM_VOICES; v++)
+        any |= f->active[v];
+
+    memset(out, 0, frames * sizeof(float));
+
+    if (!any)
+    {
+        f->into = 0;
+        atomic_store_explicit(&f->playing, 0, memory_order_relaxed);
+        return;
+    }
+
+    void (*kernel)(FmSynth *, float *, int) = kernels[f->algorithm];
+
+    for (int pos = 0; pos < frames; )
+    {
+        if (f->into == 0)
+            control(f);
+
+        int n = FM_CONTROL - f->into;
+        if (n > frames - pos) n = frames - pos;
+
+        kernel(f, out + pos, n);
+
+        f->into = (f->into + n) % FM_CONTROL;
+        pos += n;
+    }
+
+    int playing = 0;
+
+    for (int v = 0; v < FM_VOICES; v++)
+        playing += f->active[v];
+
+    atomic_store_explicit(&f->playing, playing, memory_order_relaxed);
+}
+
+void fm_init(FmSynth *f, double sample_rate)
+{
+    static const FmOperator piano[FM_OPS] =
+    {
+        /* ratio level attack decay sustain release */
+        {1.0f,  0.8f, 0.002f, 1.5f, 0.0f, 0.3f},
+        {14.0f, 0.2f, 0.001f, 0.2f, 0.0f, 0.2f},
+        {1.0f,  0.6f, 0.002f, 1.0f, 0.3f, 0.3f},
+        {1.0f,  0.8f, 0.002f, 2.0f, 0.2f, 0.4f},
+        {1.0f,  0.3f, 0.002f, 1.0f, 0.2f, 0.3f},
+        {1.0f,  0.2f, 0.002f, 0.8f, 0.0f, 0.3f},
+    };
+
+    memset(f, 0, sizeof(*f));
+
+    f->base.process = fm_process;
+    f->algorithm = FM_TWO_STACKS;
+    f->feedback = 0.3f;
+    memcpy(f->op, piano, sizeof(piano));
+    f->sample_rate = sample_rate;
+
+    paramq_init(&f->events);
+    paramq_init(&f->params);
+    atomic_init(&f->playing, 0);
+}
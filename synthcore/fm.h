@@ -0,0 +1,123 @@
+#ifndef FM_H
+#define FM_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "paramq.h"
+#include "synth.h"
+
+/*
+ * The FM synth: FM_VOICES voices of FM_OPS sine operators each, DX style.
+ *
+ * An operator is an oscillator like the ones of the additive synth, a
+ * frequency (here a ratio to the note) and an amplitude with an envelope,
+ * except that its output doesn't have to go to the mix: the algorithm says
+ * which operators are heard (the carriers) and which shift the phase of
+ * others (the modulators). A modulator at full level shifts it by up to
+ * FM_DEPTH cycles, and one operator of every algorithm also modulates
+ * itself (feedback), with the mean of its last two outputs.
+ *
+ * The voices are the lanes of a vector: every instruction works out the
+ * same operator for 4 voices at once (8 with AVX), with a polynomial sine
+ * (no sin(), no table). Each algorithm has a kernel of its own, so the
+ * graph is fixed at compile time and costs no branches per sample. Silent
+ * voices ride along in their lanes, so the cost doesn't depend on how many
+ * notes are playing, only on whether any is.
+ *
+ * The envelopes (attack, decay to sustain, release) are worked out every
+ * FM_CONTROL samples and the levels ramp in a straight line in between.
+ *
+ * Notes come from another thread through fm_note_on() / fm_note_off(), by
+ * the lock-free parameter queue, and so do algorithm and feedback, with
+ * fm_set(). op[] is read at the start of every block; change it between
+ * blocks. A note that takes a voice still sounding carries on from the
+ * phases the operators are at, so it doesn't click.
+ */
+
+#define FM_OPS 6
+#define FM_VOICES 8         /* one AVX vector of voices, or two SSE ones */
+#define FM_CONTROL 32       /* samples between envelope points */
+#define FM_DEPTH 2.0f       /* phase shift of a modulator at full level, in cycles */
+
+/* a released voice quieter than this (-80 dB) is free again */
+#define FM_SILENT 1e-4f
+
+/* operator 0 is "operator 1" of the README, arrows point from modulator to carrier */
+typedef enum
+{
+    FM_STACK,           /* 6 > 5 > 4 > 3 > 2 > 1 */
+    FM_TWO_STACKS,      /* 3 > 2 > 1, 6 > 5 > 4 */
+    FM_THREE_PAIRS,     /* 2 > 1, 4 > 3, 6 > 5 */
+    FM_BRANCH,          /* 2, 3 and 4 > 1, 6 > 5 */
+    FM_ONE_TO_THREE,    /* 2 > 1, 6 > 3, 4 and 5 */
+    FM_ORGAN,           /* six carriers */
+    FM_ALGORITHMS
+} FmAlgorithm;
+
+typedef struct
+{
+    float ratio;        /* frequency = note * ratio */
+    float level;        /* 0..1 */
+    float attack;       /* seconds to full level */
+    float decay;        /* seconds, time constant down to sustain */
+    float sustain;      /* 0..1 of level */
+    float release;      /* seconds, time constant after note off */
+} FmOperator;
+
+typedef enum
+{
+    FM_ALGORITHM,
+    FM_FEEDBACK
+} FmParam;
+
+typedef enum
+{
+    FM_OFF,
+    FM_ATTACK,
+    FM_DECAY,
+    FM_RELEASE
+} FmStage;
+
+typedef struct
+{
+    SynthState base;
+
+    FmAlgorithm algorithm;
+    float feedback;                         /* 0..1 */
+    FmOperator op[FM_OPS];
+
+    ParamQueue events;                      /* notes from the UI thread */
+    ParamQueue params;                      /* algorithm and feedback from the UI thread */
+    atomic_int playing;                     /* voices sounding after the last block, for the UI */
+
+    /* audio thread, by operator and voice */
+    uint32_t phase[FM_OPS][FM_VOICES];
+    uint32_t inc[FM_OPS][FM_VOICES];
+    float level[FM_OPS][FM_VOICES];         /* now, ramping */
+    float level_step[FM_OPS][FM_VOICES];
+    float env[FM_OPS][FM_VOICES];           /* at the last control point */
+    FmStage stage[FM_OPS][FM_VOICES];
+    float fb[2][FM_VOICES];                 /* last two outputs of the feedback operator */
+
+    int key[FM_VOICES];
+    float freq[FM_VOICES];
+    int active[FM_VOICES];
+    unsigned age[FM_VOICES];                /* when the note started, to steal the oldest */
+    unsigned notes;
+
+    int into;                               /* samples into the control period */
+    double sample_rate;
+} FmSynth;
+
+/* an electric piano-ish patch on FM_TWO_STACKS */
+void fm_init(FmSynth *f, double sample_rate);
+
+/* key is whatever the caller uses to tell notes apart; both return -1 when the queue is full */
+int fm_note_on(FmSynth *f, int key, float freq);
+int fm_note_off(FmSynth *f, int key);
+
+/* safe to call from the UI thread while the audio thread is running */
+int fm_set(FmSynth *f, FmParam param, double value);
+
+#endif
@@ -0,0 +1,173 @@
+#include "ifftbank.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nco.h"
+
+#define PI 3.14159265358979323846
+
+#define HOP IFFTBANK_HOP
+#define SIZE IFFTBANK_SIZE
+#define QUARTER 0x40000000u
+
+/* steps per bin of the kernel table, which covers -LOBE .. LOBE + 1 bins (0 past LOBE) */
+#define KERNEL_STEPS 64
+#define KERNEL_BINS (2 * IFFTBANK_LOBE + 1)
+#define KERNEL_SIZE ((KERNEL_BINS + 1) * KERNEL_STEPS + 1)
+
+static FftPlan plan;
+static int tables_ready;
+
+/* spectrum of the window around a sine, by distance from its frequency in bins */
+static float kernel[KERNEL_SIZE];
+
+/* triangle / window over the middle half of the frame */
+static float synthesis[2 * HOP];
+
+/* 4-term Blackman-Harris, sidelobes below -92 dB */
+static double window(int n)
+{
+    double x = 2 * PI * n / SIZE;
+    return 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x);
+}
+
+static void init_tables()
+{
+    fft_init(&plan, IFFTBANK_BITS);
+
+    /* the window is symmetric around SIZE / 2, so its spectrum there is real */
+    for (int i = 0; i < KERNEL_SIZE; i++)
+    {
+        double d = (double)i / KERNEL_STEPS - IFFTBANK_LOBE;
+        double sum = 0;
+
+        if (d > IFFTBANK_LOBE) continue;
+
+        for (int m = -SIZE / 2; m < SIZE / 2; m++)
+            sum += window(SIZE / 2 + m) * cos(2 * PI * d * m / SIZE);
+
+        kernel[i] = (float)sum;
+    }
+
+    for (int n = 0; n < 2 * HOP; n++)
+    {
+        double tri = 1.0 - abs(n - HOP) / (double)HOP;
+        synthesis[n] = (float)(tri / window(HOP + n));
+    }
+
+    tables_ready = 1;
+}
+
+void ifftbank_init(IfftBank *b)
+{
+    if (!tables_ready)
+        init_tables();
+
+    b->count = 0;
+    ifftbank_reset(b);
+}
+
+void ifftbank_reset(IfftBank *b)
+{
+    memset(b->ola, 0, sizeof(b->ola));
+    b->pos = HOP;
+    b->primed = 0;
+}
+
+/* windows the middle half of the frame centred `center` samples into this render call */
+static void build_frame(IfftBank *b, int center)
+{
+    memset(b->re, 0, sizeof(b->re));
+    memset(b->im, 0, sizeof(b->im));
+
+    for (int k = 0; k < b->count; k++)
+    {
+        if (b->amp[k] == 0) continue;
+
+        /* the real part of the IFFT is amp * cos(phase - 90 degrees), the oscillators' sine */
+        uint32_t ph = b->phase[k] + b->inc[k] * (uint32_t)center;
+        float c = b->amp[k] * nco_sin(ph);
+        float s = -b->amp[k] * nco_sin(ph + QUARTER);
+
+        float bin = b->inc[k] * (float)(SIZE / NCO_ONE);
+        int first = (int)ceilf(bin - IFFTBANK_LOBE);
+
+        /* the bins are whole steps apart, so they all share the same fraction */
+        float x = (first - bin + IFFTBANK_LOBE) * KERNEL_STEPS;
+        int i = (int)x;
+        float frac = x - i;
+
+        /* the frame is centred at SIZE / 2, which turns every odd bin around */
+        if (first & 1)
+        {
+            c = -c;
+            s = -s;
+        }
+
+        for (int j = 0; j < KERNEL_BINS; j++, i += KERNEL_STEPS)
+        {
+            float r = kernel[i] + frac * (kernel[i + 1] - kernel[i]);
+            int idx = (first + j) & (SIZE - 1);
+
+            b->re[idx] += r * c;
+            b->im[idx] += r * s;
+
+            c = -c;
+            s = -s;
+        }
+    }
+
+    fft_inverse(&plan, b->re, b->im);
+
+    for (int n = 0; n < 2 * HOP; n++)
+        b->frame[n] = b->re[HOP + n] * synthesis[n];
+}
+
+/* the hop starting `offset` samples into this render call */
+static void next_hop(IfftBank *b, int offset)
+{
+    if (b->primed)
+    {
+        memmove(b->ola, b->ola + HOP, HOP * sizeof(float));
+    }
+    else
+    {
+        /* nothing overlaps the first hop yet, the frame before it fills in */
+        build_frame(b, offset);
+        memcpy(b->ola, b->frame + HOP, HOP * sizeof(float));
+        b->primed = 1;
+    }
+
+    memset(b->ola + HOP, 0, HOP * sizeof(float));
+
+    build_frame(b, offset + HOP);
+
+    for (int n = 0; n < 2 * HOP; n++)
+        b->ola[n] += b->frame[n];
+
+    b->pos = 0;
+}
+
+void ifftbank_render(IfftBank *b, float *out, int frames)
+{
+    int done = 0;
+
+    while (done < frames)
+    {
+        if (b->pos == HOP)
+            next_hop(b, done);
+
+        int n = frames - done < HOP - b->pos ? frames - done : HOP - b->pos;
+
+        for (int i = 0; i < n; i++)
+            out[done + i] += b->ola[b->pos + i];
+
+        b->pos += n;
+        done += n;
+    }
+
+    for (int k = 0; k < b->count; k++)
+        b->phase[k] += b->inc[k] * (uint32_t)frames;
+}
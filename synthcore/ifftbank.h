@@ -0,0 +1,63 @@
+#ifndef IFFTBANK_H
+#define IFFTBANK_H
+
+#include <stdint.h>
+
+#include "fft.h"
+#include "oscbank.h"
+
+/*
+ * Sine partials by inverse FFT and overlap-add (the "FFT-1" method).
+ *
+ * Instead of computing every partial at every sample, each partial is
+ * written into a short spectrum once per hop: a few bins around its
+ * frequency, shaped like the spectrum of a Blackman-Harris window, with
+ * its phase at the middle of the frame. One inverse FFT turns the whole
+ * spectrum into a frame of windowed sines. The window is divided out again
+ * and the middle half of every frame is crossfaded (triangles) with the
+ * next, IFFTBANK_HOP samples apart.
+ *
+ * A partial costs 2 * IFFTBANK_LOBE + 1 bins per hop instead of
+ * IFFTBANK_HOP samples, and the FFT costs the same however many partials
+ * there are, so with enough partials this beats any oscillator loop. The
+ * price: frequencies and amplitudes only change once per hop, with a
+ * crossfade, and there's a hop of latency before a new partial sounds.
+ *
+ * The partials are arrays like in OscBank. The phase of a partial is its
+ * phase at the first sample of the next render call, and render advances it
+ * by the number of frames, just like an oscillator, so a partial can move
+ * between this and the oscillators without a jump.
+ */
+
+#define IFFTBANK_BITS 9
+#define IFFTBANK_SIZE (1 << IFFTBANK_BITS)  /* 512 samples, 86 Hz per bin at 44.1 kHz */
+#define IFFTBANK_HOP (IFFTBANK_SIZE / 4)
+#define IFFTBANK_LOBE 4                     /* bins each side, the whole main lobe of the window */
+
+typedef struct
+{
+    uint32_t phase[OSCBANK_MAX];
+    uint32_t inc[OSCBANK_MAX];
+    float amp[OSCBANK_MAX];
+    int owner[OSCBANK_MAX];
+    int count;
+
+    float re[IFFTBANK_SIZE];
+    float im[IFFTBANK_SIZE];
+    float frame[2 * IFFTBANK_HOP];
+
+    float ola[2 * IFFTBANK_HOP];    /* the next two hops of output */
+    int pos;                        /* samples of the first hop already played */
+    int primed;
+} IfftBank;
+
+/* sets up the shared tables the first time, and empties the overlap */
+void ifftbank_init(IfftBank *b);
+
+/* forgets the overlap, the next render starts from scratch */
+void ifftbank_reset(IfftBank *b);
+
+/* adds the partials to out[0..frames) and advances their phases */
+void ifftbank_render(IfftBank *b, float *out, int frames);
+
+#endif
@@ -0,0 +1,13 @@
+#include "nco.h"
+
+#include <math.h>
+
+#define PI 3.14159265359
+
+float nco_sine_table[NCO_SINE_SIZE + 1];
+
+void nco_init()
+{
+    for (int i = 0; i <= NCO_SINE_SIZE; i++)
+        nco_sine_table[i] = (float)sin(2 * PI * i / NCO_SINE_SIZE);
+}
@@ -0,0 +1,74 @@
+#ifndef NCO_H
+#define NCO_H
+
+#include <stdint.h>
+
+/*
+ * Numerically controlled oscillator: a 32-bit phase accumulator.
+ *
+ * One full cycle is 2^32, so wrapping around is just unsigned overflow and
+ * there's no fmod() or "if (phase > 2 PI) phase -= 2 PI" anywhere.
+ *
+ * The frequency is quantised once, to sample_rate / 2^32 (about 0.00001 Hz
+ * at 44.1 kHz), when the increment is computed. After that the accumulator
+ * is pure integer addition, so nothing rounds or drifts: after n samples the
+ * phase is exactly n * inc mod 2^32, whether that's one second or a day.
+ *
+ * The top bits of the phase can index a power-of-two table directly.
+ */
+
+#define NCO_ONE 4294967296.0    /* one cycle */
+
+#define NCO_SINE_BITS 12
+#define NCO_SINE_SIZE (1 << NCO_SINE_BITS)
+
+typedef struct
+{
+    uint32_t phase;
+    uint32_t inc;
+} Nco;
+
+extern float nco_sine_table[NCO_SINE_SIZE + 1];
+
+/* fills nco_sine_table, call once at startup */
+void nco_init();
+
+/* negative frequencies wrap to a negative increment and run backwards */
+static inline uint32_t nco_increment(double freq, double sample_rate)
+{
+    double inc = freq / sample_rate * NCO_ONE;
+    return (uint32_t)(int64_t)(inc < 0 ? inc - 0.5 : inc + 0.5);
+}
+
+static inline void nco_set_freq(Nco *o, double freq, double sample_rate)
+{
+    o->inc = nco_increment(freq, sample_rate);
+}
+
+/* phase in cycles, 0..1 */
+static inline double nco_phase(const Nco *o)
+{
+    return o->phase * (1.0 / NCO_ONE);
+}
+
+/* increment in cycles per sample */
+static inline double nco_dt(const Nco *o)
+{
+    return o->inc * (1.0 / NCO_ONE);
+}
+
+static inline void nco_advance(Nco *o)
+{
+    o->phase += o->inc;
+}
+
+/* sin(2 PI phase), top bits pick the table entry, the rest interpolate */
+static inline float nco_sin(uint32_t phase)
+{
+    uint32_t i = phase >> (32 - NCO_SINE_BITS);
+    float frac = (phase << NCO_SINE_BITS) * (1.0f / 4294967296.0f);
+
+    return nco_sine_table[i] + frac * (nco_sine_table[i + 1] - nco_sine_table[i]);
+}
+
+#endif
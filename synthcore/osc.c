@@ -0,0 +1,35 @@
+#include "osc.h"
+#include "blep.h"
+
+/* t = phase in cycles, dt = increment in cycles, both usable in expr */
+#define OSC_KERNEL(name, expr)                                          \
+    static void name(Nco *nco, float amp, float *out, int frames)       \
+    {                                                                   \
+        uint32_t phase = nco->phase;                                    \
+        uint32_t inc = nco->inc;                                        \
+        double dt = inc * (1.0 / NCO_ONE);                              \
+                                                                        \
+        for (int i = 0; i < frames; i++)                                \
+        {                                                               \
+            double t = phase * (1.0 / NCO_ONE);                         \
+            (void)t;                                                    \
+            out[i] += amp * (expr);                                     \
+            phase += inc;                                               \
+        }                                                               \
+                                                                        \
+        (void)dt;                                                       \
+        nco->phase = phase;                                             \
+    }
+
+OSC_KERNEL(osc_sine,     nco_sin(phase))
+OSC_KERNEL(osc_square,   blep_square(t, dt))
+OSC_KERNEL(osc_triangle, blep_triangle(t, dt))
+OSC_KERNEL(osc_saw,      blep_saw(t, dt))
+
+const OscKernel osc_kernels[OSC_SHAPES] =
+{
+    [OSC_SINE]     = osc_sine,
+    [OSC_SQUARE]   = osc_square,
+    [OSC_TRIANGLE] = osc_triangle,
+    [OSC_SAW]      = osc_saw,
+};
@@ -0,0 +1,29 @@
+#ifndef OSC_H
+#define OSC_H
+
+#include "nco.h"
+
+/*
+ * Block oscillator kernels.
+ *
+ * Instead of a switch on the wave type for every sample, the caller picks a
+ * kernel once per buffer from osc_kernels[] and the kernel runs one tight
+ * loop over the whole block. Every kernel is the same loop with a different
+ * wave expression, generated by a macro in osc.c.
+ */
+
+typedef enum
+{
+    OSC_SINE,
+    OSC_SQUARE,
+    OSC_TRIANGLE,
+    OSC_SAW,
+    OSC_SHAPES
+} OscShape;
+
+/* adds amp * wave to out[0..frames) and advances the NCO */
+typedef void (*OscKernel)(Nco *nco, float amp, float *out, int frames);
+
+extern const OscKernel osc_kernels[OSC_SHAPES];
+
+#endif
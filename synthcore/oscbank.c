@@ -0,0 +1,337 @@
+#include "oscbank.h"
+
+#include <string.h>
+
+/* OSCBANK_LANES oscillators side by side, one per lane */
+typedef float vf __attribute__((vector_size(OSCBANK_LANES * 4)));
+typedef int32_t vi __attribute__((vector_size(OSCBANK_LANES * 4)));
+typedef uint32_t vu __attribute__((vector_size(OSCBANK_LANES * 4)));
+
+/* frames per pass, the per-lane sums of a pass stay in L1 */
+#define OSCBANK_BLOCK 64
+
+#define QUARTER 0x40000000u     /* a quarter cycle, sin(p + QUARTER) = cos(p) */
+
+/* memcpy instead of a cast, a malloc()ed bank may not be aligned for the vectors */
+static inline vu load_u(const uint32_t *p)
+{
+    vu v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline vf load_f(const float *p)
+{
+    vf v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store_u(uint32_t *p, vu v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void store_f(float *p, vf v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+/* ===== wave shapes, no branches ===== */
+
+/* phase in cycles, 0..1, the top 24 bits are all a float can hold anyway */
+static inline vf cycles(vu p)
+{
+    return __builtin_convertvector((vi)(p >> 8), vf) * (1.0f / 16777216.0f);
+}
+
+static inline vf vabs(vf x)
+{
+    return (vf)((vu)x & 0x7fffffffu);
+}
+
+/* max(x, 0): the compare gives all ones where x > 0 */
+static inline vf vpos(vf x)
+{
+    return (vf)((vi)x & (x > 0.0f));
+}
+
+/* sin(2 PI phase), odd polynomial of sin(PI x) up to x^11, error below 1e-6 */
+static inline vf vsin(vu p)
+{
+    /* as a signed number the phase is -1..1 half cycles */
+    vf x = __builtin_convertvector((vi)p, vf) * (1.0f / 2147483648.0f);
+    vu sign = (vu)x & 0x80000000u;
+
+    /* fold |x| onto 0..0.5, sin(PI x) = sin(PI (1 - x)) */
+    vf a = 0.5f - vabs(0.5f - vabs(x));
+    vf a2 = a * a;
+
+    vf s = a * (3.14159265f + a2 * (-5.16771278f + a2 * (2.55016404f +
+           a2 * (-0.59926453f + a2 * (0.08214589f + a2 * -0.00737043f)))));
+
+    return (vf)((vu)s | sign);
+}
+
+/*
+ * How far t is into the first and into the last dt of the cycle, 1 right
+ * at the jump and 0 outside. blep() and blamp() of blep.h are polynomials
+ * of these two, and at most one of them is not 0.
+ */
+#define EDGES(t)                                    \
+    vf lo = vpos(1.0f - (t) * inv_dt);              \
+    vf hi = vpos(1.0f - (1.0f - (t)) * inv_dt)
+
+static inline vf vblep(vf t, vf inv_dt)
+{
+    EDGES(t);
+    return 0.5f * (hi * hi - lo * lo);
+}
+
+static inline vf vblamp(vf t, vf inv_dt)
+{
+    EDGES(t);
+    return (lo * lo * lo + hi * hi * hi) * (1.0f / 6.0f);
+}
+
+static inline vf vsaw(vu p, vf inv_dt)
+{
+    vf t = cycles(p);
+    return 2.0f * t - 1.0f - 2.0f * vblep(t, inv_dt);
+}
+
+static inline vf vsquare(vu p, vf inv_dt)
+{
+    /* the bits of 1.0f with the top bit of the phase as the sign */
+    vf y = (vf)((p & 0x80000000u) | 0x3f800000u);
+
+    return y + 2.0f * (vblep(cycles(p), inv_dt) - vblep(cycles(p + 0x80000000u), inv_dt));
+}
+
+static inline vf vtriangle(vu p, vf dt, vf inv_dt)
+{
+    vu pu = p + QUARTER;
+    vf u = cycles(pu);
+    vf y = 1.0f - 4.0f * vabs(u - 0.5f);
+
+    return y + 8.0f * dt * (vblamp(u, inv_dt) - vblamp(cycles(pu + 0x80000000u), inv_dt));
+}
+
+/* ===== kernels ===== */
+
+/*
+ * p = phases, dt / inv_dt = increments in cycles, all usable in expr. dt is
+ * where the frequency ramp starts, near enough for the corrections over one
+ * pass.
+ */
+#define OSCBANK_KERNEL(name, expr)                                              \
+    static void name(OscBank *b, int from, int to, vf *acc, int frames)        \
+    {                                                                           \
+        for (int k = from; k < to; k += OSCBANK_LANES)                          \
+        {                                                                       \
+            vu p = load_u(&b->phase[k]);                                        \
+            vu inc = load_u(&b->inc[k]);                                        \
+            vf amp = load_f(&b->amp[k]);                                        \
+            vu inc_step = load_u((const uint32_t *)&b->inc_step[k]);            \
+            vf amp_step = load_f(&b->amp_step[k]);                              \
+                                                                                \
+            /* the padding has inc 0, keep 1 / dt finite there */               \
+            vf dt = cycles(inc);                                                \
+            dt = vpos(dt - 1e-7f) + 1e-7f;                                      \
+            vf inv_dt = 1.0f / dt;                                              \
+            (void)inv_dt;                                                       \
+                                                                                \
+            for (int i = 0; i < frames; i++)                                    \
+            {                                                                   \
+                acc[i] += amp * (expr);                                         \
+                p += inc;                                                       \
+                inc += inc_step;                                                \
+                amp += amp_step;                                                \
+            }                                                                   \
+                                                                                \
+            store_u(&b->phase[k], p);                                           \
+            store_u(&b->inc[k], inc);                                           \
+            store_f(&b->amp[k], amp);                                           \
+        }                                                                       \
+    }
+
+OSCBANK_KERNEL(bank_sine,     vsin(p))
+OSCBANK_KERNEL(bank_square,   vsquare(p, inv_dt))
+OSCBANK_KERNEL(bank_triangle, vtriangle(p, dt, inv_dt))
+OSCBANK_KERNEL(bank_saw,      vsaw(p, inv_dt))
+
+/*
+ * Every sample of a phasor waits for the multiply before, so a single vector
+ * would be limited by latency. RES_WAYS vectors are rotated side by side to
+ * keep the multipliers busy.
+ */
+#define RES_WAYS 4
+
+/*
+ * frames is at most OSCBANK_BLOCK, so a phasor never runs longer than that.
+ * A frequency ramp can't change the rotation every sample, so the phasor
+ * turns at the average frequency of the pass, and the next pass starts from
+ * the exact phase the ramp gets to.
+ */
+static inline void resonate(OscBank *b, int k, int ways, vf *acc, int frames)
+{
+    vu p[RES_WAYS], inc[RES_WAYS], inc_step[RES_WAYS];
+    vf amp[RES_WAYS], amp_step[RES_WAYS], rot_re[RES_WAYS], rot_im[RES_WAYS], re[RES_WAYS], im[RES_WAYS];
+
+    for (int w = 0; w < ways; w++)
+    {
+        int j = k + w * OSCBANK_LANES;
+
+        p[w] = load_u(&b->phase[j]);
+        inc[w] = load_u(&b->inc[j]);
+        amp[w] = load_f(&b->amp[j]);
+        inc_step[w] = load_u((const uint32_t *)&b->inc_step[j]);
+        amp_step[w] = load_f(&b->amp_step[j]);
+
+        vu mean = inc[w] + inc_step[w] * (uint32_t)((frames - 1) / 2);
+
+        /* the rotation per sample, and the start, straight from the integer phase */
+        rot_re[w] = vsin(mean + QUARTER);
+        rot_im[w] = vsin(mean);
+        re[w] = vsin(p[w] + QUARTER);
+        im[w] = vsin(p[w]);
+    }
+
+    for (int i = 0; i < frames; i++)
+    {
+        vf sum = amp[0] * im[0];
+
+        for (int w = 1; w < ways; w++)
+            sum += amp[w] * im[w];
+
+        acc[i] += sum;
+
+        for (int w = 0; w < ways; w++)
+        {
+            vf t = re[w] * rot_re[w] - im[w] * rot_im[w];
+            im[w] = re[w] * rot_im[w] + im[w] * rot_re[w];
+            re[w] = t;
+            amp[w] += amp_step[w];
+        }
+    }
+
+    /* where the ramp of the other kernels would be: n inc + n (n - 1) / 2 inc_step */
+    uint32_t n = frames;
+
+    for (int w = 0; w < ways; w++)
+    {
+        int j = k + w * OSCBANK_LANES;
+
+        store_u(&b->phase[j], p[w] + inc[w] * n + inc_step[w] * (n * (n - 1) / 2));
+        store_u(&b->inc[j], inc[w] + inc_step[w] * n);
+        store_f(&b->amp[j], amp[w]);
+    }
+}
+
+static void bank_resonator(OscBank *b, int from, int to, vf *acc, int frames)
+{
+    int k = from;
+
+    for (; k + RES_WAYS * OSCBANK_LANES <= to; k += RES_WAYS * OSCBANK_LANES)
+        resonate(b, k, RES_WAYS, acc, frames);
+
+    for (; k < to; k += OSCBANK_LANES)
+        resonate(b, k, 1, acc, frames);
+}
+
+typedef void (*BankKernel)(OscBank *b, int from, int to, vf *acc, int frames);
+
+static const BankKernel bank_kernels[OSC_SHAPES] =
+{
+    [OSC_SINE]     = bank_sine,
+    [OSC_SQUARE]   = bank_square,
+    [OSC_TRIANGLE] = bank_triangle,
+    [OSC_SAW]      = bank_saw,
+};
+
+/* ===== bank ===== */
+
+int oscbank_layout(OscBank *b, const int count[OSC_SHAPES])
+{
+    int total = 0;
+
+    for (int s = 0; s < OSC_SHAPES; s++)
+    {
+        total += count[s];
+    }
+
+    if (total > OSCBANK_MAX)
+    {
+        memset(b->start, 0, sizeof(b->start));
+        return -1;
+    }
+
+    int slot = 0;
+
+    for (int s = 0; s < OSC_SHAPES; s++)
+    {
+        int padded = (count[s] + OSCBANK_LANES - 1) / OSCBANK_LANES * OSCBANK_LANES;
+
+        b->start[s] = slot;
+
+        /* the padding slots are silent and never move */
+        for (int k = slot + count[s]; k < slot + padded; k++)
+        {
+            b->phase[k] = 0;
+            b->inc[k] = 0;
+            b->amp[k] = 0;
+            b->owner[k] = -1;
+        }
+
+        slot += padded;
+    }
+
+    b->start[OSC_SHAPES] = slot;
+
+    /* no ramps until someone sets them */
+    memset(b->amp_step, 0, slot * sizeof(float));
+    memset(b->inc_step, 0, slot * sizeof(int32_t));
+    return 0;
+}
+
+void oscbank_render(OscBank *b, float *out, int frames)
+{
+    oscbank_render_range(b, 0, b->start[OSC_SHAPES], out, frames);
+}
+
+void oscbank_render_range(OscBank *b, int from, int to, float *out, int frames)
+{
+    vf acc[OSCBANK_BLOCK];
+
+    for (int done = 0; done < frames; done += OSCBANK_BLOCK)
+    {
+        int n = frames - done < OSCBANK_BLOCK ? frames - done : OSCBANK_BLOCK;
+
+        memset(acc, 0, n * sizeof(vf));
+
+        for (int s = 0; s < OSC_SHAPES; s++)
+        {
+            BankKernel kernel = bank_kernels[s];
+
+            if (s == OSC_SINE && b->resonator)
+                kernel = bank_resonator;
+
+            int lo = from > b->start[s] ? from : b->start[s];
+            int hi = to < b->start[s + 1] ? to : b->start[s + 1];
+
+            if (hi > lo)
+                kernel(b, lo, hi, acc, n);
+        }
+
+        /* one sum across the lanes per sample, not per oscillator */
+        for (int i = 0; i < n; i++)
+        {
+            float sum = 0;
+
+            for (int l = 0; l < OSCBANK_LANES; l++)
+                sum += acc[i][l];
+
+            out[done + i] += sum;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef OSCBANK_H
+#define OSCBANK_H
+
+#include <stdint.h>
+
+#include "osc.h"
+
+/*
+ * Oscillator bank for lots of oscillators at once, structure-of-arrays.
+ *
+ * One Oscillator struct per partial means the audio loop jumps from struct
+ * to struct and runs one oscillator at a time. Here the phases, increments
+ * and amplitudes each get their own array, sorted by wave shape, so the
+ * kernel loads OSCBANK_LANES neighbouring oscillators into one vector and
+ * advances them all with each instruction, over the whole block.
+ *
+ * Every shape is one contiguous group, start[s] .. start[s + 1], padded to a
+ * multiple of OSCBANK_LANES with silent slots, so a group's loop is the same
+ * wave expression for every lane and has no branches at all. The sine is a
+ * polynomial (a table lookup per lane doesn't vectorise), the others use the
+ * same PolyBLEP / PolyBLAMP corrections as blep.h, written without ifs.
+ *
+ * With resonator set, the sines are made by a complex rotation instead:
+ * every sample the phasor (cos, sin) is multiplied by (cos w, sin w), one
+ * complex multiply, no polynomial. Rounding makes the phasor's length drift,
+ * so every OSCBANK_BLOCK samples it's started again from the exact integer
+ * phase, which renormalises it. A new frequency only changes the rotation,
+ * the phase carries on, so there's no click.
+ *
+ * amp_step and inc_step ramp the amplitude and the increment in a straight
+ * line, added to them after every sample, so an envelope only has to work
+ * out a new ramp now and then (its control rate) and the bank fills in the
+ * samples in between at the cost of two vector adds. Render leaves amp and
+ * inc where the ramps got to. layout() sets the steps to 0, no ramps.
+ *
+ * The vectors are GCC / clang vector extensions, which become SSE or AVX on
+ * x86 and NEON on ARM. Build with ARCH=-march=native to get the widest ones.
+ *
+ *   int counts[OSC_SHAPES] = {...};
+ *   oscbank_layout(&b, counts);
+ *   ...fill phase / inc / amp (and the steps) of slots start[s] + 0 .. counts[s] - 1...
+ *   oscbank_render(&b, out, frames);   // adds to out, advances the phases
+ */
+
+#define OSCBANK_MAX 4096
+
+/* as wide as the vector registers: 8 floats with AVX, else 4 (SSE, NEON) */
+#ifdef __AVX__
+#define OSCBANK_LANES 8
+#else
+#define OSCBANK_LANES 4
+#endif
+
+/* room for the padding of the widest lanes, so the struct is the same whatever the flags */
+#define OSCBANK_SIZE (OSCBANK_MAX + OSC_SHAPES * 8)
+
+typedef struct
+{
+    uint32_t phase[OSCBANK_SIZE] __attribute__((aligned(32)));
+    uint32_t inc[OSCBANK_SIZE] __attribute__((aligned(32)));
+    float amp[OSCBANK_SIZE] __attribute__((aligned(32)));
+
+    /* added to amp and inc after every sample, inc_step can be negative */
+    float amp_step[OSCBANK_SIZE] __attribute__((aligned(32)));
+    int32_t inc_step[OSCBANK_SIZE] __attribute__((aligned(32)));
+
+    /* what the caller wants to know about a slot, e.g. which oscillator it came from, -1 for padding */
+    int owner[OSCBANK_SIZE];
+
+    int start[OSC_SHAPES + 1];
+
+    int resonator;  /* sines by complex rotation, see above */
+} OscBank;
+
+/* makes room for count[s] oscillators of every shape, returns 0 or -1 when they don't fit */
+int oscbank_layout(OscBank *b, const int count[OSC_SHAPES]);
+
+/* adds every oscillator to out[0..frames) and advances their phases and ramps */
+void oscbank_render(OscBank *b, float *out, int frames);
+
+/* the same for slots from .. to only, both multiples of OSCBANK_LANES, e.g. one thread's share */
+void oscbank_render_range(OscBank *b, int from, int to, float *out, int frames);
+
+#endif
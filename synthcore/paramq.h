@@ -0,0 +1,79 @@
+#ifndef PARAMQ_H
+#define PARAMQ_H
+
+#include <stdatomic.h>
+
+/*
+ * Parameter queue from the UI thread to the audio thread.
+ *
+ * One thread pushes (the event loop), one thread pops (the audio callback,
+ * once per block). It's a ring buffer with two counters and no lock: the
+ * producer only writes tail, the consumer only writes head. Both sides
+ * finish in a fixed number of steps, nothing ever waits or allocates, so
+ * it's safe to call from the audio callback.
+ *
+ * A message is just "parameter id = value". What the ids mean is up to the
+ * engine, see WaveGenParam in wavegen.h for an example.
+ */
+
+#define PARAMQ_SIZE 256     /* power of two */
+
+typedef struct
+{
+    int id;
+    double value;
+} ParamMsg;
+
+typedef struct
+{
+    ParamMsg msgs[PARAMQ_SIZE];
+    atomic_uint head;   /* next message to pop, written by the consumer */
+    atomic_uint tail;   /* next free slot, written by the producer */
+} ParamQueue;
+
+static inline void paramq_init(ParamQueue *q)
+{
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+/* producer side, returns 0 or -1 when the queue is full */
+static inline int paramq_push(ParamQueue *q, int id, double value)
+{
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (tail - head == PARAMQ_SIZE) return -1;
+
+    q->msgs[tail & (PARAMQ_SIZE - 1)] = (ParamMsg){id, value};
+
+    /* the message is written before the consumer can see the new tail */
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+/* producer side, how many messages can be pushed for sure */
+static inline int paramq_space(ParamQueue *q)
+{
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    return PARAMQ_SIZE - (int)(tail - head);
+}
+
+/* consumer side, returns 1 and fills m, or 0 when the queue is empty */
+static inline int paramq_pop(ParamQueue *q, ParamMsg *m)
+{
+    unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head == tail) return 0;
+
+    *m = q->msgs[head & (PARAMQ_SIZE - 1)];
+
+    /* the slot is read before the producer can reuse it */
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,330 @@
+#ifdef __linux__
+#define _GNU_SOURCE     /* pthread_setaffinity_np() */
+#endif
+
+#include "pool.h"
+
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* how long a worker spins for the next job before it starts to sleep */
+#define SPIN_NS 200000
+#define NAP_NS 100000
+
+#define DONE 1
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline void relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+int pool_cores()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/* ===== chunk queues ===== */
+
+static inline uint64_t make_run(unsigned epoch, int next, int end)
+{
+    return (uint64_t)epoch << 32 | (uint64_t)next << 16 | (uint64_t)end;
+}
+
+/* the owner takes from the front, thieves from the back, both with one CAS */
+static int take(PoolQueue *q, unsigned epoch, int from_back)
+{
+    uint64_t run = atomic_load_explicit(&q->run, memory_order_acquire);
+
+    for (;;)
+    {
+        int next = (run >> 16) & 0xffff;
+        int end = run & 0xffff;
+
+        /* a queue of an older job is empty by definition */
+        if ((unsigned)(run >> 32) != epoch || next >= end) return -1;
+
+        uint64_t rest = from_back ? make_run(epoch, next, end - 1) : make_run(epoch, next + 1, end);
+
+        if (atomic_compare_exchange_weak_explicit(&q->run, &run, rest,
+                                                  memory_order_acq_rel, memory_order_acquire))
+            return from_back ? end - 1 : next;
+    }
+}
+
+static int next_chunk(Pool *p, int self, unsigned epoch)
+{
+    int chunk = take(&p->queue[self], epoch, 0);
+
+    for (int i = 1; chunk < 0 && i <= p->threads; i++)
+        chunk = take(&p->queue[(self + i) % (p->threads + 1)], epoch, 1);
+
+    return chunk;
+}
+
+/*
+ * Takes chunks until there are none left anywhere. run and ctx are read
+ * before the first chunk is taken: once the queues are empty the caller can
+ * set up the next job, and a chunk of this one must not run with its ctx.
+ */
+static void work(Pool *p, int self, unsigned epoch)
+{
+    PoolTask run = atomic_load_explicit(&p->run, memory_order_relaxed);
+    void *ctx = atomic_load_explicit(&p->ctx, memory_order_relaxed);
+    int chunk;
+
+    while ((chunk = next_chunk(p, self, epoch)) >= 0)
+    {
+        run(ctx, chunk, self);
+
+        /* the result only counts if the caller hasn't given up on us meanwhile */
+        uint64_t running = (uint64_t)epoch << 8;
+        uint64_t done = running | (uint64_t)self << 1 | DONE;
+
+        atomic_compare_exchange_strong_explicit(&p->state[chunk], &running, done,
+                                                memory_order_acq_rel, memory_order_relaxed);
+    }
+}
+
+/* ===== workers ===== */
+
+static unsigned wait_for_job(Pool *p, unsigned seen)
+{
+    double start = now();
+
+    for (;;)
+    {
+        unsigned epoch = atomic_load_explicit(&p->epoch, memory_order_acquire);
+
+        if (epoch != seen || atomic_load_explicit(&p->quit, memory_order_relaxed))
+            return epoch;
+
+        if ((now() - start) * 1e9 < SPIN_NS)
+        {
+            for (int i = 0; i < 64; i++)
+                relax();
+        }
+        else
+        {
+            struct timespec nap = {0, NAP_NS};
+            nanosleep(&nap, NULL);
+        }
+    }
+}
+
+static void pin(int core)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % pool_cores(), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+
+static void *worker_main(void *arg)
+{
+    PoolWorker *w = arg;
+    Pool *p = w->pool;
+    unsigned seen = atomic_load_explicit(&p->epoch, memory_order_acquire);
+
+    /* the caller (the audio thread) isn't pinned, the workers take core 1, 2 ... */
+    pin(w->index);
+
+    for (;;)
+    {
+        seen = wait_for_job(p, seen);
+
+        if (atomic_load_explicit(&p->quit, memory_order_relaxed)) break;
+
+        /*
+         * Busy before a chunk can be taken: the caller sees a queue emptied
+         * by our take, and with it this store, before pool_done_with().
+         */
+        atomic_store_explicit(&p->busy[w->index], seen, memory_order_seq_cst);
+        work(p, w->index, seen);
+        atomic_store_explicit(&p->busy[w->index], 0, memory_order_release);
+    }
+
+    return NULL;
+}
+
+int pool_init(Pool *p, int threads)
+{
+    memset(p, 0, sizeof(*p));
+
+    atomic_init(&p->run, NULL);
+    atomic_init(&p->ctx, NULL);
+    atomic_init(&p->epoch, 0);
+    atomic_init(&p->quit, 0);
+    atomic_init(&p->claimed, 0);
+    atomic_init(&p->wanted, 0);
+
+    for (int i = 0; i <= POOL_MAX_THREADS; i++)
+    {
+        atomic_init(&p->queue[i].run, 0);
+        atomic_init(&p->busy[i], 0);
+    }
+    for (int c = 0; c < POOL_MAX_CHUNKS; c++)
+        atomic_init(&p->state[c], 0);
+
+    if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+
+    for (int i = 0; i < threads; i++)
+    {
+        p->worker[i] = (PoolWorker){p, i + 1};
+
+        if (pthread_create(&p->thread[i], NULL, worker_main, &p->worker[i]) != 0)
+            break;
+
+        p->threads++;
+    }
+
+    return p->threads;
+}
+
+void pool_free(Pool *p)
+{
+    atomic_store(&p->quit, 1);
+
+    for (int i = 0; i < p->threads; i++)
+        pthread_join(p->thread[i], NULL);
+
+    p->threads = 0;
+}
+
+/* ===== running a job ===== */
+
+unsigned pool_run(Pool *p, PoolTask run, PoolTask collect, void *ctx, int chunks, double deadline)
+{
+    if (chunks > POOL_MAX_CHUNKS) chunks = POOL_MAX_CHUNKS;
+
+    double start = now();
+    unsigned epoch = atomic_load_explicit(&p->epoch, memory_order_relaxed) + 1;
+    int parts = p->threads + 1;
+
+    /* 0 is "not busy", skipped when the count wraps */
+    if (epoch == 0) epoch = 1;
+
+    atomic_store_explicit(&p->run, run, memory_order_relaxed);
+    atomic_store_explicit(&p->ctx, ctx, memory_order_relaxed);
+
+    for (int c = 0; c < chunks; c++)
+        atomic_store_explicit(&p->state[c], (uint64_t)epoch << 8, memory_order_relaxed);
+
+    /* an even share each to start with, stealing evens out the rest */
+    for (int i = 0; i < parts; i++)
+    {
+        uint64_t share = make_run(epoch, chunks * i / parts, chunks * (i + 1) / parts);
+        atomic_store_explicit(&p->queue[i].run, share, memory_order_relaxed);
+    }
+
+    /* everything above is written before a worker can see the new epoch */
+    atomic_store_explicit(&p->epoch, epoch, memory_order_release);
+
+    work(p, 0, epoch);
+
+    /* every chunk is taken now, wait for the ones still running elsewhere */
+    uint64_t running = (uint64_t)epoch << 8;
+
+    for (int c = 0; c < chunks; c++)
+    {
+        while (atomic_load_explicit(&p->state[c], memory_order_acquire) == running)
+        {
+            if (now() - start < deadline)
+            {
+                relax();
+                continue;
+            }
+
+            /* too late, do it here, and whatever the worker makes is thrown away */
+            uint64_t expected = running;
+
+            if (atomic_compare_exchange_strong_explicit(&p->state[c], &expected, running | DONE,
+                                                        memory_order_acq_rel, memory_order_acquire))
+            {
+                run(ctx, c, 0);
+                p->taken_over++;
+            }
+        }
+    }
+
+    for (int c = 0; c < chunks; c++)
+    {
+        int thread = (atomic_load_explicit(&p->state[c], memory_order_acquire) >> 1) & 0x7f;
+
+        if (collect)
+            collect(ctx, c, thread);
+        p->chunks_by[thread]++;
+    }
+
+    p->jobs++;
+    return epoch;
+}
+
+int pool_done_with(Pool *p, unsigned epoch)
+{
+    for (int i = 1; i <= p->threads; i++)
+    {
+        unsigned busy = atomic_load_explicit(&p->busy[i], memory_order_seq_cst);
+
+        /* on this job or an older one, the epochs wrap */
+        if (busy && (int)(busy - epoch) <= 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int try_claim(Pool *p)
+{
+    int free = 0;
+
+    /* acquire: what the last caller did to the pool (the epoch, the counts) is seen here */
+    return atomic_compare_exchange_strong_explicit(&p->claimed, &free, 1,
+                                                   memory_order_acquire, memory_order_relaxed);
+}
+
+int pool_claim(Pool *p)
+{
+    /* the other caller is waiting for the job that's on now, it's next */
+    if (atomic_load_explicit(&p->wanted, memory_order_relaxed)) return 0;
+
+    return try_claim(p);
+}
+
+int pool_claim_within(Pool *p, double seconds)
+{
+    if (try_claim(p)) return 1;
+
+    atomic_store_explicit(&p->wanted, 1, memory_order_relaxed);
+
+    double start = now();
+    int got;
+
+    while (!(got = try_claim(p)) && now() - start < seconds)
+        relax();
+
+    atomic_store_explicit(&p->wanted, 0, memory_order_relaxed);
+    return got;
+}
+
+void pool_release(Pool *p)
+{
+    atomic_store_explicit(&p->claimed, 0, memory_order_release);
+}
@@ -0,0 +1,131 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/*
+ * Worker threads for the audio thread, with work stealing.
+ *
+ * The threads are started once, up front, and each is pinned to a core (on
+ * Linux). pool_run() cuts a job into chunks and gives every thread, the
+ * calling one too, a run of them. A thread takes chunks from the front of
+ * its own run, and when that's empty it steals from the back of someone
+ * else's, so an expensive chunk or a worker that wakes up late doesn't hold
+ * the others up. The caller works along, so if no worker wakes up at all it
+ * just does every chunk itself.
+ *
+ * A chunk is done in two steps. run() works it out into storage of its
+ * thread, nobody else's. When every chunk is done, the caller calls
+ * collect() for each, in order, with the thread whose result counts. If a
+ * worker still isn't done with a chunk when the deadline has passed, the
+ * caller does that chunk again itself and the worker's result is thrown
+ * away. A descheduled worker costs some time then, but it can't make the
+ * caller miss its own deadline by more than a chunk, or mix two results.
+ * Such a worker may still be reading its inputs when the caller has moved
+ * on, so run() must not write anywhere but its thread's storage, and the
+ * caller mustn't change what a job's run() reads until pool_done_with()
+ * says no worker is on that job any more. The simplest way is to give every
+ * job its own inputs, and use them again only then.
+ *
+ * Offline work with POOL_NO_DEADLINE never takes a chunk over, so there
+ * every chunk runs exactly once and run() may as well write its result
+ * straight to where it belongs, with no collect() (NULL).
+ *
+ * Waiting workers spin for a moment and then poll with short sleeps. The
+ * caller never takes a lock or wakes anyone through the kernel, so
+ * pool_run() is fine on the audio thread.
+ *
+ * There's one caller at a time. When two threads share a pool (the audio
+ * thread, and one importing a file in the background), each claims it
+ * before pool_run() and lets go with pool_release() after. The background
+ * one uses pool_claim(), which doesn't wait, and naps when it's taken; it
+ * claims for short jobs, so it never holds the pool for long. The audio
+ * thread uses pool_claim_within(), which waits up to a limit for such a
+ * job to end, and keeps everyone else off meanwhile so it's next; if it
+ * doesn't get it in time, it does its job on its own. pool_done_with()
+ * doesn't need the pool claimed.
+ *
+ *   Pool pool;
+ *   pool_init(&pool, pool_cores() - 1);
+ *   ...
+ *   unsigned job = pool_run(&pool, run, collect, ctx, chunks, deadline);
+ *   ...
+ *   if (pool_done_with(&pool, job)) ...ctx can be used for the next job...
+ */
+
+#define POOL_MAX_THREADS 16     /* workers, the caller not counted */
+#define POOL_MAX_CHUNKS 256
+
+#define POOL_NO_DEADLINE 1e30
+
+/* thread 0 is the caller, 1 .. threads the workers */
+typedef void (*PoolTask)(void *ctx, int chunk, int thread);
+
+typedef struct Pool Pool;
+
+typedef struct
+{
+    Pool *pool;
+    int index;
+} PoolWorker;
+
+/* the chunks a thread has left, epoch << 32 | next << 16 | end, one per cache line */
+typedef struct
+{
+    _Alignas(64) _Atomic uint64_t run;
+} PoolQueue;
+
+struct Pool
+{
+    int threads;
+    pthread_t thread[POOL_MAX_THREADS];
+    PoolWorker worker[POOL_MAX_THREADS];
+    PoolQueue queue[POOL_MAX_THREADS + 1];
+
+    /* the job of the current epoch */
+    _Atomic(PoolTask) run;
+    _Atomic(void *) ctx;
+    _Atomic uint64_t state[POOL_MAX_CHUNKS];    /* epoch << 8 | thread << 1 | done */
+    atomic_uint epoch;
+    atomic_int quit;
+    atomic_int claimed;                         /* a caller is in pool_run(), see pool_claim() */
+    atomic_int wanted;                          /* pool_claim_within() is waiting, it goes first */
+
+    /* the epoch a worker may be running a chunk of, 0 when it isn't */
+    atomic_uint busy[POOL_MAX_THREADS + 1];
+
+    /* counts since pool_init(), only the caller writes them */
+    long jobs;
+    long chunks_by[POOL_MAX_THREADS + 1];       /* whose results counted */
+    long taken_over;                            /* chunks the caller did again after the deadline */
+};
+
+/* number of cores online, at least 1 */
+int pool_cores();
+
+/* starts up to POOL_MAX_THREADS workers, returns how many (0 is fine, the caller does it all) */
+int pool_init(Pool *p, int threads);
+
+void pool_free(Pool *p);
+
+/*
+ * Runs chunks 0 .. chunks - 1 (at most POOL_MAX_CHUNKS) and returns when
+ * collect() has been called for every one (unless it's NULL). deadline is
+ * in seconds from the call. Returns the job's epoch, for pool_done_with().
+ */
+unsigned pool_run(Pool *p, PoolTask run, PoolTask collect, void *ctx, int chunks, double deadline);
+
+/* caller: 1 when no worker can still be running a chunk of job epoch or an older one */
+int pool_done_with(Pool *p, unsigned epoch);
+
+/* with more than one caller: 1 when the pool is now yours until pool_release(), 0 when another has it */
+int pool_claim(Pool *p);
+
+/* the same for the one caller that comes first, waits up to seconds for the pool */
+int pool_claim_within(Pool *p, double seconds);
+
+void pool_release(Pool *p);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SMOOTH_H
+#define SMOOTH_H
+
+/*
+ * Linear parameter smoothing.
+ *
+ * Jumping a gain or a frequency from one sample to the next makes a click,
+ * and a knob that moves in steps makes a row of them ("zipper noise").
+ * A Smoother walks from its current value to a new target in a straight
+ * line over a fixed number of samples instead.
+ *
+ * The ramp length is in samples, not in blocks, so the result doesn't
+ * depend on the buffer size the audio device happens to use.
+ */
+
+#define SMOOTH_FRAMES 512   /* about 12 ms at 44.1 kHz */
+
+typedef struct
+{
+    double value;
+    double target;
+    double step;
+    int left;       /* samples until value reaches target */
+} Smoother;
+
+static inline void smooth_init(Smoother *s, double value)
+{
+    s->value = s->target = value;
+    s->step = 0;
+    s->left = 0;
+}
+
+/* starts a new ramp from wherever the value is now */
+static inline void smooth_set(Smoother *s, double target, int frames)
+{
+    if (target == s->target) return;
+
+    s->target = target;
+    s->step = (target - s->value) / frames;
+    s->left = frames;
+}
+
+static inline int smooth_active(const Smoother *s)
+{
+    return s->left > 0;
+}
+
+/* value for the next sample */
+static inline double smooth_next(Smoother *s)
+{
+    if (s->left > 0)
+    {
+        /* land exactly on the target, no rounding left over */
+        s->value = --s->left ? s->value + s->step : s->target;
+    }
+
+    return s->value;
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "subtractive.h"
+
+#include <string.h>
+
+/* ===== audio ===== */
+static void subtractive_process(SynthState *state, float *out, int frames)
+{
+    SubtractiveSynth *s = (SubtractiveSynth *)state;
+
+    memset(out, 0, frames * sizeof(float));
+
+    /* the waveform is picked once per buffer, every voice runs the same kernel */
+    OscKernel kernel = osc_kernels[s->wave];
+
+    for (int v = 0; v < MAX_VOICES; v++)
+    {
+        if (s->voices[v].active)
+            kernel(&s->voices[v].nco, 1 / 2.5f, out, frames);
+    }
+
+    for (int f = 0; f < s->filter_count; f++)
+    {
+        if (s->model == FILTER_MODEL_BIQUAD)
+            biquad_process_block(&s->filters[f].biquad, out, frames);
+        else
+            svf_process_block(&s->filters[f].svf, out, frames, s->sample_rate);
+    }
+
+    for (int i = 0; i < frames; i++)
+        out[i] *= 0.5f;
+}
+
+void subtractive_init(SubtractiveSynth *s, FilterModel model, double sample_rate)
+{
+    memset(s, 0, sizeof(*s));
+
+    s->base.process = subtractive_process;
+    s->model = model;
+    s->wave = OSC_SAW;
+    s->sample_rate = sample_rate;
+}
+
+/* ==== poliphony ==== */
+
+static int find_voice(SubtractiveSynth *s, int key)
+{
+    for (int i = 0; i < MAX_VOICES; i++)
+        if (s->voices[i].active && s->voices[i].key == key)
+            return i;
+    return -1;
+}
+
+static int alloc_voice(SubtractiveSynth *s)
+{
+    for (int i = 0; i < MAX_VOICES; i++)
+        if (!s->voices[i].active)
+            return i;
+    return 0;
+}
+
+void subtractive_note_on(SubtractiveSynth *s, int key, float freq)
+{
+    int v = find_voice(s, key);
+    if (v < 0)
+        v = alloc_voice(s);
+
+    Voice *voice = &s->voices[v];
+
+    voice->key = key;
+    voice->freq = freq;
+    nco_set_freq(&voice->nco, freq, s->sample_rate);
+    voice->active = 1;
+}
+
+void subtractive_note_off(SubtractiveSynth *s, int key)
+{
+    int v = find_voice(s, key);
+    if (v >= 0)
+        s->voices[v].active = 0;
+}
+
+int subtractive_is_key_active(SubtractiveSynth *s, int key)
+{
+    return find_voice(s, key) >= 0;
+}
+
+/* ===== filter ===== */
+
+int subtractive_add_filter(SubtractiveSynth *s)
+{
+    if (s->filter_count >= MAX_FILTERS) return -1;
+
+    int index = s->filter_count;
+    SubFilter *f = &s->filters[index];
+
+    memset(f, 0, sizeof(*f));
+    f->type = FILTER_LPF;
+    f->cutoff = 800;
+    f->res = s->model == FILTER_MODEL_BIQUAD ? 0.7f : 0.1f;
+
+    subtractive_update_filter(s, index);
+
+    s->filter_count++;
+    return index;
+}
+
+void subtractive_remove_filter(SubtractiveSynth *s, int index)
+{
+    if (index < 0 || index >= s->filter_count) return;
+
+    for (int i = index; i < s->filter_count - 1; i++)
+        s->filters[i] = s->filters[i + 1];
+
+    s->filter_count--;
+}
+
+void subtractive_update_filter(SubtractiveSynth *s, int index)
+{
+    SubFilter *f = &s->filters[index];
+
+    if (s->model == FILTER_MODEL_BIQUAD)
+    {
+        f->biquad.type = f->type;
+        f->biquad.cutoff = f->cutoff;
+        f->biquad.res = f->res;
+
+        biquad_update(&f->biquad, s->sample_rate);
+
+        /* biquad_update clamps, show the values that are really used */
+        f->cutoff = f->biquad.cutoff;
+        f->res = f->biquad.res;
+    }
+    else
+    {
+        f->svf.type = f->type;
+        f->svf.cutoff = f->cutoff;
+        f->svf.res = f->res;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef SUBTRACTIVE_H
+#define SUBTRACTIVE_H
+
+#include "filter.h"
+#include "nco.h"
+#include "osc.h"
+#include "synth.h"
+
+/*
+ * The subtractive synth: up to MAX_VOICES band-limited oscillators summed
+ * and sent through a chain of up to MAX_FILTERS filters.
+ *
+ * The filter model picks the implementation: the simple state-variable
+ * filter of subtractive_synth.c or the biquad of true_subtractive_synth.c.
+ */
+
+#define MAX_FILTERS 5
+#define MAX_VOICES 8
+
+typedef enum
+{
+    FILTER_MODEL_SVF,
+    FILTER_MODEL_BIQUAD
+} FilterModel;
+
+typedef struct
+{
+    int active;
+    int key;        /* whatever the caller uses to identify a note */
+    float freq;
+    Nco nco;
+} Voice;
+
+typedef struct
+{
+    FilterType type;
+    float cutoff;
+    float res;
+
+    /* state of the filter model in use */
+    SvfFilter svf;
+    BiquadFilter biquad;
+} SubFilter;
+
+typedef struct
+{
+    SynthState base;
+
+    FilterModel model;
+    OscShape wave;
+
+    Voice voices[MAX_VOICES];
+
+    SubFilter filters[MAX_FILTERS];
+    int filter_count;
+
+    double sample_rate;
+} SubtractiveSynth;
+
+void subtractive_init(SubtractiveSynth *s, FilterModel model, double sample_rate);
+
+/* ==== poliphony ==== */
+void subtractive_note_on(SubtractiveSynth *s, int key, float freq);
+void subtractive_note_off(SubtractiveSynth *s, int key);
+int subtractive_is_key_active(SubtractiveSynth *s, int key);
+
+/* ===== filter ===== */
+
+/* adds an 800 Hz LPF at the end of the chain, returns its index or -1 */
+int subtractive_add_filter(SubtractiveSynth *s);
+void subtractive_remove_filter(SubtractiveSynth *s, int index);
+
+/* call after changing type, cutoff or res of a filter */
+void subtractive_update_filter(SubtractiveSynth *s, int index);
+
+#endif
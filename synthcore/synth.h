@@ -0,0 +1,27 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+/*
+ * Common interface of every engine in libsynthcore.
+ *
+ * Each engine struct (WaveGen, AdditiveSynth, DrumSynth, SubtractiveSynth,
+ * FmSynth) starts with a SynthState, so a pointer to the engine is also a
+ * pointer to its SynthState. Whoever owns the audio output - an SDL
+ * callback, the offline renderer, a benchmark - just calls synth_process()
+ * on it.
+ */
+
+typedef struct SynthState SynthState;
+
+struct SynthState
+{
+    /* writes frames mono samples to out, overwriting what's there */
+    void (*process)(SynthState *s, float *out, int frames);
+};
+
+static inline void synth_process(SynthState *s, float *out, int frames)
+{
+    s->process(s, out, frames);
+}
+
+#endif
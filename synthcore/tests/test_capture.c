@@ -0,0 +1,93 @@
+/*
+ * The scope never gets a torn window from the capture ring.
+ *
+ * A writer thread plays blocks of 512 samples that count up (0, 1, 2 ...)
+ * into the ring as fast as it can, so it laps the reader all the time, and
+ * the main thread reads the newest CAPTURE_SIZE samples over and over for
+ * a couple of seconds. Whatever capture_read() says is good has to count
+ * up without a gap: a gap is a sample of a newer lap in the middle of the
+ * window. Reads cut short are fine, that's what they're for.
+ *
+ *   ./tests/test_capture
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "capture.h"
+
+#define SECONDS 2
+#define BLOCK 512
+
+/* counts wrap here, to stay exact in a float */
+#define WRAP (1 << 24)
+
+static CaptureRing ring;
+static atomic_int stop;
+static float window[CAPTURE_SIZE];
+
+static void *writer(void *arg)
+{
+    float block[BLOCK];
+    unsigned k = 0;
+
+    (void)arg;
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed))
+    {
+        for (int i = 0; i < BLOCK; i++)
+            block[i] = (float)(k++ % WRAP);
+
+        capture_write(&ring, block, BLOCK);
+    }
+
+    return NULL;
+}
+
+int main()
+{
+    pthread_t thread;
+    long reads = 0, cut = 0, torn = 0;
+
+    capture_init(&ring);
+    atomic_init(&stop, 0);
+
+    /* the first lap, so the whole ring counts */
+    float first[CAPTURE_SIZE];
+    for (int i = 0; i < CAPTURE_SIZE; i++)
+        first[i] = (float)(WRAP - CAPTURE_SIZE + i);
+    capture_write(&ring, first, CAPTURE_SIZE);
+
+    if (pthread_create(&thread, NULL, writer, NULL) != 0)
+    {
+        printf("test_capture: can't start the writer\n");
+        return 1;
+    }
+
+    time_t end = time(NULL) + SECONDS;
+
+    while (time(NULL) < end)
+    {
+        int n = capture_read(&ring, window, CAPTURE_SIZE);
+
+        reads++;
+        cut += n < CAPTURE_SIZE;
+
+        for (int i = 1; i < n; i++)
+        {
+            if ((long)window[i] != ((long)window[i - 1] + 1) % WRAP)
+            {
+                if (torn++ < 5)
+                    printf("FAIL read %ld: sample %d is %.0f after %.0f\n", reads, i, window[i], window[i - 1]);
+                break;
+            }
+        }
+    }
+
+    atomic_store(&stop, 1);
+    pthread_join(thread, NULL);
+
+    printf("%ld reads of %d samples, %ld cut short, %ld torn\n", reads, CAPTURE_SIZE, cut, torn);
+    printf("test_capture: %s\n", torn ? "FAILED" : "OK");
+    return torn > 0;
+}
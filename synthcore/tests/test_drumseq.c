@@ -0,0 +1,185 @@
+/*
+ * The sequencer starts every hit on its exact sample.
+ *
+ * Each track plays a one-sample click of its own height (1, 2, 4, 8), so
+ * every sample of the output says which tracks started on it. The
+ * sequencer runs at several tempos, with and without swing, at 16 and 32
+ * steps, in blocks of 1 to 4096 samples, started on the first block or a
+ * few blocks in (through the queue, as from the UI), and every click has to
+ * be on the sample the closed form gives:
+ *
+ *   step n starts round(start + n * L + (n odd ? swing * L : 0)),  L = rate * 60 / tempo / 4
+ *
+ * with nothing anywhere else. Some runs change the tempo halfway, through
+ * the queue: every step not played yet moves to one new L after the last
+ * step played. If that's overdue already, the step plays on the first
+ * sample of the block the change comes with, and the ones after it count
+ * from there.
+ *
+ *   ./tests/test_drumseq
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "drumseq.h"
+
+#define SAMPLE_RATE 44100
+#define SECONDS 6
+#define TOTAL (SECONDS * SAMPLE_RATE)
+#define GAIN 0.8f   /* the sequencer's */
+
+static DrumSeq seq;
+static float out[TOTAL];
+
+typedef struct
+{
+    double tempo;
+    double swing;
+    int steps;
+    uint32_t pattern[DRUM_SEQ_TRACKS];
+    double new_tempo;               /* from CHANGE_AT on, 0 for none */
+} Run;
+
+static const Run runs[] = {
+    {120,   0,       16, {0x0101 | 0x0400, 0x1010, 0xc000, 0x5555 | 0x2000}, 0},
+    {123,   0.2,     16, {0x0101 | 0x0400, 0x1010, 0xc000, 0x5555 | 0x2000}, 0},
+    {60,    0.5,     16, {0xffff, 0x0000, 0x8001, 0xaaaa}, 0},
+    {137.5, 1.0 / 3, 32, {0x01010101, 0x10101010, 0xf0000000, 0xffffffff}, 0},
+    {174,   0.1,     32, {0x80000001, 0x00010000, 0x0f0f0f0f, 0x33333333}, 0},
+    {300,   0.25,    16, {0xffff, 0xffff, 0xffff, 0xffff}, 0},
+    {120,   0.2,     16, {0xffff, 0x1010, 0x0000, 0xaaaa}, 150},
+    {140,   0,       16, {0xffff, 0x0101, 0x8000, 0x0000}, 95},
+    {90,    0.5,     16, {0xffff, 0x0000, 0x0000, 0x0000}, 400},
+};
+#define RUN_COUNT (int)(sizeof(runs) / sizeof(runs[0]))
+
+static const int blocks[] = {1, 64, 333, 512, 4096};
+#define BLOCK_COUNT (int)(sizeof(blocks) / sizeof(blocks[0]))
+
+/* the tempo changes on the first block from here on */
+#define CHANGE_AT (3 * SAMPLE_RATE + 123)
+
+/* how many samples are wrong */
+static int check(const Run *r, int block, int wait_blocks)
+{
+    drum_seq_init(&seq, SAMPLE_RATE);
+
+    for (int t = 0; t < DRUM_SEQ_TRACKS; t++)
+    {
+        float click = (float)(1 << t);
+        drum_sampler_load(&seq.sampler, t, &click, 1);
+
+        seq.pattern[t] = r->pattern[t];
+    }
+
+    seq.tempo = r->tempo;
+    seq.swing = r->swing;
+    seq.steps = r->steps;
+
+    /* started from "the UI" at the start of block wait_blocks */
+    long start = (long)wait_blocks * block;
+    long change = -1;
+
+    for (long pos = 0; pos < TOTAL; pos += block)
+    {
+        if (pos == start)
+            drum_seq_set(&seq, DRUM_SEQ_RUNNING, 1);
+
+        if (r->new_tempo && change < 0 && pos >= CHANGE_AT)
+        {
+            drum_seq_set(&seq, DRUM_SEQ_TEMPO, r->new_tempo);
+            change = pos;
+        }
+
+        int n = TOTAL - pos < block ? (int)(TOTAL - pos) : block;
+        synth_process(&seq.base, out + pos, n);
+    }
+
+    drum_seq_free(&seq);
+
+    /* the clicks that should be there, by sample */
+    static int want[TOTAL];
+    double len = SAMPLE_RATE * 60.0 / r->tempo / 4.0;
+    double grid = start;
+    int moved = 0;
+
+    for (long i = 0; i < TOTAL; i++)
+        want[i] = 0;
+
+    for (long n = 0; ; n++)
+    {
+        long at = (long)floor(grid + (n & 1 ? r->swing * len : 0) + 0.5);
+
+        /* not played before the change: due one new step after the last one, on its block at the earliest */
+        if (change >= 0 && at >= change && !moved)
+        {
+            double new_len = SAMPLE_RATE * 60.0 / r->new_tempo / 4.0;
+
+            grid += n ? new_len - len : 0;
+            len = new_len;
+            moved = 1;
+
+            at = (long)floor(grid + (n & 1 ? r->swing * len : 0) + 0.5);
+
+            /* overdue: on the change's block, and the next ones count from there */
+            if (at < change)
+            {
+                at = change;
+                grid = change - (n & 1 ? r->swing * len : 0);
+            }
+        }
+
+        if (at >= TOTAL) break;
+
+        int step = n % r->steps;
+
+        for (int t = 0; t < DRUM_SEQ_TRACKS; t++)
+            if (r->pattern[t] >> step & 1)
+                want[at] |= 1 << t;
+
+        grid += len;
+    }
+
+    int wrong = 0;
+
+    for (long i = 0; i < TOTAL; i++)
+    {
+        int got = (int)lrintf(out[i] / GAIN);
+
+        /* clicks on the same sample add up in float, so the level only to a rounding */
+        if (got != want[i] || fabsf(out[i] - got * GAIN) > 1e-5f)
+        {
+            if (wrong++ < 5)
+                printf("FAIL %.1f BPM, swing %.2f, %d steps, %d-sample blocks, start %ld: "
+                       "sample %ld has tracks %x, should have %x\n",
+                       r->tempo, r->swing, r->steps, block, start, i, got, want[i]);
+        }
+    }
+
+    return wrong;
+}
+
+int main()
+{
+    int failed = 0;
+
+    for (int k = 0; k < RUN_COUNT; k++)
+    {
+        int wrong = 0;
+
+        for (int b = 0; b < BLOCK_COUNT; b++)
+        {
+            wrong += check(&runs[k], blocks[b], 0);
+            wrong += check(&runs[k], blocks[b], 3);
+        }
+
+        printf("%6.1f BPM%s, swing %.2f, %d steps, blocks of 1 .. 4096: %s\n",
+               runs[k].tempo, runs[k].new_tempo ? " then another" : "", runs[k].swing, runs[k].steps,
+               wrong ? "WRONG" : "every hit on its sample");
+        failed |= wrong > 0;
+    }
+
+    printf("test_drumseq: %s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,125 @@
+/*
+ * The streaming drum voices sound exactly like the rendered samples.
+ *
+ * Every preset (and a snare with another noise seed, and a kick longer
+ * than DrumSynth's buffer) is hit once on a DrumStream and played in
+ * blocks of 1 to 4096 samples, and every sample has to be the same, to the
+ * bit, as generate_sample() at the same level, and as DrumSynth playing
+ * the hit it rendered with drum_trigger().
+ *
+ *   ./tests/test_drumstream
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "drum.h"
+#include "drumstream.h"
+
+#define SAMPLE_RATE 44100
+#define LONG_LENGTH (2 * SAMPLE_RATE)
+#define MAX_BLOCK 4096
+
+static DrumSynth drum;
+static DrumStream stream;
+static float rendered[LONG_LENGTH];
+static float out[MAX_BLOCK];
+static float played[MAX_BLOCK];
+
+static const int blocks[] = {1, 7, 64, 100, 256, 257, 512, 4096};
+#define BLOCK_COUNT (int)(sizeof(blocks) / sizeof(blocks[0]))
+
+/* the first sample that differs, -1 when none does */
+static long check(const char *name, const DrumParams *p, int block)
+{
+    DrumParams q = *p;
+    int with_drum = p->length <= MAX_SAMPLES;
+
+    generate_sample(rendered, &q, SAMPLE_RATE);
+
+    drum_stream_init(&stream, SAMPLE_RATE);
+    drum_stream_hit(&stream, p);
+
+    if (with_drum)
+    {
+        drum_init(&drum, SAMPLE_RATE);
+        drum.params = *p;
+        drum_trigger(&drum);
+    }
+
+    /* a block of silence after the hit too */
+    long total = p->length + block;
+    long bad = -1;
+
+    for (long pos = 0; pos < total && bad < 0; pos += block)
+    {
+        int n = total - pos < block ? (int)(total - pos) : block;
+
+        synth_process(&stream.base, out, n);
+        if (with_drum)
+            synth_process(&drum.base, played, n);
+
+        for (int i = 0; i < n && bad < 0; i++)
+        {
+            float want = pos + i < p->length ? rendered[pos + i] * 0.8f : 0.0f;
+
+            if (out[i] != want || (with_drum && played[i] != want))
+            {
+                bad = pos + i;
+                printf("FAIL %s, %d-sample blocks, sample %ld: stream %.9g, drum %.9g, rendered %.9g\n",
+                       name, block, bad, out[i], with_drum ? played[i] : 0.0f, want);
+            }
+        }
+    }
+
+    if (with_drum)
+        drum_free(&drum);
+
+    return bad;
+}
+
+int main()
+{
+    static void (*presets[])(DrumParams *p) = {play_kick, play_snare, play_tom, play_hihat};
+    static const char *names[] = {"kick", "snare", "tom", "hihat"};
+
+    DrumParams sounds[6];
+    const char *sound_names[6];
+    int count = 0;
+
+    drum_init(&drum, SAMPLE_RATE);
+    DrumParams defaults = drum.params;
+    drum_free(&drum);
+
+    for (int k = 0; k < 4; k++)
+    {
+        sounds[count] = defaults;
+        presets[k](&sounds[count]);
+        sound_names[count++] = names[k];
+    }
+
+    sounds[count] = sounds[1];
+    sounds[count].seed = 12345;
+    sound_names[count++] = "snare, seed 12345";
+
+    sounds[count] = sounds[0];
+    sounds[count].length = LONG_LENGTH;
+    sound_names[count++] = "kick, 2 s";
+
+    int failed = 0;
+
+    for (int k = 0; k < count; k++)
+    {
+        int ok = 1;
+
+        for (int b = 0; b < BLOCK_COUNT; b++)
+            if (check(sound_names[k], &sounds[k], blocks[b]) >= 0)
+                ok = 0;
+
+        printf("%-18s %6d samples, blocks of 1 .. %d: %s\n", sound_names[k], sounds[k].length,
+               MAX_BLOCK, ok ? "bit for bit" : "DIFFERENT");
+        failed |= !ok;
+    }
+
+    printf("test_drumstream: %s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
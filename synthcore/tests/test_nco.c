@@ -0,0 +1,105 @@
+/*
+ * The NCO doesn't drift.
+ *
+ * A few NCOs are advanced one sample at a time for 24 hours of audio at
+ * 44.1 kHz (3.8 billion samples), and every hour, and at the end, their
+ * phase has to be exactly inc * n mod 2^32, the closed form. A float
+ * accumulator would be off by whole cycles long before that.
+ *
+ * That only shows the accumulator adds exactly, so the pitch is checked
+ * against the real thing too: the increment is off by half a step at most,
+ * so the frequency by sample_rate / 2^33 Hz, and the phase after n samples
+ * is within n / 2^33 cycles of freq * n / sample_rate (under half a cycle
+ * after 24 hours). Takes about 15 seconds.
+ *
+ *   ./tests/test_nco
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "nco.h"
+
+#define SAMPLE_RATE 44100
+#define HOUR ((uint64_t)3600 * SAMPLE_RATE)
+#define HOURS 24
+
+static const double freqs[] = {440.0, 1000.5, 19999.9, 0.01, -261.63};
+#define COUNT (int)(sizeof(freqs) / sizeof(freqs[0]))
+
+/* half a step of the increment, in cycles per sample */
+#define HALF_STEP (0.5 / NCO_ONE)
+
+/* how far the phase is from where freq would be after n samples, in cycles, -0.5..0.5 */
+static double phase_error(const Nco *o, double freq, uint64_t n)
+{
+    long double ideal = fmodl((long double)freq * n / SAMPLE_RATE, 1.0L);
+    long double d = (long double)nco_phase(o) - ideal;
+
+    return (double)(d - roundl(d));
+}
+
+int main()
+{
+    Nco nco[COUNT];
+    int failed = 0;
+
+    for (int k = 0; k < COUNT; k++)
+    {
+        nco[k].phase = 0;
+        nco_set_freq(&nco[k], freqs[k], SAMPLE_RATE);
+
+        /* the increment as a signed step, negative frequencies run backwards */
+        double freq = (int32_t)nco[k].inc * (SAMPLE_RATE / NCO_ONE);
+        double error = fabs(freq - freqs[k]);
+
+        if (error > HALF_STEP * SAMPLE_RATE)
+        {
+            printf("FAIL %g Hz: plays %.9f Hz, %g Hz off, more than %g\n",
+                   freqs[k], freq, error, HALF_STEP * SAMPLE_RATE);
+            failed = 1;
+        }
+    }
+
+    for (int h = 1; h <= HOURS; h++)
+    {
+        for (uint64_t i = 0; i < HOUR; i++)
+        {
+            for (int k = 0; k < COUNT; k++)
+            {
+                nco_advance(&nco[k]);
+
+                /* one add per sample, not folded into a multiply by the compiler */
+                __asm__ volatile("" : "+r"(nco[k].phase));
+            }
+        }
+
+        uint64_t n = HOUR * h;
+
+        for (int k = 0; k < COUNT; k++)
+        {
+            uint32_t expected = (uint32_t)(nco[k].inc * n);
+
+            if (nco[k].phase != expected)
+            {
+                printf("FAIL %g Hz after %d h: phase %u, expected %u\n", freqs[k], h, nco[k].phase, expected);
+                failed = 1;
+            }
+
+            double drift = fabs(phase_error(&nco[k], freqs[k], n));
+
+            if (drift > n * HALF_STEP)
+            {
+                printf("FAIL %g Hz after %d h: %g cycles from the ideal phase, more than %g\n",
+                       freqs[k], h, drift, n * HALF_STEP);
+                failed = 1;
+            }
+        }
+    }
+
+    for (int k = 0; k < COUNT; k++)
+        printf("%10g Hz: phase after %d h = %u = inc * n mod 2^32, %+.6f cycles from ideal (at most %.6f)\n",
+               freqs[k], HOURS, nco[k].phase, phase_error(&nco[k], freqs[k], HOUR * HOURS), HOUR * HOURS * HALF_STEP);
+
+    printf("test_nco: %s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,141 @@
+/*
+ * Analyses a WAV file into sine partials (see analysis.h) and tells how
+ * fast that went, in times realtime, and optionally plays the partials back
+ * through the additive synth into a new WAV, to hear what the analysis kept.
+ *
+ *   ./tools/synth_analyze [options] FILE.wav
+ *
+ * -j spreads the frames over that many threads (a Pool).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "additive.h"
+#include "analysis.h"
+#include "wav.h"
+
+#define DEFAULT_OSC 256
+#define BLOCK 512
+
+static Analysis an;
+static AdditiveSynth additive;
+static Pool pool;
+
+static void usage()
+{
+    printf("usage: synth_analyze [options] FILE.wav\n\n");
+    printf("  -o FILE     play the partials back into a WAV\n");
+    printf("  -n OSC      keep the strongest OSC partials (default %d, at most %d)\n", DEFAULT_OSC, MAX_OSC);
+    printf("  -j THREADS  threads for the analysis (default 1)\n");
+}
+
+/* renders the oscillators of the additive synth from the start, as long as the input */
+static int resynthesize(const char *path, int rate, double seconds)
+{
+    WavWriter wav;
+    float buf[BLOCK];
+
+    if (wav_writer_open(&wav, path, rate) != 0)
+    {
+        perror(path);
+        return 1;
+    }
+
+    additive_publish(&additive);
+    additive.playing = 1;
+
+    for (long left = (long)(seconds * rate); left > 0; left -= BLOCK)
+    {
+        int n = left < BLOCK ? (int)left : BLOCK;
+
+        synth_process(&additive.base, buf, n);
+
+        if (wav_writer_write(&wav, buf, n) != 0)
+        {
+            perror(path);
+            return 1;
+        }
+    }
+
+    return wav_writer_close(&wav) != 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *in_path = NULL;
+    const char *out_path = NULL;
+    int max_osc = DEFAULT_OSC;
+    int threads = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (a[0] == '-' && a[1] && strchr("onj", a[1]) && a[2] == 0)
+        {
+            if (!v)
+            {
+                fprintf(stderr, "synth_analyze: %s needs a value\n", a);
+                return 2;
+            }
+            i++;
+        }
+
+        if      (strcmp(a, "-o") == 0) out_path = v;
+        else if (strcmp(a, "-n") == 0) max_osc = atoi(v);
+        else if (strcmp(a, "-j") == 0) threads = atoi(v);
+        else if (strcmp(a, "-h") == 0) { usage(); return 0; }
+        else if (a[0] == '-')
+        {
+            fprintf(stderr, "synth_analyze: unknown option %s\n", a);
+            return 2;
+        }
+        else in_path = a;
+    }
+
+    if (!in_path)
+    {
+        usage();
+        return 2;
+    }
+
+    if (max_osc <= 0 || threads <= 0)
+    {
+        fprintf(stderr, "synth_analyze: oscillators and threads must be positive\n");
+        return 2;
+    }
+
+    if (threads > 1)
+        pool_init(&pool, threads - 1);
+
+    if (analysis_run(&an, in_path, threads > 1 ? &pool : NULL) != 0)
+    {
+        fprintf(stderr, "synth_analyze: can't analyse %s\n", in_path);
+        return 1;
+    }
+
+    printf("%s: %.2f s at %.0f Hz, %ld frames, %d partials\n",
+           in_path, an.seconds, an.sample_rate, an.frames, an.track_count);
+    printf("analysed in %.3f s on %d thread%s, %.1fx realtime\n",
+           an.wall_seconds, pool.threads + 1, pool.threads ? "s" : "", an.seconds / an.wall_seconds);
+
+    int status = 0;
+
+    if (out_path)
+    {
+        additive_init(&additive, an.sample_rate);
+
+        int n = analysis_to_additive(&an, &additive, max_osc);
+        printf("%d oscillators -> %s\n", n, out_path);
+
+        status = resynthesize(out_path, (int)an.sample_rate, an.seconds);
+        additive_free(&additive);
+    }
+
+    analysis_free(&an);
+    pool_free(&pool);
+
+    return status;
+}
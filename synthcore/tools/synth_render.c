@@ -0,0 +1,576 @@
+/*
+ * Offline renderer: runs one of the engines headless and writes the result
+ * to a WAV (32-bit float) or raw float file, as fast as the CPU allows.
+ *
+ *   ./tools/synth_render [options] ENGINE
+ *
+ * Every engine plays a fixed little script (a note change or a drum hit
+ * every half second), so two runs with the same options give the same file.
+ * The events land on exact sample positions, not on block boundaries, so the
+ * output does not depend on the block size either.
+ *
+ * With -c the output is compared sample by sample against a reference WAV
+ * rendered earlier, and the program exits with 1 if they differ by more than
+ * the tolerance. That's how you check that an optimization didn't change the
+ * sound. `make check` does that for every engine against the golden renders
+ * in tests/golden/.
+ *
+ * -j spreads the additive engines over that many threads (a Pool).
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "additive.h"
+#include "drum.h"
+#include "drumseq.h"
+#include "drumstream.h"
+#include "fm.h"
+#include "subtractive.h"
+#include "wav.h"
+#include "wavegen.h"
+
+#define DEFAULT_RATE 44100
+#define DEFAULT_SECONDS 10.0
+#define DEFAULT_BLOCK 512
+#define DEFAULT_TOLERANCE 1e-4
+
+/* time between two script events, in seconds */
+#define EVENT_TIME 0.5
+
+/* ===== engines ===== */
+
+static WaveGen wave;
+static AdditiveSynth additive;
+static Pool pool;
+static DrumSynth drum;
+static DrumStream stream;
+static DrumParams stream_params;
+static DrumSeq seq;
+static SubtractiveSynth sub;
+static FmSynth fm;
+
+static SynthState *setup_wave(double sr)
+{
+    wavegen_init(&wave, sr);
+    return &wave.base;
+}
+
+/* every shape, then the next octave up */
+static void event_wave(int k)
+{
+    wave.wave = k % OSC_SHAPES;
+    wave.frequency = 110.0 * (1 << (k / OSC_SHAPES % 4));
+}
+
+static SynthState *setup_additive(double sr)
+{
+    static const OscShape shapes[] = {OSC_SINE, OSC_SQUARE, OSC_TRIANGLE, OSC_SAW};
+
+    additive_init(&additive, sr);
+
+    for (int k = 0; k < 4; k++)
+    {
+        int i = additive_add(&additive);
+        additive.osc[i].type = shapes[k];
+        additive.osc[i].freq = 220.0 * (k + 1);
+        additive.osc[i].amp = 0.5 / (k + 1);
+    }
+
+    additive_publish(&additive);
+    additive.playing = 1;
+    return &additive.base;
+}
+
+static void event_none(int k)
+{
+    (void)k;
+}
+
+#define PARTIALS 1024
+
+/* sine partials of a 55 Hz saw, repeating a little sharper every 256 */
+static SynthState *setup_partials(double sr, AdditiveEngine engine)
+{
+    additive_init(&additive, sr);
+    additive.engine = engine;
+
+    for (int k = 0; k < PARTIALS; k++)
+    {
+        int i = additive_add(&additive);
+        int n = k % 256 + 1;
+
+        additive.osc[i].freq = 55.0 * n * (1.0 + 0.002 * (k / 256));
+        additive.osc[i].amp = 1.0 / n;
+    }
+
+    additive_publish(&additive);
+    additive.playing = 1;
+    return &additive.base;
+}
+
+static SynthState *setup_poly(double sr)      { return setup_partials(sr, ADDITIVE_POLY); }
+static SynthState *setup_resonator(double sr) { return setup_partials(sr, ADDITIVE_RESONATOR); }
+static SynthState *setup_ifft(double sr)      { return setup_partials(sr, ADDITIVE_IFFT); }
+
+/* every partial glides up a fifth and back, the phases have to carry on */
+static void event_partials(int k)
+{
+    double ratio = k % 2 ? 1.5 : 1.0 / 1.5;
+
+    for (int i = 0; i < additive.osc_count; i++)
+        additive.osc[i].freq *= ratio;
+
+    additive_publish(&additive);
+}
+
+#define BELL_PARTIALS 256
+
+/*
+ * Inharmonic partials that each die away, the high ones sooner, struck
+ * again every 2 seconds, with a slow vibrato on every partial
+ */
+static SynthState *setup_bell(double sr)
+{
+    additive_init(&additive, sr);
+
+    for (int k = 0; k < BELL_PARTIALS; k++)
+    {
+        int i = additive_add(&additive);
+        Oscillator *o = &additive.osc[i];
+        double n = k + 1;
+
+        o->freq = 110.0 * n * sqrt(1.0 + 0.01 * n);
+        o->amp = 1.0 / n;
+
+        double decay = 1.8 / sqrt(n);
+        o->amp_env = (Envelope){4, 1, {0, 0.005, 0.005 + decay, 2.0}, {0, 1, 0, 0}};
+        o->freq_env = (Envelope){3, 1, {0, 0.25, 0.5}, {1.0, 1.0 + 0.003 * (k % 3 + 1), 1.0}};
+    }
+
+    additive_publish(&additive);
+    additive.playing = 1;
+    return &additive.base;
+}
+
+static SynthState *setup_drum(double sr, void (*preset)(DrumParams *p))
+{
+    drum_init(&drum, sr);
+    preset(&drum.params);
+    return &drum.base;
+}
+
+static SynthState *setup_kick(double sr)  { return setup_drum(sr, play_kick); }
+static SynthState *setup_snare(double sr) { return setup_drum(sr, play_snare); }
+static SynthState *setup_tom(double sr)   { return setup_drum(sr, play_tom); }
+static SynthState *setup_hihat(double sr) { return setup_drum(sr, play_hihat); }
+
+static void event_drum(int k)
+{
+    (void)k;
+    drum_trigger(&drum);
+}
+
+/* the same hits rendered as they play, these have to match the ones above exactly */
+static SynthState *setup_stream(double sr, void (*preset)(DrumParams *p))
+{
+    drum_stream_init(&stream, sr);
+
+    /* the presets leave some fields alone, they start out as DrumSynth's */
+    drum_init(&drum, sr);
+    stream_params = drum.params;
+    preset(&stream_params);
+
+    return &stream.base;
+}
+
+static SynthState *setup_kick_stream(double sr)  { return setup_stream(sr, play_kick); }
+static SynthState *setup_snare_stream(double sr) { return setup_stream(sr, play_snare); }
+static SynthState *setup_tom_stream(double sr)   { return setup_stream(sr, play_tom); }
+static SynthState *setup_hihat_stream(double sr) { return setup_stream(sr, play_hihat); }
+
+static void event_stream(int k)
+{
+    (void)k;
+    drum_stream_hit(&stream, &stream_params);
+}
+
+/*
+ * A beat at a tempo where a step isn't a whole number of samples, with
+ * swing, so every rounding shows. It plays the same at every block size.
+ */
+static SynthState *setup_seq(double sr)
+{
+    static void (*presets[DRUM_SEQ_TRACKS])(DrumParams *p) = {play_kick, play_snare, play_tom, play_hihat};
+    static float buf[MAX_SAMPLES];
+
+    drum_seq_init(&seq, sr);
+    drum_init(&drum, sr);
+
+    for (int t = 0; t < DRUM_SEQ_TRACKS; t++)
+    {
+        DrumParams p = drum.params;
+        presets[t](&p);
+        generate_sample(buf, &p, sr);
+        drum_sampler_load(&seq.sampler, t, buf, p.length);
+    }
+
+    seq.tempo = 123;
+    seq.swing = 0.2;
+    seq.pattern[0] = 0x0101 | 0x0400;     /* kick on 1, 9 and 11 */
+    seq.pattern[1] = 0x1010;              /* snare on 5 and 13 */
+    seq.pattern[2] = 0xc000;              /* tom on 15 and 16 */
+    seq.pattern[3] = 0x5555 | 0x2000;     /* hi-hat on the eighths and 14 */
+    seq.running = 1;
+
+    return &seq.base;
+}
+
+static SynthState *setup_sub(double sr, FilterModel model)
+{
+    subtractive_init(&sub, model, sr);
+
+    int f = subtractive_add_filter(&sub);
+    sub.filters[f].cutoff = 1200;
+    subtractive_update_filter(&sub, f);
+
+    f = subtractive_add_filter(&sub);
+    sub.filters[f].type = FILTER_HPF;
+    sub.filters[f].cutoff = 100;
+    subtractive_update_filter(&sub, f);
+
+    return &sub.base;
+}
+
+static SynthState *setup_svf(double sr)    { return setup_sub(sr, FILTER_MODEL_SVF); }
+static SynthState *setup_biquad(double sr) { return setup_sub(sr, FILTER_MODEL_BIQUAD); }
+
+/* Am, F, C, G, a new waveform with every round */
+static void event_sub(int k)
+{
+    static const float chords[4][3] =
+    {
+        {220.0f, 261.6f, 329.6f},
+        {174.6f, 220.0f, 261.6f},
+        {261.6f, 329.6f, 392.0f},
+        {196.0f, 246.9f, 293.7f},
+    };
+    static const OscShape shapes[3] = {OSC_SAW, OSC_SQUARE, OSC_TRIANGLE};
+
+    for (int n = 0; n < 3; n++)
+        subtractive_note_off(&sub, n);
+
+    sub.wave = shapes[k / 4 % 3];
+
+    for (int n = 0; n < 3; n++)
+        subtractive_note_on(&sub, n, chords[k % 4][n]);
+}
+
+static SynthState *setup_fm(double sr)
+{
+    fm_init(&fm, sr);
+    return &fm.base;
+}
+
+/* the chords of event_sub(), four notes each, the next algorithm with every round */
+static void event_fm(int k)
+{
+    static const float chords[4][4] =
+    {
+        {220.0f, 261.6f, 329.6f, 440.0f},
+        {174.6f, 220.0f, 261.6f, 349.2f},
+        {261.6f, 329.6f, 392.0f, 523.3f},
+        {196.0f, 246.9f, 293.7f, 392.0f},
+    };
+
+    /* new keys every time, so the last chord rings out in the other four voices */
+    for (int n = 0; n < 4 && k > 0; n++)
+        fm_note_off(&fm, (k - 1) * 4 + n);
+
+    fm.algorithm = k / 4 % FM_ALGORITHMS;
+
+    for (int n = 0; n < 4; n++)
+        fm_note_on(&fm, k * 4 + n, chords[k % 4][n]);
+}
+
+typedef struct
+{
+    const char *name;
+    const char *desc;
+    SynthState *(*setup)(double sample_rate);
+    void (*event)(int k);
+} Engine;
+
+static const Engine engines[] =
+{
+    {"wave",     "wave generator, every shape at 110-880 Hz",          setup_wave,     event_wave},
+    {"additive", "additive synth, 4 oscillators",                      setup_additive, event_none},
+    {"partials", "additive synth, 1024 sine partials, polynomial",      setup_poly,     event_partials},
+    {"resonator", "additive synth, 1024 sine partials, resonator",     setup_resonator, event_partials},
+    {"ifft",     "additive synth, 1024 sine partials, inverse FFT",    setup_ifft,     event_partials},
+    {"bell",     "additive synth, 256 partials with envelopes",        setup_bell,     event_none},
+    {"kick",     "drum synth, kick preset",                            setup_kick,     event_drum},
+    {"snare",    "drum synth, snare preset",                           setup_snare,    event_drum},
+    {"tom",      "drum synth, tom preset",                             setup_tom,      event_drum},
+    {"hihat",    "drum synth, hi-hat preset",                          setup_hihat,    event_drum},
+    {"kick_stream", "streaming drum voices, kick preset",              setup_kick_stream, event_stream},
+    {"snare_stream", "streaming drum voices, snare preset",            setup_snare_stream, event_stream},
+    {"tom_stream", "streaming drum voices, tom preset",                setup_tom_stream, event_stream},
+    {"hihat_stream", "streaming drum voices, hi-hat preset",           setup_hihat_stream, event_stream},
+    {"sequencer", "drum step sequencer, 4 tracks at 123 BPM with swing", setup_seq,     event_none},
+    {"svf",      "subtractive synth, SVF filters, chord progression",  setup_svf,      event_sub},
+    {"biquad",   "subtractive synth, biquad filters, chord progression", setup_biquad, event_sub},
+    {"fm",       "FM synth, 6 operators, chords through every algorithm", setup_fm,   event_fm},
+};
+
+#define ENGINE_COUNT (int)(sizeof(engines) / sizeof(engines[0]))
+
+/* ===== command line ===== */
+
+static void usage()
+{
+    printf("usage: synth_render [options] ENGINE\n\n");
+    printf("  -o FILE     write the output, .raw = raw 32-bit float, anything else = WAV\n");
+    printf("  -d SECONDS  length of the render (default %.0f)\n", DEFAULT_SECONDS);
+    printf("  -r RATE     sample rate (default %d)\n", DEFAULT_RATE);
+    printf("  -b FRAMES   block size passed to synth_process (default %d)\n", DEFAULT_BLOCK);
+    printf("  -c FILE     compare with a reference WAV, exit 1 if it differs\n");
+    printf("  -t TOL      largest allowed difference per sample (default %g)\n", DEFAULT_TOLERANCE);
+    printf("  -j THREADS  threads for the additive engines (default 1)\n\n");
+    printf("engines:\n");
+
+    for (int i = 0; i < ENGINE_COUNT; i++)
+        printf("  %-12s  %s\n", engines[i].name, engines[i].desc);
+}
+
+static int ends_with(const char *s, const char *end)
+{
+    size_t n = strlen(s);
+    size_t m = strlen(end);
+    return n >= m && strcmp(s + n - m, end) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    const char *ref_path = NULL;
+    const char *name = NULL;
+    double seconds = DEFAULT_SECONDS;
+    int rate = DEFAULT_RATE;
+    int block = DEFAULT_BLOCK;
+    double tolerance = DEFAULT_TOLERANCE;
+    int threads = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (a[0] == '-' && a[1] && strchr("odrbctj", a[1]) && a[2] == 0)
+        {
+            if (!v)
+            {
+                fprintf(stderr, "synth_render: %s needs a value\n", a);
+                return 2;
+            }
+            i++;
+        }
+
+        if      (strcmp(a, "-o") == 0) out_path = v;
+        else if (strcmp(a, "-d") == 0) seconds = atof(v);
+        else if (strcmp(a, "-r") == 0) rate = atoi(v);
+        else if (strcmp(a, "-b") == 0) block = atoi(v);
+        else if (strcmp(a, "-c") == 0) ref_path = v;
+        else if (strcmp(a, "-t") == 0) tolerance = atof(v);
+        else if (strcmp(a, "-j") == 0) threads = atoi(v);
+        else if (strcmp(a, "-h") == 0) { usage(); return 0; }
+        else if (a[0] == '-')
+        {
+            fprintf(stderr, "synth_render: unknown option %s\n", a);
+            return 2;
+        }
+        else name = a;
+    }
+
+    const Engine *engine = NULL;
+    for (int i = 0; name && i < ENGINE_COUNT; i++)
+        if (strcmp(engines[i].name, name) == 0)
+            engine = &engines[i];
+
+    if (!engine)
+    {
+        usage();
+        return 2;
+    }
+
+    if (seconds <= 0 || rate <= 0 || block <= 0 || threads <= 0)
+    {
+        fprintf(stderr, "synth_render: length, rate, block size and threads must be positive\n");
+        return 2;
+    }
+
+    /* ===== output and reference ===== */
+
+    WavWriter wav = {0};
+    FILE *raw = NULL;
+
+    if (out_path && ends_with(out_path, ".raw"))
+    {
+        raw = fopen(out_path, "wb");
+        if (!raw)
+        {
+            perror(out_path);
+            return 1;
+        }
+    }
+    else if (out_path && wav_writer_open(&wav, out_path, rate) != 0)
+    {
+        perror(out_path);
+        return 1;
+    }
+
+    WavReader ref = {0};
+
+    if (ref_path)
+    {
+        if (wav_reader_open(&ref, ref_path) != 0)
+        {
+            fprintf(stderr, "synth_render: can't read %s\n", ref_path);
+            return 1;
+        }
+        if (ref.sample_rate != rate)
+        {
+            fprintf(stderr, "synth_render: %s is %d Hz, rendering at %d Hz\n",
+                    ref_path, ref.sample_rate, rate);
+            return 1;
+        }
+    }
+
+    float *buf = malloc(block * sizeof(float));
+    float *ref_buf = malloc(block * sizeof(float));
+    if (!buf || !ref_buf)
+    {
+        fprintf(stderr, "synth_render: out of memory\n");
+        return 1;
+    }
+
+    /* ===== render ===== */
+
+    SynthState *synth = engine->setup(rate);
+
+    if (threads > 1 && synth == &additive.base)
+    {
+        pool_init(&pool, threads - 1);
+
+        if (additive_set_pool(&additive, &pool) != 0)
+        {
+            fprintf(stderr, "synth_render: out of memory\n");
+            return 1;
+        }
+    }
+
+    long total = (long)(seconds * rate);
+    long event_frames = (long)(EVENT_TIME * rate);
+    long next_event = 0;
+    int event = 0;
+
+    double max_diff = 0;
+    double sum_diff2 = 0;
+    long compared = 0;
+    clock_t cpu = 0;
+
+    for (long pos = 0; pos < total; )
+    {
+        if (pos == next_event)
+        {
+            engine->event(event++);
+            next_event += event_frames;
+        }
+
+        /* stop the block at the next event so it happens on its exact sample */
+        long n = total - pos;
+        if (n > block) n = block;
+        if (n > next_event - pos) n = next_event - pos;
+
+        clock_t t0 = clock();
+        synth_process(synth, buf, (int)n);
+        cpu += clock() - t0;
+
+        if (raw && fwrite(buf, sizeof(float), n, raw) != (size_t)n)
+        {
+            perror(out_path);
+            return 1;
+        }
+        if (wav.f && wav_writer_write(&wav, buf, (int)n) != 0)
+        {
+            perror(out_path);
+            return 1;
+        }
+
+        if (ref.f)
+        {
+            int got = wav_reader_read(&ref, ref_buf, (int)n);
+
+            for (int i = 0; i < got; i++)
+            {
+                double d = fabs((double)buf[i] - ref_buf[i]);
+                if (d > max_diff) max_diff = d;
+                sum_diff2 += d * d;
+            }
+            compared += got > 0 ? got : 0;
+        }
+
+        pos += n;
+    }
+
+    if (raw) fclose(raw);
+    if (wav.f && wav_writer_close(&wav) != 0)
+    {
+        perror(out_path);
+        return 1;
+    }
+
+    /* ===== report ===== */
+
+    double cpu_s = (double)cpu / CLOCKS_PER_SEC;
+    double audio_s = (double)total / rate;
+
+    printf("%s: %.2f s of audio in %.3f s of CPU", engine->name, audio_s, cpu_s);
+    if (cpu_s > 0)
+        printf(", realtime factor %.1fx", audio_s / cpu_s);
+    printf("\n");
+
+    if (pool.jobs > 0)
+    {
+        printf("%d threads, %ld jobs, chunks by thread:", pool.threads + 1, pool.jobs);
+        for (int i = 0; i <= pool.threads; i++)
+            printf(" %ld", pool.chunks_by[i]);
+        printf(", %ld taken over after the deadline\n", pool.taken_over);
+    }
+
+    int status = 0;
+
+    if (ref_path)
+    {
+        double rms = compared > 0 ? sqrt(sum_diff2 / compared) : 0;
+        int ok = compared == total && ref.frames == total && max_diff <= tolerance;
+
+        printf("compare %s: %ld of %ld samples, max diff %.3g, rms diff %.3g -> %s\n",
+               ref_path, compared, total, max_diff, rms, ok ? "OK" : "DIFFERENT");
+
+        if (ref.frames != total)
+            printf("  reference has %ld samples\n", ref.frames);
+
+        wav_reader_close(&ref);
+        status = ok ? 0 : 1;
+    }
+
+    additive_free(&additive);
+    pool_free(&pool);
+
+    free(buf);
+    free(ref_buf);
+    return status;
+}
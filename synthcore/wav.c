@@ -0,0 +1,249 @@
+#include "wav.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * WAV is little-endian. The header fields are written and parsed byte by
+ * byte, the float samples themselves are copied as they are in memory, so
+ * this assumes a little-endian machine (x86, ARM).
+ */
+
+#define WAV_HEADER_SIZE 44
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+#define WAV_RAW_BYTES 16384
+
+static void put_u16(unsigned char *p, unsigned v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static unsigned get_u16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void make_header(unsigned char *h, int sample_rate, long frames)
+{
+    uint32_t data_size = (uint32_t)(frames * sizeof(float));
+
+    memcpy(h, "RIFF", 4);
+    put_u32(h + 4, 36 + data_size);
+    memcpy(h + 8, "WAVE", 4);
+
+    memcpy(h + 12, "fmt ", 4);
+    put_u32(h + 16, 16);
+    put_u16(h + 20, WAV_FORMAT_FLOAT);
+    put_u16(h + 22, 1);                              /* channels */
+    put_u32(h + 24, sample_rate);
+    put_u32(h + 28, sample_rate * sizeof(float));    /* bytes per second */
+    put_u16(h + 32, sizeof(float));                  /* bytes per frame */
+    put_u16(h + 34, 32);                             /* bits per sample */
+
+    memcpy(h + 36, "data", 4);
+    put_u32(h + 40, data_size);
+}
+
+/* ===== writer ===== */
+
+int wav_writer_open(WavWriter *w, const char *path, int sample_rate)
+{
+    unsigned char h[WAV_HEADER_SIZE];
+
+    w->f = fopen(path, "wb");
+    w->sample_rate = sample_rate;
+    w->frames = 0;
+
+    if (!w->f) return -1;
+
+    /* placeholder sizes, wav_writer_close() fixes them */
+    make_header(h, sample_rate, 0);
+    if (fwrite(h, 1, sizeof(h), w->f) != sizeof(h))
+    {
+        fclose(w->f);
+        w->f = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int wav_writer_write(WavWriter *w, const float *buf, int frames)
+{
+    if (fwrite(buf, sizeof(float), frames, w->f) != (size_t)frames)
+        return -1;
+
+    w->frames += frames;
+    return 0;
+}
+
+int wav_writer_close(WavWriter *w)
+{
+    unsigned char h[WAV_HEADER_SIZE];
+    int err = 0;
+
+    make_header(h, w->sample_rate, w->frames);
+
+    if (fseek(w->f, 0, SEEK_SET) != 0 || fwrite(h, 1, sizeof(h), w->f) != sizeof(h))
+        err = -1;
+
+    if (fclose(w->f) != 0)
+        err = -1;
+
+    w->f = NULL;
+    return err;
+}
+
+/* ===== reader ===== */
+
+int wav_reader_open(WavReader *r, const char *path)
+{
+    unsigned char h[12];
+    int have_fmt = 0;
+    int format = 0;
+
+    memset(r, 0, sizeof(*r));
+
+    r->f = fopen(path, "rb");
+    if (!r->f) return -1;
+
+    if (fread(h, 1, 12, r->f) != 12 ||
+        memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0)
+        goto fail;
+
+    /* walk the chunks until "data", picking up "fmt " on the way */
+    for (;;)
+    {
+        unsigned char c[8];
+        if (fread(c, 1, 8, r->f) != 8) goto fail;
+
+        uint32_t size = get_u32(c + 4);
+
+        if (memcmp(c, "fmt ", 4) == 0)
+        {
+            unsigned char fmt[40];
+            if (size < 16 || size > sizeof(fmt)) goto fail;
+            if (fread(fmt, 1, size, r->f) != size) goto fail;
+
+            format = get_u16(fmt);
+            r->channels = get_u16(fmt + 2);
+            r->sample_rate = get_u32(fmt + 4);
+            r->bits = get_u16(fmt + 14);
+
+            /* the real format is in the first two bytes of the sub-format GUID */
+            if (format == WAV_FORMAT_EXTENSIBLE && size >= 26)
+                format = get_u16(fmt + 24);
+
+            have_fmt = 1;
+        }
+        else if (memcmp(c, "data", 4) == 0)
+        {
+            if (!have_fmt) goto fail;
+
+            /* everything after divides by it, and a huge one came out negative */
+            if (r->sample_rate <= 0) goto fail;
+
+            int frame_bytes = r->channels * r->bits / 8;
+            if (frame_bytes <= 0 || frame_bytes > WAV_RAW_BYTES) goto fail;
+
+            r->frames = size / frame_bytes;
+            break;
+        }
+        else
+        {
+            /* chunks are padded to an even size */
+            if (fseek(r->f, size + (size & 1), SEEK_CUR) != 0) goto fail;
+        }
+    }
+
+    if (format == WAV_FORMAT_FLOAT && r->bits == 32)
+        r->is_float = 1;
+    else if (format == WAV_FORMAT_PCM && (r->bits == 16 || r->bits == 24 || r->bits == 32))
+        r->is_float = 0;
+    else
+        goto fail;
+
+    return 0;
+
+fail:
+    fclose(r->f);
+    r->f = NULL;
+    return -1;
+}
+
+static float decode_sample(const WavReader *r, const unsigned char *p)
+{
+    if (r->is_float)
+    {
+        float v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    switch (r->bits)
+    {
+        case 16: return (int16_t)get_u16(p) / 32768.0f;
+        case 24: return (int32_t)((uint32_t)(p[0] << 8 | p[1] << 16 | (uint32_t)p[2] << 24)) / 2147483648.0f;
+        default: return (int32_t)get_u32(p) / 2147483648.0f;
+    }
+}
+
+int wav_reader_read(WavReader *r, float *out, int frames)
+{
+    unsigned char raw[WAV_RAW_BYTES];
+    int bytes = r->bits / 8;
+    int frame_bytes = r->channels * bytes;
+    int done = 0;
+
+    if (frames > r->frames - r->pos)
+        frames = (int)(r->frames - r->pos);
+
+    while (done < frames)
+    {
+        int n = frames - done;
+        if (n > WAV_RAW_BYTES / frame_bytes)
+            n = WAV_RAW_BYTES / frame_bytes;
+
+        if (fread(raw, frame_bytes, n, r->f) != (size_t)n)
+            return -1;
+
+        for (int i = 0; i < n; i++)
+        {
+            const unsigned char *p = raw + i * frame_bytes;
+            float sum = 0;
+
+            for (int c = 0; c < r->channels; c++)
+                sum += decode_sample(r, p + c * bytes);
+
+            out[done + i] = sum / r->channels;
+        }
+
+        done += n;
+    }
+
+    r->pos += done;
+    return done;
+}
+
+void wav_reader_close(WavReader *r)
+{
+    if (r->f)
+        fclose(r->f);
+    r->f = NULL;
+}
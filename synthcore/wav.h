@@ -0,0 +1,48 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdio.h>
+
+/*
+ * Minimal WAV file I/O, streamed in blocks so a long render or a long input
+ * file never has to fit in memory.
+ *
+ * The writer always writes mono 32-bit float. The reader understands
+ * 16/24/32-bit PCM and 32-bit float with any number of channels and hands
+ * back mono float (the channels are averaged).
+ *
+ * Every function returns 0 on success and -1 on error.
+ */
+
+typedef struct
+{
+    FILE *f;
+    int sample_rate;
+    long frames;
+} WavWriter;
+
+typedef struct
+{
+    FILE *f;
+    int sample_rate;
+    int channels;
+    int bits;
+    int is_float;
+    long frames;    /* frames in the file */
+    long pos;       /* frames read so far */
+} WavReader;
+
+int wav_writer_open(WavWriter *w, const char *path, int sample_rate);
+int wav_writer_write(WavWriter *w, const float *buf, int frames);
+
+/* fills in the sizes in the header and closes the file */
+int wav_writer_close(WavWriter *w);
+
+int wav_reader_open(WavReader *r, const char *path);
+
+/* reads up to frames mono samples, returns how many were read (0 at the end) or -1 */
+int wav_reader_read(WavReader *r, float *out, int frames);
+
+void wav_reader_close(WavReader *r);
+
+#endif
@@ -0,0 +1,85 @@
+#include "wavegen.h"
+
+#include <string.h>
+
+static void apply_params(WaveGen *g)
+{
+    ParamMsg m;
+
+    while (paramq_pop(&g->params, &m))
+    {
+        switch (m.id)
+        {
+            case WAVEGEN_WAVE:
+                /* it picks the table, so one that isn't a shape (or NaN) is dropped */
+                if (m.value >= 0 && m.value < OSC_SHAPES)
+                    g->wave = (OscShape)m.value;
+                break;
+
+            case WAVEGEN_FREQUENCY: g->frequency = m.value; break;
+            case WAVEGEN_AMPLITUDE: g->amplitude = m.value; break;
+            default: break;
+        }
+    }
+}
+
+static void wavegen_process(SynthState *s, float *out, int frames)
+{
+    WaveGen *g = (WaveGen *)s;
+
+    memset(out, 0, frames * sizeof(float));
+
+    apply_params(g);
+
+    smooth_set(&g->freq_smooth, g->frequency, SMOOTH_FRAMES);
+    smooth_set(&g->amp_smooth, g->amplitude, SMOOTH_FRAMES);
+
+    if (!smooth_active(&g->freq_smooth) && !smooth_active(&g->amp_smooth))
+    {
+        /* steady: pick the octave table once per buffer, not per sample */
+        wt_osc_set(&g->osc, g->wave, g->frequency, g->sample_rate);
+        wt_osc_render(&g->osc, g->amplitude, out, frames);
+        return;
+    }
+
+    /*
+     * Gliding: new increment and gain every sample. The table is the one for
+     * the highest frequency this block reaches, so nothing aliases on the way;
+     * a ramp only changes direction between blocks, so that's one of its ends.
+     * With only the amplitude gliding that's just the frequency.
+     */
+    double top = g->frequency;
+
+    if (smooth_active(&g->freq_smooth) && g->freq_smooth.value > top)
+        top = g->freq_smooth.value;
+
+    wt_osc_set(&g->osc, g->wave, top, g->sample_rate);
+
+    for (int i = 0; i < frames; i++)
+    {
+        g->osc.nco.inc = nco_increment(smooth_next(&g->freq_smooth), g->sample_rate);
+        out[i] = smooth_next(&g->amp_smooth) * wt_osc_next(&g->osc);
+    }
+}
+
+void wavegen_init(WaveGen *g, double sample_rate)
+{
+    memset(g, 0, sizeof(*g));
+
+    g->base.process = wavegen_process;
+    g->wave = OSC_SINE;
+    g->frequency = 110.0;
+    g->amplitude = 0.7;
+    g->sample_rate = sample_rate;
+
+    paramq_init(&g->params);
+    smooth_init(&g->freq_smooth, g->frequency);
+    smooth_init(&g->amp_smooth, g->amplitude);
+
+    wt_init(sample_rate);
+}
+
+int wavegen_set(WaveGen *g, WaveGenParam param, double value)
+{
+    return paramq_push(&g->params, param, value);
+}
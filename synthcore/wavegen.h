@@ -0,0 +1,48 @@
+#ifndef WAVEGEN_H
+#define WAVEGEN_H
+
+#include "osc.h"
+#include "paramq.h"
+#include "smooth.h"
+#include "synth.h"
+#include "wavetable.h"
+
+/*
+ * The wave generator: one band-limited wavetable oscillator.
+ *
+ * wave, frequency and amplitude belong to the audio thread. From another
+ * thread change them with wavegen_set(), which goes through the parameter
+ * queue; the next block picks the change up and glides frequency and
+ * amplitude to it. Single-threaded code (the offline renderer, benchmarks)
+ * can still write the fields directly between blocks.
+ */
+
+typedef enum
+{
+    WAVEGEN_WAVE,           /* an OscShape, anything else is ignored */
+    WAVEGEN_FREQUENCY,
+    WAVEGEN_AMPLITUDE
+} WaveGenParam;
+
+typedef struct
+{
+    SynthState base;
+
+    OscShape wave;
+    double frequency;
+    double amplitude;
+
+    WavetableOsc osc;
+    double sample_rate;
+
+    ParamQueue params;
+    Smoother freq_smooth;
+    Smoother amp_smooth;
+} WaveGen;
+
+void wavegen_init(WaveGen *g, double sample_rate);
+
+/* safe to call from the UI thread while the audio thread is running */
+int wavegen_set(WaveGen *g, WaveGenParam param, double value);
+
+#endif
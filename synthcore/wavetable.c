@@ -0,0 +1,100 @@
+#include "wavetable.h"
+
+#include <math.h>
+
+#define PI 3.14159265359
+
+static float tables[OSC_SHAPES][WT_OCTAVES][WT_SIZE + 1];
+static double table_rate = 0.0;
+
+/* amplitude of harmonic n, shapes are scaled to roughly -1..1 */
+static double harmonic_amp(OscShape shape, int n)
+{
+    switch (shape)
+    {
+        case OSC_SINE:
+            return n == 1 ? 1.0 : 0.0;
+
+        case OSC_SQUARE:
+            return (n % 2) ? 4.0 / (PI * n) : 0.0;
+
+        case OSC_TRIANGLE:
+            if (n % 2 == 0) return 0.0;
+            return ((n / 2) % 2 ? -8.0 : 8.0) / (PI * PI * n * n);
+
+        case OSC_SAW:
+            return 2.0 / (PI * n);
+
+        default:
+            return 0.0;
+    }
+}
+
+void wt_init(double sample_rate)
+{
+    static float sine[WT_SIZE];
+
+    if (table_rate == sample_rate) return;
+    table_rate = sample_rate;
+
+    for (int i = 0; i < WT_SIZE; i++)
+        sine[i] = (float)sin(2 * PI * i / WT_SIZE);
+
+    for (int k = 0; k < WT_OCTAVES; k++)
+    {
+        /* highest frequency this table plays decides how many harmonics fit */
+        double top = WT_BASE_FREQ * (2 << k);
+        int harmonics = (int)(sample_rate / 2 / top);
+
+        if (harmonics < 1) harmonics = 1;
+        if (harmonics > WT_SIZE / 2 - 1) harmonics = WT_SIZE / 2 - 1;
+
+        for (int s = 0; s < OSC_SHAPES; s++)
+        {
+            float *t = tables[s][k];
+
+            for (int i = 0; i < WT_SIZE; i++)
+            {
+                double acc = 0.0;
+
+                /* sin(2 PI n i / N) is an exact lookup into the sine table */
+                for (int n = 1; n <= harmonics; n++)
+                {
+                    double a = harmonic_amp(s, n);
+                    if (a != 0.0)
+                        acc += a * sine[(n * i) & (WT_SIZE - 1)];
+                }
+
+                t[i] = (float)acc;
+            }
+
+            t[WT_SIZE] = t[0];
+        }
+    }
+}
+
+void wt_osc_set(WavetableOsc *o, OscShape shape, double freq, double sample_rate)
+{
+    /* nco_increment() can't take these either: stand still */
+    if (!isfinite(freq)) freq = 0;
+
+    /* backwards is as bright as forwards, 0 and anything low get the first table */
+    double f = fabs(freq);
+    int k = 0;
+
+    if (f > WT_BASE_FREQ)
+    {
+        /* clamped as a double, a huge one doesn't fit an int */
+        double octave = ceil(log2(f / WT_BASE_FREQ)) - 1;
+        k = octave > WT_OCTAVES - 1 ? WT_OCTAVES - 1 : (int)octave;
+    }
+
+    o->table = tables[shape][k];
+    nco_set_freq(&o->nco, freq, sample_rate);
+}
+
+void wt_osc_render(WavetableOsc *o, float amp, float *out, int frames)
+{
+    for (int i = 0; i < frames; i++)
+        out[i] += amp * wt_osc_next(o);
+}
@@ -0,0 +1,53 @@
+#ifndef WAVETABLE_H
+#define WAVETABLE_H
+
+#include "nco.h"
+#include "osc.h"
+
+/*
+ * Band-limited wavetable oscillator.
+ *
+ * For every wave shape we keep one table per octave. Table k is used for
+ * frequencies up to WT_BASE_FREQ * 2^(k+1) and only contains the harmonics
+ * that stay below Nyquist at that frequency, so whatever table we pick for
+ * the current frequency can't alias.
+ *
+ * Playing a table is the same for every shape: advance the phase, read two
+ * neighbouring samples, interpolate. No sin() and no harmonic loop per sample.
+ * The phase is a 32-bit NCO, its top WT_BITS bits are the table index.
+ */
+
+#define WT_BITS      11
+#define WT_SIZE      (1 << WT_BITS)  /* samples per table */
+#define WT_OCTAVES   11        /* 20 Hz .. 40960 Hz, enough for 44.1k and 48k */
+#define WT_BASE_FREQ 20.0
+
+typedef struct
+{
+    const float *table;   /* octave table picked for the current frequency */
+    Nco nco;
+} WavetableOsc;
+
+/* builds all tables, call once at startup */
+void wt_init(double sample_rate);
+
+/* freq can be 0 or negative (runs backwards); NaN or inf from a glide or the UI holds it still */
+void wt_osc_set(WavetableOsc *o, OscShape shape, double freq, double sample_rate);
+
+/* adds amp * wave to out[0..frames) */
+void wt_osc_render(WavetableOsc *o, float amp, float *out, int frames);
+
+static inline float wt_osc_next(WavetableOsc *o)
+{
+    uint32_t i = o->nco.phase >> (32 - WT_BITS);
+    float frac = (o->nco.phase << WT_BITS) * (1.0f / 4294967296.0f);
+
+    /* tables carry one guard sample, so i + 1 never needs wrapping */
+    float s = o->table[i] + frac * (o->table[i + 1] - o->table[i]);
+
+    nco_advance(&o->nco);
+
+    return s;
+}
+
+#endif
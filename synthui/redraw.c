@@ -0,0 +1,185 @@
+#include "redraw.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int env_int(const char *name, int fallback)
+{
+    const char *v = getenv(name);
+    return v ? atoi(v) : fallback;
+}
+
+int redraw_init(Redraw *r, SDL_Renderer *ren, int w, int h)
+{
+    *r = (Redraw){0};
+
+    r->ren = ren;
+    r->w = w;
+    r->h = h;
+    r->legacy = env_int("SYNTH_UI_LEGACY", 0);
+    r->show_stats = env_int("SYNTH_UI_STATS", 0);
+    r->stats_start = SDL_GetTicks();
+    r->cpu_start = clock();
+
+    redraw_mark_all(r);
+
+    r->canvas = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+
+    /* without render targets every frame is a full redraw, still only when something changed */
+    return r->canvas ? 0 : -1;
+}
+
+/* ===== dirty regions ===== */
+
+void redraw_set_scope(Redraw *r, SDL_Rect area, int fps)
+{
+    fps = env_int("SYNTH_SCOPE_FPS", fps);
+    if (fps < 1) fps = 1;
+
+    r->scope = area;
+    r->scope_ms = 1000 / fps;
+    r->next_scope = SDL_GetTicks();
+}
+
+void redraw_scope_live(Redraw *r, int live)
+{
+    /* one last frame so the scope doesn't freeze on the last buffer */
+    if (r->scope_live && !live)
+        redraw_mark(r, r->scope);
+
+    r->scope_live = live;
+}
+
+void redraw_wake_in(Redraw *r, int ms)
+{
+    Uint32 at = SDL_GetTicks() + (ms > 0 ? ms : 0);
+
+    if (!r->wake_set || (int)(at - r->wake_at) < 0)
+        r->wake_at = at;
+
+    r->wake_set = 1;
+}
+
+void redraw_mark(Redraw *r, SDL_Rect area)
+{
+    if (r->is_dirty)
+        SDL_UnionRect(&r->dirty, &area, &r->dirty);
+    else
+        r->dirty = area;
+
+    r->is_dirty = 1;
+}
+
+void redraw_mark_all(Redraw *r)
+{
+    redraw_mark(r, (SDL_Rect){0, 0, r->w, r->h});
+}
+
+int redraw_is_dirty(const Redraw *r, SDL_Rect area)
+{
+    return r->is_dirty && SDL_HasIntersection(&r->dirty, &area);
+}
+
+/* ===== waiting ===== */
+
+static void print_stats(Redraw *r)
+{
+    Uint32 now = SDL_GetTicks();
+    Uint32 wall = now - r->stats_start;
+
+    if (wall < REDRAW_STATS_TIME) return;
+
+    clock_t cpu = clock();
+    double cpu_ms = (double)(cpu - r->cpu_start) * 1000.0 / CLOCKS_PER_SEC;
+
+    printf("ui (%s): %.1f redraws/s, %.1f%% CPU (whole process, audio included)\n",
+           r->legacy ? "polling" : "event-driven",
+           r->redraws * 1000.0 / wall, cpu_ms * 100.0 / wall);
+
+    r->stats_start = now;
+    r->cpu_start = cpu;
+    r->redraws = 0;
+}
+
+void redraw_wait(Redraw *r)
+{
+    if (r->show_stats)
+        print_stats(r);
+
+    if (r->legacy)
+    {
+        SDL_Delay(16);
+        redraw_mark_all(r);
+        return;
+    }
+
+    Uint32 now = SDL_GetTicks();
+    int timeout = REDRAW_MAX_WAIT;
+
+    if (r->scope_live)
+    {
+        int due = (int)(r->next_scope - now);
+        timeout = due < 0 ? 0 : due;
+    }
+
+    if (r->wake_set)
+    {
+        int due = (int)(r->wake_at - now);
+        if (due < timeout) timeout = due < 0 ? 0 : due;
+        r->wake_set = 0;
+    }
+
+    /* NULL leaves the event in the queue for the program's SDL_PollEvent() loop */
+    SDL_WaitEventTimeout(NULL, timeout);
+
+    now = SDL_GetTicks();
+    if (r->scope_live && (int)(now - r->next_scope) >= 0)
+    {
+        redraw_mark(r, r->scope);
+        r->next_scope = now + r->scope_ms;
+    }
+}
+
+void redraw_event(Redraw *r, const SDL_Event *e)
+{
+    if (e->type == SDL_WINDOWEVENT || e->type == SDL_RENDER_TARGETS_RESET ||
+        e->type == SDL_RENDER_DEVICE_RESET)
+        redraw_mark_all(r);
+}
+
+/* ===== drawing ===== */
+
+int redraw_begin(Redraw *r)
+{
+    if (!r->is_dirty) return 0;
+
+    if (r->canvas)
+    {
+        SDL_SetRenderTarget(r->ren, r->canvas);
+        SDL_RenderSetClipRect(r->ren, &r->dirty);
+    }
+
+    return 1;
+}
+
+void redraw_end(Redraw *r)
+{
+    if (r->canvas)
+    {
+        SDL_RenderSetClipRect(r->ren, NULL);
+        SDL_SetRenderTarget(r->ren, NULL);
+        SDL_RenderCopy(r->ren, r->canvas, NULL, NULL);
+    }
+
+    SDL_RenderPresent(r->ren);
+
+    r->is_dirty = 0;
+    r->redraws++;
+}
+
+void redraw_free(Redraw *r)
+{
+    if (r->canvas)
+        SDL_DestroyTexture(r->canvas);
+    r->canvas = NULL;
+}
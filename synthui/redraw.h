@@ -0,0 +1,96 @@
+#ifndef REDRAW_H
+#define REDRAW_H
+
+#include <SDL.h>
+#include <time.h>
+
+/*
+ * Redraw scheduler for the SDL programs.
+ *
+ * The programs used to poll for events, clear and redraw the whole window
+ * and sleep 16 ms, forever, even when nothing on screen changed. Here the
+ * main loop sleeps in SDL_WaitEventTimeout() until something happens, and
+ * only redraws the parts of the window that were marked dirty.
+ *
+ * The window is drawn into a texture that is kept between frames (the
+ * window's own back buffer is not), so redrawing part of it is safe.
+ * Everything outside the dirty area is clipped away.
+ *
+ * The waveform scope is the main thing that changes without an event. It
+ * gets its own refresh rate (SYNTH_SCOPE_FPS, default 30) and only while
+ * the program says it's live, i.e. while sound is playing. Anything else
+ * the audio thread changes (it can't send events) the program checks on
+ * every loop, and while such a change is due it asks with redraw_wake_in()
+ * to be woken soon rather than after up to REDRAW_MAX_WAIT.
+ *
+ *   while (run)
+ *   {
+ *       redraw_wait(&rd);
+ *       while (SDL_PollEvent(&e)) { redraw_event(&rd, &e); ... redraw_mark(...) ... }
+ *       if (redraw_begin(&rd)) { ...draw... redraw_end(&rd); }
+ *   }
+ *
+ * Set SYNTH_UI_STATS=1 to print redraws per second and the CPU use of the
+ * process every few seconds, and SYNTH_UI_LEGACY=1 to go back to the old
+ * "redraw everything every 16 ms" loop to compare against.
+ */
+
+#define REDRAW_SCOPE_FPS 30
+#define REDRAW_MAX_WAIT 1000    /* ms, wake up at least this often */
+#define REDRAW_STATS_TIME 5000  /* ms between two stats lines */
+
+typedef struct
+{
+    SDL_Renderer *ren;
+    SDL_Texture *canvas;
+    int w, h;
+
+    SDL_Rect dirty;         /* bounding box of everything marked */
+    int is_dirty;
+
+    SDL_Rect scope;
+    Uint32 scope_ms;
+    Uint32 next_scope;
+    int scope_live;
+
+    Uint32 wake_at;         /* redraw_wake_in(), for the next redraw_wait() only */
+    int wake_set;
+
+    int legacy;
+    int show_stats;
+    Uint32 stats_start;
+    clock_t cpu_start;
+    unsigned redraws;
+} Redraw;
+
+/* creates the canvas for a w x h window, returns 0 or -1 (see SDL_GetError()) */
+int redraw_init(Redraw *r, SDL_Renderer *ren, int w, int h);
+
+/* where the scope is and how often it refreshes while live (SYNTH_SCOPE_FPS wins) */
+void redraw_set_scope(Redraw *r, SDL_Rect area, int fps);
+
+/* call every loop; when the scope stops being live it's drawn one last time */
+void redraw_scope_live(Redraw *r, int live);
+
+/* the next redraw_wait() returns after ms at the latest, even without an event */
+void redraw_wake_in(Redraw *r, int ms);
+
+void redraw_mark(Redraw *r, SDL_Rect area);
+void redraw_mark_all(Redraw *r);
+int redraw_is_dirty(const Redraw *r, SDL_Rect area);
+
+/* sleeps until there's an event or the scope is due, the event stays in the queue */
+void redraw_wait(Redraw *r);
+
+/* handles the events that need a full redraw (window exposed, lost textures) */
+void redraw_event(Redraw *r, const SDL_Event *e);
+
+/* returns 0 when there's nothing to draw, else sets up the canvas and clipping */
+int redraw_begin(Redraw *r);
+
+/* copies the canvas to the window and presents it */
+void redraw_end(Redraw *r);
+
+void redraw_free(Redraw *r);
+
+#endif
@@ -0,0 +1,58 @@
+#include "scope.h"
+
+static SDL_Point points[2 * SCOPE_MAX_WIDTH];
+
+/* louder than the scope is tall stays on its edge */
+static int clamp_y(SDL_Rect area, int y)
+{
+    if (y < area.y) return area.y;
+    if (y >= area.y + area.h) return area.y + area.h - 1;
+    return y;
+}
+
+void scope_draw(SDL_Renderer *ren, SDL_Rect area, const float *samples, int n, float scale)
+{
+    int w = area.w < SCOPE_MAX_WIDTH ? area.w : SCOPE_MAX_WIDTH;
+    int mid = area.y + area.h / 2;
+    float to_y = scale * area.h / 2;
+
+    if (n <= 0 || w <= 0) return;
+
+    for (int x = 0; x < w; x++)
+    {
+        /* the samples of this pixel, at least one */
+        int from = (int)((long)x * n / w);
+        int to = (int)((long)(x + 1) * n / w);
+        if (to <= from) to = from + 1;
+
+        float lo = samples[from];
+        float hi = samples[from];
+
+        for (int i = from + 1; i < to; i++)
+        {
+            if (samples[i] < lo) lo = samples[i];
+            if (samples[i] > hi) hi = samples[i];
+        }
+
+        /* rising: from the bottom up, falling: from the top down (y grows downwards) */
+        int rising = samples[to - 1] >= samples[from];
+        int y_lo = clamp_y(area, mid - (int)(lo * to_y));
+        int y_hi = clamp_y(area, mid - (int)(hi * to_y));
+
+        points[2 * x] = (SDL_Point){area.x + x, rising ? y_lo : y_hi};
+        points[2 * x + 1] = (SDL_Point){area.x + x, rising ? y_hi : y_lo};
+    }
+
+    SDL_RenderDrawLines(ren, points, 2 * w);
+}
+
+int scope_trigger(const float *samples, int n, int window)
+{
+    for (int i = n - window; i > 0; i--)
+    {
+        if (samples[i - 1] < 0.0f && samples[i] >= 0.0f)
+            return i;
+    }
+
+    return n - window > 0 ? n - window : 0;
+}
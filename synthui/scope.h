@@ -0,0 +1,38 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include <SDL.h>
+
+/*
+ * Waveform scope drawing for the SDL programs.
+ *
+ * The programs used to draw the scope as one SDL_RenderDrawLine() per
+ * sample, a thousand draw calls a frame for a few hundred pixels. Here the
+ * samples are boiled down to one column per pixel, the lowest and the
+ * highest sample that fall on it, and all the columns go to the renderer as
+ * a single polyline with one SDL_RenderDrawLines() call. However many
+ * samples the scope shows, the renderer only gets two points per pixel.
+ *
+ * Within a column the line goes the way the signal goes (up if it rises
+ * there, down if it falls), so at low zoom it looks like the old line and
+ * at high zoom like a filled envelope.
+ *
+ * The samples come from a CaptureRing (capture.h), which the audio thread
+ * fills without locking.
+ */
+
+#define SCOPE_MAX_WIDTH 2048    /* pixels, wider scopes are squeezed */
+
+/*
+ * Draws samples[0 .. n) across area, in the current draw colour; a sample
+ * of 1 / scale reaches the top edge. The background is up to the caller.
+ */
+void scope_draw(SDL_Renderer *ren, SDL_Rect area, const float *samples, int n, float scale);
+
+/*
+ * Where a steady picture starts: the last rising zero crossing that still
+ * has `window` samples after it, or n - window if there's none.
+ */
+int scope_trigger(const float *samples, int n, int window);
+
+#endif
@@ -0,0 +1,232 @@
+#include "text.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ATLAS_WIDTH 512
+
+/* two triangles per quad, the same pattern for every string */
+static int quad_indices[TEXT_MAX_LEN * 6];
+
+static int env_flag(const char *name)
+{
+    const char *v = getenv(name);
+    return v && atoi(v) != 0;
+}
+
+/* ===== atlas ===== */
+
+int text_init(TextRenderer *t, SDL_Renderer *ren, TTF_Font *font)
+{
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface *glyph[TEXT_GLYPHS];
+
+    memset(t, 0, sizeof(*t));
+    t->ren = ren;
+    t->font = font;
+    t->legacy = env_flag("SYNTH_TEXT_LEGACY");
+    t->show_stats = env_flag("SYNTH_UI_STATS");
+    t->stats_start = SDL_GetTicks();
+
+    for (int q = 0; q < TEXT_MAX_LEN; q++)
+    {
+        int *i = &quad_indices[q * 6];
+        int v = q * 4;
+
+        i[0] = v;     i[1] = v + 1; i[2] = v + 2;
+        i[3] = v + 2; i[4] = v + 1; i[5] = v + 3;
+    }
+
+    if (t->legacy) return 0;
+
+    /* render every glyph once and pack them in rows */
+    int x = 0, y = 0, row_h = 0;
+
+    for (int g = 0; g < TEXT_GLYPHS; g++)
+    {
+        Uint16 ch = TEXT_FIRST_GLYPH + g;
+        int minx, maxx, miny, maxy, advance = 0;
+
+        glyph[g] = TTF_RenderGlyph_Blended(font, ch, white);
+        TTF_GlyphMetrics(font, ch, &minx, &maxx, &miny, &maxy, &advance);
+
+        int w = glyph[g] ? glyph[g]->w : 0;
+        int h = glyph[g] ? glyph[g]->h : 0;
+
+        if (x + w > ATLAS_WIDTH)
+        {
+            x = 0;
+            y += row_h;
+            row_h = 0;
+        }
+
+        t->glyphs[g].src = (SDL_Rect){x, y, w, h};
+        t->glyphs[g].advance = advance;
+
+        x += w;
+        if (h > row_h) row_h = h;
+    }
+
+    t->atlas_w = ATLAS_WIDTH;
+    t->atlas_h = y + row_h;
+
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, t->atlas_w, t->atlas_h, 32,
+                                                        SDL_PIXELFORMAT_RGBA32);
+    if (atlas)
+    {
+        SDL_FillRect(atlas, NULL, 0);
+
+        for (int g = 0; g < TEXT_GLYPHS; g++)
+        {
+            if (!glyph[g]) continue;
+
+            /* copy the alpha as it is instead of blending onto the empty atlas */
+            SDL_SetSurfaceBlendMode(glyph[g], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyph[g], NULL, atlas, &t->glyphs[g].src);
+        }
+
+        t->atlas = SDL_CreateTextureFromSurface(ren, atlas);
+        t->stats.uploads++;
+        SDL_FreeSurface(atlas);
+    }
+
+    for (int g = 0; g < TEXT_GLYPHS; g++)
+        if (glyph[g]) SDL_FreeSurface(glyph[g]);
+
+    if (!t->atlas) return -1;
+
+    SDL_SetTextureBlendMode(t->atlas, SDL_BLENDMODE_BLEND);
+    return 0;
+}
+
+/* ===== drawing ===== */
+
+static int same_color(SDL_Color a, SDL_Color b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+/* turns the string into one quad per glyph, at its final position and colour */
+static void layout(TextRenderer *t, TextEntry *e)
+{
+    float pen = e->x;
+    e->quads = 0;
+
+    for (const char *p = e->text; *p; p++)
+    {
+        int g = (unsigned char)*p - TEXT_FIRST_GLYPH;
+        if (g < 0 || g >= TEXT_GLYPHS) g = '?' - TEXT_FIRST_GLYPH;
+
+        const TextGlyph *gl = &t->glyphs[g];
+        SDL_Vertex *v = &e->verts[e->quads * 4];
+
+        float x0 = pen, x1 = pen + gl->src.w;
+        float y0 = e->y, y1 = e->y + gl->src.h;
+        float u0 = (float)gl->src.x / t->atlas_w;
+        float u1 = (float)(gl->src.x + gl->src.w) / t->atlas_w;
+        float v0 = (float)gl->src.y / t->atlas_h;
+        float v1 = (float)(gl->src.y + gl->src.h) / t->atlas_h;
+
+        v[0] = (SDL_Vertex){{x0, y0}, e->color, {u0, v0}};
+        v[1] = (SDL_Vertex){{x1, y0}, e->color, {u1, v0}};
+        v[2] = (SDL_Vertex){{x0, y1}, e->color, {u0, v1}};
+        v[3] = (SDL_Vertex){{x1, y1}, e->color, {u1, v1}};
+
+        pen += gl->advance;
+        if (gl->src.w > 0) e->quads++;
+    }
+}
+
+static TextEntry *lookup(TextRenderer *t, int x, int y, const char *s, SDL_Color color)
+{
+    TextEntry *oldest = &t->cache[0];
+
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++)
+    {
+        TextEntry *e = &t->cache[i];
+
+        if (e->x == x && e->y == y && same_color(e->color, color) &&
+            strncmp(e->text, s, TEXT_MAX_LEN - 1) == 0)
+            return e;
+
+        if (e->last_used < oldest->last_used)
+            oldest = e;
+    }
+
+    /* not there, replace the entry that was used longest ago */
+    snprintf(oldest->text, sizeof(oldest->text), "%s", s);
+    oldest->x = x;
+    oldest->y = y;
+    oldest->color = color;
+    layout(t, oldest);
+
+    t->stats.misses++;
+    return oldest;
+}
+
+static void draw_legacy(TextRenderer *t, int x, int y, const char *s, SDL_Color color)
+{
+    SDL_Surface *surf = TTF_RenderText_Solid(t->font, s, color);
+    if (!surf) return;
+
+    SDL_Texture *tex = SDL_CreateTextureFromSurface(t->ren, surf);
+    SDL_Rect dst = {x, y, surf->w, surf->h};
+
+    SDL_RenderCopy(t->ren, tex, NULL, &dst);
+    SDL_FreeSurface(surf);
+    SDL_DestroyTexture(tex);
+
+    t->stats.uploads++;
+}
+
+void text_draw(TextRenderer *t, int x, int y, const char *s, SDL_Color color)
+{
+    Uint64 t0 = SDL_GetPerformanceCounter();
+
+    /* {r, g, b} without an alpha: the atlas blends with it, so 0 would draw nothing */
+    if (color.a == 0) color.a = 255;
+
+    if (t->legacy)
+        draw_legacy(t, x, y, s, color);
+    else
+    {
+        TextEntry *e = lookup(t, x, y, s, color);
+        e->last_used = t->frame;
+
+        if (e->quads > 0)
+            SDL_RenderGeometry(t->ren, t->atlas, e->verts, e->quads * 4, quad_indices, e->quads * 6);
+    }
+
+    t->stats.draws++;
+    t->stats.seconds += (double)(SDL_GetPerformanceCounter() - t0) / SDL_GetPerformanceFrequency();
+}
+
+/* ===== stats ===== */
+
+void text_frame(TextRenderer *t)
+{
+    t->frame++;
+    t->stats.frames++;
+
+    if (!t->show_stats) return;
+
+    Uint32 now = SDL_GetTicks();
+    if (now - t->stats_start < 1000) return;
+
+    double f = t->stats.frames;
+    printf("text (%s): %.1f draws, %.2f layouts, %.2f uploads, %.1f us per frame\n",
+           t->legacy ? "legacy" : "atlas",
+           t->stats.draws / f, t->stats.misses / f, t->stats.uploads / f,
+           t->stats.seconds * 1e6 / f);
+
+    memset(&t->stats, 0, sizeof(t->stats));
+    t->stats_start = now;
+}
+
+void text_free(TextRenderer *t)
+{
+    if (t->atlas)
+        SDL_DestroyTexture(t->atlas);
+    t->atlas = NULL;
+}
@@ -0,0 +1,91 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+/*
+ * Cached text drawing for the SDL programs.
+ *
+ * The old draw_text() rendered the string with SDL_ttf, uploaded it as a
+ * new texture, drew it and threw the texture away, for every label, every
+ * frame. Here the font is rendered once into a glyph atlas (one texture,
+ * uploaded once at startup) and a string is drawn as a batch of textured
+ * quads with a single SDL_RenderGeometry() call.
+ *
+ * The quads of the last TEXT_CACHE_SIZE strings are kept, keyed by the
+ * text, position and colour, so a label that didn't change costs one
+ * lookup and one draw call. Strings that change every frame (a frequency
+ * readout) just miss and get laid out again, which is cheap: no SDL_ttf,
+ * no upload.
+ *
+ * Only printable ASCII is in the atlas, other bytes are drawn as '?'.
+ * SDL_RenderGeometry() needs SDL 2.0.18 or newer.
+ *
+ * Set SYNTH_UI_STATS=1 to print the text cost once a second, and
+ * SYNTH_TEXT_LEGACY=1 to go back to one SDL_ttf render + upload per call
+ * to compare against.
+ */
+
+#define TEXT_FIRST_GLYPH 32
+#define TEXT_GLYPHS (127 - TEXT_FIRST_GLYPH)
+#define TEXT_CACHE_SIZE 64
+#define TEXT_MAX_LEN 128
+
+typedef struct
+{
+    SDL_Rect src;   /* where the glyph is in the atlas */
+    int advance;
+} TextGlyph;
+
+typedef struct
+{
+    char text[TEXT_MAX_LEN];
+    int x, y;
+    SDL_Color color;
+
+    int quads;
+    SDL_Vertex verts[TEXT_MAX_LEN * 4];
+
+    unsigned last_used;     /* frame number, the oldest entry is replaced */
+} TextEntry;
+
+typedef struct
+{
+    unsigned frames;
+    unsigned draws;         /* text_draw() calls */
+    unsigned misses;        /* strings that had to be laid out */
+    unsigned uploads;       /* textures created */
+    double seconds;         /* time spent in text_draw() */
+} TextStats;
+
+typedef struct
+{
+    SDL_Renderer *ren;
+    TTF_Font *font;
+
+    SDL_Texture *atlas;
+    int atlas_w, atlas_h;
+    TextGlyph glyphs[TEXT_GLYPHS];
+
+    TextEntry cache[TEXT_CACHE_SIZE];
+    unsigned frame;
+
+    int legacy;
+    int show_stats;
+    TextStats stats;
+    Uint32 stats_start;
+} TextRenderer;
+
+/* builds the atlas, returns 0 or -1 (see SDL_GetError()) */
+int text_init(TextRenderer *t, SDL_Renderer *ren, TTF_Font *font);
+
+/* draws s at x, y; a colour with alpha 0 is opaque, as TTF_RenderText_Solid() took it */
+void text_draw(TextRenderer *t, int x, int y, const char *s, SDL_Color color);
+
+/* call once per frame, after SDL_RenderPresent() */
+void text_frame(TextRenderer *t);
+
+void text_free(TextRenderer *t);
+
+#endif